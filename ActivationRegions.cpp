@@ -0,0 +1,100 @@
+#include "ActivationRegions.h"
+#include <algorithm>
+
+ActivationRegions::ActivationRegions(int margin) :
+    margin(margin),
+    buckets(BucketCount),
+    sleeping(0)
+{
+}
+
+size_t ActivationRegions::bucketOf(int cellX, int cellY)
+{
+    return (uint32_t(cellX) * 73856093u ^ uint32_t(cellY) * 19349663u) & (BucketCount - 1);
+}
+
+void ActivationRegions::file(EntityStore::EntityId id, const pixelpos& pos)
+{
+    if (entityBucket.size() <= id) {
+        entityBucket.resize(id + 1, UINT32_MAX);
+        entitySlot.resize(id + 1, UINT32_MAX);
+    }
+    const size_t bucket = bucketOf(cellOf(pos.x), cellOf(pos.y));
+    entityBucket[id] = uint32_t(bucket);
+    entitySlot[id] = uint32_t(buckets[bucket].size());
+    buckets[bucket].push_back(id);
+    sleeping++;
+}
+
+void ActivationRegions::unfile(EntityStore::EntityId id)
+{
+    if (id >= entityBucket.size() || entityBucket[id] == UINT32_MAX) {
+        return;
+    }
+    // move the bucket's last entity into the gap
+    std::vector<EntityStore::EntityId>& bucket = buckets[entityBucket[id]];
+    const uint32_t slot = entitySlot[id];
+    bucket[slot] = bucket.back();
+    entitySlot[bucket[slot]] = slot;
+    bucket.pop_back();
+    entityBucket[id] = UINT32_MAX;
+    entitySlot[id] = UINT32_MAX;
+    sleeping--;
+}
+
+void ActivationRegions::update(EntityStore& entities, const pixelpos& camera, const pixelpos& viewSize, EntityStore::EntityId keepAwake)
+{
+    const int left = camera.x - margin, right = camera.x + viewSize.x + margin;
+    const int top = camera.y - margin, bottom = camera.y + viewSize.y + margin;
+    auto inside = [=](const pixelpos& pos) {
+        return pos.x >= left && pos.x < right && pos.y >= top && pos.y < bottom;
+    };
+
+    // sleeping an entity swaps the last awake one into its place, which has already been looked at
+    for (size_t i = entities.getAwakeCount(); i-- > 0;) {
+        const EntityStore::EntityId id = entities.getId(i);
+        pixelpos pos;
+        getPixelPosFromRealPos(entities.getPos(id), pos);
+        if (id != keepAwake && !inside(pos)) {
+            entities.sleep(id);
+            file(id, pos);
+        }
+    }
+
+    for (int cellY = cellOf(top); cellY <= cellOf(bottom - 1); cellY++) {
+        for (int cellX = cellOf(left); cellX <= cellOf(right - 1); cellX++) {
+            // buckets are shared by cells far apart, so everything in one still has to be checked against the view
+            std::vector<EntityStore::EntityId>& bucket = buckets[bucketOf(cellX, cellY)];
+            for (size_t slot = bucket.size(); slot-- > 0;) {
+                const EntityStore::EntityId id = bucket[slot];
+                pixelpos pos;
+                getPixelPosFromRealPos(entities.getPos(id), pos);
+                if (inside(pos)) {
+                    unfile(id);
+                    entities.wake(id);
+                }
+            }
+        }
+    }
+}
+
+void ActivationRegions::forget(EntityStore::EntityId id)
+{
+    unfile(id);
+}
+
+void ActivationRegions::rebuild(const EntityStore& entities)
+{
+    for (auto& bucket : buckets) {
+        bucket.clear();
+    }
+    std::fill(entityBucket.begin(), entityBucket.end(), UINT32_MAX);
+    std::fill(entitySlot.begin(), entitySlot.end(), UINT32_MAX);
+    sleeping = 0;
+    for (size_t i = entities.getAwakeCount(); i < entities.size(); i++) {
+        const EntityStore::EntityId id = entities.getId(i);
+        pixelpos pos;
+        getPixelPosFromRealPos(entities.getPos(id), pos);
+        file(id, pos);
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Geometry.h"
+#include "EntityStore.h"
+
+/// @brief Puts entities to sleep once they're further than a margin outside the camera's view and wakes
+/// them when the view comes back near. Sleeping entities don't move, so they're filed into coarse buckets
+/// by where they are on screen, and waking only looks in the buckets under the view; a step costs about
+/// as much as the entities around the view, however many the level holds
+class ActivationRegions
+{
+public:
+    // edge of a bucket, in pixels
+    static const int BucketSize = 256;
+    // buckets cells are hashed into; a power of two
+    static const size_t BucketCount = 1024;
+
+private:
+    int margin;
+    std::vector<std::vector<EntityStore::EntityId>> buckets;
+    // where each sleeping entity is filed, by id: its bucket and its place in it, UINT32_MAX when awake
+    std::vector<uint32_t> entityBucket;
+    std::vector<uint32_t> entitySlot;
+    size_t sleeping;
+
+    static size_t bucketOf(int cellX, int cellY);
+    static int cellOf(int pixel) { return pixel >= 0 ? pixel / BucketSize : (pixel + 1) / BucketSize - 1; }
+    void file(EntityStore::EntityId id, const pixelpos& pos);
+    void unfile(EntityStore::EntityId id);
+public:
+    /// @param margin pixels around the view that entities stay awake in
+    explicit ActivationRegions(int margin);
+
+    /// @brief Sleep the awake entities outside the view and its margin, and wake the sleeping ones inside it
+    /// @param keepAwake an entity that never sleeps, whatever the camera does
+    void update(EntityStore& entities, const pixelpos& camera, const pixelpos& viewSize, EntityStore::EntityId keepAwake);
+    // stop tracking an entity that's about to be removed from the store
+    void forget(EntityStore::EntityId id);
+    // file every sleeping entity again, after the store has been replaced wholesale
+    void rebuild(const EntityStore& entities);
+
+    size_t getSleepingCount() const { return sleeping; }
+};
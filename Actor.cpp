@@ -1,35 +1,34 @@
 #include "Actor.h"
-#include "SpriteSheet.h"
+#include "AnimationTable.h"
 #include "Geometry.h"
 #include "GameWindow.h"
 #include "Texture.h"
+#include "RenderSnapshot.h"
+#include "WorldState.h"
 #include <cassert>
 
-Actor::Actor(GameWindow& parentWindow, SpriteConfig& spriteConfig, Texture* texture, const mappoint &mt) :
-    spriteProvider(std::make_unique<SpriteProvider>(spriteConfig)),
-    texture(texture),
+Actor::Actor(GameWindow& parentWindow, EntityStore& entities, std::shared_ptr<const AnimationTable> animations, std::shared_ptr<Texture> texture, const mappoint &mt) :
     parentWindow(parentWindow),
+    entities(entities),
+    animations(std::move(animations)),
+    animationTime(0.f),
+    texture(std::move(texture)),
     windowPos{int(mt.x * 16), int(mt.y * 16)},
-    realpos(parentWindow.getTripointAtMapPoint(mt)),
-    intentMove( MoveVector{0.f, 0.f, 0.f} ),
-    curMove( MoveVector{0.f, 0.f, 0.f} ),
-    collisionGeometry({-1.f, -1.f, -1.f, -1.f}),
-    state(ActorState::Default),
     lastFrameState(ActorState::Default),
-    visible(true),
-    maxJumpTime(DEFAULT_JUMP_TIME),
-    jumpEndTime(-1.f),
-    collisions({0}),
-    collisionGeomCurrent({ -1.f, -1.f, -1.f, -1.f, -1.f })
+    visible(true)
 {
+    // the collision cylinder hangs off the default frame's origin
+    const SDL_Rect& spriteRect = this->animations->getFrame(ActorState::Default, 0.f);
+    entity = entities.add(parentWindow.getTripointAtMapPoint(mt), float(spriteRect.x), spriteRect.y - 1.f, float(spriteRect.y), DEFAULT_JUMP_TIME);
 }
 
 Actor::~Actor()
 {
+    entities.remove(entity);
 }
 
-PlayerActor::PlayerActor(GameWindow& parentWindow, SpriteConfig& spriteConfig, Texture* texture, const mappoint& mt) : 
-    Actor(parentWindow, spriteConfig, texture, mt),
+PlayerActor::PlayerActor(GameWindow& parentWindow, EntityStore& entities, std::shared_ptr<const AnimationTable> animations, std::shared_ptr<Texture> texture, const mappoint& mt) : 
+    Actor(parentWindow, entities, std::move(animations), std::move(texture), mt),
     intentKeys(NoIntent),
     intentMoveKeys(MKeyNone)
 {
@@ -140,6 +139,7 @@ void PlayerActor::getMoveVectorFromMoveKey(int mKeysDown, MoveVector &mv)
 
 void PlayerActor::handle_input(const SDL_Event& event)
 {
+    MoveVector intentMove = getIntent();
     int lastMoveKeys = intentMoveKeys;
     switch (event.type) {
     case SDL_KEYDOWN:
@@ -178,137 +178,53 @@ void PlayerActor::handle_input(const SDL_Event& event)
     } else {
         intentMove.y = 0.f;
     }
+    setIntent(intentMove);
 }
 
 /// <summary>
-/// Move the actor horizontally
+/// bring an Actor's drawing state up to date with its entity's latest simulation step
 /// </summary>
-/// <param name="isRunning">is the actor's intent currently Run</param>
-/// <param name="deltaTime">time in seconds since last frame</param>
-/// <param name="intent">The intended move vector (speed+angle)</param>
-/// <param name="current">The current move vector (speed+angle)</param>
-void Actor::handleMovement(float deltaTime, const MoveVector &intent, MoveVector &current)
+/// <param name="deltaTime">the time (in seconds) simulated by this step</param>
+void Actor::update(float deltaTime)
 {
-    const CollisionData& colData = getCollisions();
-    if (intent.x != current.x || intent.z != current.z) {
-
-        // 0,1;90,0;180,-1;270;0,360,1
-
-        float vDelta = PLAYER_RUN_ACCEL * deltaTime;
-        float zDelta = intent.z - current.z;
-        float xDelta = intent.x - current.x;
-        if(zDelta == 0.f)
-        {
-            curMove.x += xDelta < 0? -vDelta : vDelta;
-        } else if(xDelta == 0.f) {
-            curMove.z += zDelta < 0? -vDelta : vDelta;
-        } else {
-            curMove.x += 0.5f * (xDelta < 0? -vDelta : vDelta);
-            curMove.z += 0.5f * (zDelta < 0? -vDelta : vDelta);
-        }
-        if((curMove.x > 0.f && intent.x <= 0.f) || 
-            (curMove.x < 0.f && intent.x >= 0.f)){
-            curMove.x += (xDelta < 0 ? -vDelta : vDelta);
-        }
-        if((curMove.z > 0.f && intent.z <= 0.f) || 
-            (curMove.z < 0.f && intent.z >= 0.f)){
-            curMove.z += (zDelta < 0 ? -vDelta : vDelta);
-        }
-        if ((xDelta < 0 && curMove.x < intent.x) ||
-            (xDelta > 0 && curMove.x > intent.x)) {
-            curMove.x = intent.x;
-        }
-        if ((zDelta < 0 && curMove.z < intent.z) ||
-            (zDelta > 0 && curMove.z > intent.z)) {
-            curMove.z = intent.z;
-        }
-
-        if ((colData.directions & Left && curMove.x < 0.f) ||
-            (colData.directions & Right && curMove.x > 0.f)) {
-            curMove.x = 0.f;
-        }
-        if ((colData.directions & Front && curMove.z > 0.f) ||
-            (colData.directions & Back && curMove.z < 0.f)) {
-            curMove.z = 0.f; 
-        }
+    // asleep, so nothing's changed
+    if (!entities.isAwake(entity)) {
+        return;
     }
+    getPixelPosFromRealPos(entities.getPos(entity), windowPos);
+
+    // every state's animation starts from its first frame
+    const ActorState state = entities.getState(entity);
+    animationTime = state == lastFrameState ? animationTime + deltaTime : 0.f;
+    lastFrameState = state;
 }
 
-void Actor::handleCollisions()
+void Actor::snapshot(ActorSnapshot& out) const
 {
-    collisionGeomCurrent.x = realpos.x + collisionGeometry.x;
-    collisionGeomCurrent.y1 = realpos.y + collisionGeometry.y1;
-    collisionGeomCurrent.y2 = realpos.y + collisionGeometry.y2;
-    collisionGeomCurrent.r = 0.5f;
-    collisionGeomCurrent.z = realpos.z + 2.f;
-    collisions = parentWindow.check_collision(collisionGeomCurrent);
+    out.texture = texture.get();
+    out.spriteRect = animations->getFrame(entities.getState(entity), animationTime);
+    out.prevPos = entities.getPrevPos(entity);
+    out.pos = entities.getPos(entity);
+    out.visible = visible;
 }
 
-void Actor::handleJump(float deltaTime)
+void Actor::saveState(StateWriter& out) const
 {
-        if(jumpEndTime == -1.f && intentMove.y != 0.f && state != ActorState::Hurt && state != ActorState::Jumping && getCollisions().directions & Down) {
-            state = ActorState::Jumping;
-            curMove.y = intentMove.y;
-            jumpEndTime = maxJumpTime;
-        } else if(jumpEndTime != -1.f) {
-            jumpEndTime -= deltaTime;
-            if (jumpEndTime <= 0 || intentMove.y == 0.f) {
-                jumpEndTime = -1.f;
-                intentMove.y = 0.f;
-                state = ActorState::Default;
-            }
-        }
-        if (collisions.directions & CollisionType::Up) {
-            jumpEndTime = -1.f;
-            state = ActorState::Default;
-        }
+    out.write(lastFrameState);
+    out.write(animationTime);
+    out.write(windowPos);
 }
 
-void Actor::handleGravity(float deltaTime)
+bool Actor::ReadState(StateReader& in, SavedState& out)
 {
-    if (jumpEndTime == -1.f) {
-        if (collisions.directions & Down) {
-            curMove.y = 0.0f;
-            for (const auto& colItem : collisions.collisions) {
-                if (colItem.direction & Down) {
-                    realpos.y = colItem.surface.dimensions.p1.y;
-                    break;
-                }
-            }
-        } else {
-            curMove.y -= gravity_accel * deltaTime;
-            if (curMove.y < MIN_PLAYER_Y_VELOCITY) {
-                curMove.y = MIN_PLAYER_Y_VELOCITY;
-            }
-        }
-    }
+    in.read(out.lastFrameState);
+    in.read(out.animationTime);
+    return in.read(out.windowPos);
 }
 
-/// <summary>
-/// draw a frame of an Actor
-/// </summary>
-/// <param name="parentWindow">the window this actor belongs to</param>
-/// <param name="deltaTime">the time (in seconds) elapsed since the last frame</param>
-void Actor::draw(float deltaTime, const pixelpos& camera)
+void Actor::loadState(const SavedState& state)
 {
-    const SDL_Rect& spriteRect = spriteProvider->getRect();
-    if(collisionGeometry.x == -1.f) {
-        collisionGeometry.x = float(spriteRect.x);
-        collisionGeometry.y1 = spriteRect.y - 1.f;
-        collisionGeometry.y2 = float(spriteRect.y);
-        collisionGeometry.r = 0.5f;
-        collisionGeometry.z = 2.f;
-    }
-
-    handleCollisions();
-    handleMovement(deltaTime, intentMove, curMove);
-    handleJump(deltaTime);
-    handleGravity(deltaTime);
-    realpos.y -= (curMove.y * deltaTime);
-    realpos.z += (curMove.z * deltaTime);
-    realpos.x += (curMove.x * deltaTime);
-    if (visible) {
-        getPixelPosFromRealPos(realpos, windowPos);
-        texture->draw(spriteRect.x, spriteRect.y, windowPos.x - camera.x, windowPos.y - camera.y, spriteRect.w, spriteRect.h);
-    }
-}
\ No newline at end of file
+    lastFrameState = state.lastFrameState;
+    animationTime = state.animationTime;
+    windowPos = state.windowPos;
+}
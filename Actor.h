@@ -6,6 +6,7 @@
 #include <memory>
 #include "Geometry.h"
 #include "GameWindow.h"
+#include "EntityStore.h"
 
 const float MAX_PLAYER_X_VELOCITY = 10.0f;
 const float MIN_PLAYER_Y_VELOCITY = -40.f;
@@ -17,40 +18,47 @@ const float DEFAULT_JUMP_TIME = 0.5f;
 class Actor
 {
     class GameWindow& parentWindow;
-    CollisionData collisions;
-    cylinder collisionGeometry;
-    cylinder collisionGeomCurrent;
-    tripoint realpos;
-    float jumpEndTime;
-    float maxJumpTime;
+    EntityStore& entities;
+    EntityStore::EntityId entity;
     ActorState lastFrameState;
-    MoveVector curMove;
-    std::unique_ptr<class Texture> texture;
-    std::unique_ptr<class SpriteProvider> spriteProvider;
+    std::shared_ptr<class Texture> texture;
+    std::shared_ptr<const class AnimationTable> animations;
+    // seconds the current state has been active, drives the animation
+    float animationTime;
     pixelpos windowPos;
 protected:
-    MoveVector intentMove;
-	ActorState state;
 	bool visible;
 
-    void handleCollisions();
-    virtual void handleMovement(float deltaTime, const MoveVector &intent, MoveVector &current);
-    void handleGravity(float deltaTime);
-    void handleJump(float deltaTime);
+    MoveVector getIntent() const { return entities.getIntent(entity); }
+    void setIntent(const MoveVector& intent) { entities.setIntent(entity, intent); }
 
 public:
-	Actor( GameWindow& parentWindow, struct SpriteConfig& spriteConfig, Texture* texture, const mappoint &mt);
+	Actor( GameWindow& parentWindow, EntityStore& entities, std::shared_ptr<const class AnimationTable> animations, std::shared_ptr<class Texture> texture, const mappoint &mt);
     virtual ~Actor();
 
-	ActorState GetState() { return state; }
-    const CollisionData& getCollisions() { return collisions; }
-    void draw(float deltaTime, const pixelpos& camera);
+	ActorState GetState() const { return entities.getState(entity); }
+    // catch up with the entity's latest simulation step, which EntityStore::update has already run
+    void update(float deltaTime);
+    void snapshot(struct ActorSnapshot& out) const;
 
-    const tripoint &getRealPos() const { return realpos; } 
+    tripoint getRealPos() const { return entities.getPos(entity); }
 
-    const cylinder &getCollisionGeometry() const { return collisionGeomCurrent; }
+    cylinder getCollisionGeometry() const { return entities.getCollisionCylinder(entity); }
 
     const pixelpos &getWindowPos() const { return windowPos; }
+    EntityStore::EntityId getEntity() const { return entity; }
+
+    // what the actor keeps outside the entity store, for capturing and restoring the world state
+    struct SavedState
+    {
+        ActorState lastFrameState;
+        float animationTime;
+        pixelpos windowPos;
+    };
+    void saveState(class StateWriter& out) const;
+    // read into out without touching any actor, so the whole world state can be checked before it's restored
+    static bool ReadState(class StateReader& in, SavedState& out);
+    void loadState(const SavedState& state);
 };
 
 class PlayerActor : public Actor
@@ -64,7 +72,7 @@ class PlayerActor : public Actor
     int getIntentFromKey(SDL_Keycode keyCode);
 
 public:
-    PlayerActor(GameWindow& parentWindow, SpriteConfig& spriteConfig, Texture* texture, const mappoint& mt);
+    PlayerActor(GameWindow& parentWindow, EntityStore& entities, std::shared_ptr<const class AnimationTable> animations, std::shared_ptr<class Texture> texture, const mappoint& mt);
     ~PlayerActor();
 
     void handle_input(const SDL_Event& event);
@@ -0,0 +1,263 @@
+#include "AnimationTable.h"
+#include "Assets.h"
+#include <cJSON/cJSON.h>
+#include <SDL2/SDL_log.h>
+#include <cstring>
+#include <numeric>
+
+const char AnimationTable::Magic[8] = { 'S', 'F', 'F', 'A', 'N', 'I', 'M', '\0' };
+
+namespace
+{
+    const uint32_t DefaultFrameMs = 100;
+
+    struct BinaryHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t tickMs;
+        uint32_t frameCount;
+        uint32_t tickCount;
+        uint32_t nameLength;
+        uint32_t reserved;
+    };
+
+    struct StateName
+    {
+        const char* name;
+        ActorState state;
+    };
+
+    const StateName stateNames[] = {
+        { "default", ActorState::Default },
+        { "idle", ActorState::Idle },
+        { "running", ActorState::Running },
+        { "jumping", ActorState::Jumping },
+        { "attacking", ActorState::Attacking },
+        { "looking_up", ActorState::LookingUp },
+        { "crouching", ActorState::Crouching },
+        { "hurt", ActorState::Hurt },
+        { "falling", ActorState::Falling },
+        { "dead", ActorState::Dead }
+    };
+
+    ActorState getStateByName(const char* name)
+    {
+        for (const auto& stateName : stateNames) {
+            if (strcmp(stateName.name, name) == 0) {
+                return stateName.state;
+            }
+        }
+        return ActorState::Invalid;
+    }
+
+    uint32_t readFrameMs(const cJSON* object, uint32_t fallback)
+    {
+        const cJSON* frameMs = cJSON_GetObjectItemCaseSensitive(object, "frame_ms");
+        return cJSON_IsNumber(frameMs) && frameMs->valueint > 0 ? uint32_t(frameMs->valueint) : fallback;
+    }
+}
+
+AnimationTable::AnimationTable() :
+    tickMs(DefaultFrameMs)
+{
+}
+
+std::string AnimationTable::CompiledPath(const std::string& jsonPath)
+{
+    size_t extension = jsonPath.rfind(".json");
+    return (extension == std::string::npos ? jsonPath : jsonPath.substr(0, extension)) + ".anim";
+}
+
+AnimationTable* AnimationTable::Create(const std::string& jsonPath)
+{
+    std::string data;
+    if (Assets::ReadFile(CompiledPath(jsonPath), data)) {
+        AnimationTable* table = FromBinary(data);
+        if (table != nullptr) {
+            return table;
+        }
+        SDL_Log("Ignoring stale or corrupt %s", CompiledPath(jsonPath).c_str());
+    }
+    if (!Assets::ReadFile(jsonPath, data)) {
+        SDL_Log("Failed to read sprite config %s", jsonPath.c_str());
+        return nullptr;
+    }
+    AnimationTable* table = FromJson(data);
+    if (table == nullptr) {
+        SDL_Log("Failed to parse sprite config %s", jsonPath.c_str());
+    }
+    return table;
+}
+
+AnimationTable* AnimationTable::FromJson(const std::string& data)
+{
+    AnimationTable* table = new AnimationTable();
+    if (!table->parseJson(data.data(), data.size())) {
+        delete table;
+        return nullptr;
+    }
+    return table;
+}
+
+AnimationTable* AnimationTable::FromBinary(const std::string& data)
+{
+    AnimationTable* table = new AnimationTable();
+    if (!table->parseBinary(data.data(), data.size())) {
+        delete table;
+        return nullptr;
+    }
+    return table;
+}
+
+bool AnimationTable::parseJson(const char* data, size_t length)
+{
+    cJSON* json = cJSON_ParseWithLength(data, length);
+    if (json == nullptr) {
+        return false;
+    }
+    const cJSON* nameJson = cJSON_GetObjectItemCaseSensitive(json, "name");
+    if (cJSON_IsString(nameJson)) {
+        name = nameJson->valuestring;
+    }
+    const uint32_t defaultFrameMs = readFrameMs(json, DefaultFrameMs);
+
+    struct Frame
+    {
+        SDL_Rect rect;
+        uint32_t durationMs;
+    };
+    std::array<std::vector<Frame>, ActorStateCount> stateFrames;
+    std::array<bool, ActorStateCount> stateLoops;
+    stateLoops.fill(true);
+    const cJSON* groups = cJSON_GetObjectItemCaseSensitive(json, "sprite_groups");
+    const cJSON* group = nullptr;
+    cJSON_ArrayForEach(group, groups) {
+        const cJSON* groupName = cJSON_GetObjectItemCaseSensitive(group, "group_name");
+        ActorState state = cJSON_IsString(groupName) ? getStateByName(groupName->valuestring) : ActorState::Invalid;
+        if (state == ActorState::Invalid) {
+            SDL_Log("Ignoring sprite group with unknown state %s", cJSON_IsString(groupName) ? groupName->valuestring : "(none)");
+            continue;
+        }
+        const uint32_t groupFrameMs = readFrameMs(group, defaultFrameMs);
+        const cJSON* loop = cJSON_GetObjectItemCaseSensitive(group, "loop");
+        stateLoops[size_t(state)] = !cJSON_IsFalse(loop);
+        const cJSON* sprite = nullptr;
+        // each sprite is [x, y, w, h] or [x, y, w, h, duration in ms]
+        cJSON_ArrayForEach(sprite, cJSON_GetObjectItemCaseSensitive(group, "sprites")) {
+            int values[5] = { 0, 0, 0, 0, int(groupFrameMs) };
+            int count = 0;
+            const cJSON* value = nullptr;
+            cJSON_ArrayForEach(value, sprite) {
+                if (count < 5) {
+                    values[count++] = value->valueint;
+                }
+            }
+            if (count < 4 || values[4] <= 0) {
+                continue;
+            }
+            stateFrames[size_t(state)].push_back({ { values[0], values[1], values[2], values[3] }, uint32_t(values[4]) });
+        }
+    }
+    cJSON_Delete(json);
+
+    // one tick is the largest step every frame duration is a whole number of
+    uint32_t quantum = 0;
+    for (const auto& framesForState : stateFrames) {
+        for (const Frame& frame : framesForState) {
+            quantum = std::gcd(quantum, frame.durationMs);
+        }
+    }
+    if (quantum == 0) {
+        return false;
+    }
+    tickMs = quantum;
+    for (size_t state = 0; state < ActorStateCount; state++) {
+        Animation& animation = animations[state];
+        animation.firstFrame = uint32_t(frames.size());
+        animation.frameCount = uint32_t(stateFrames[state].size());
+        animation.firstTick = uint32_t(tickFrames.size());
+        animation.loops = stateLoops[state] ? 1 : 0;
+        for (uint32_t i = 0; i < animation.frameCount; i++) {
+            const Frame& frame = stateFrames[state][i];
+            frames.push_back(frame.rect);
+            tickFrames.insert(tickFrames.end(), frame.durationMs / tickMs, uint16_t(i));
+        }
+        animation.tickCount = uint32_t(tickFrames.size()) - animation.firstTick;
+    }
+    // states the config has nothing for show the default animation, or failing that the first one there is
+    const Animation* fallback = animations[size_t(ActorState::Default)].frameCount != 0 ? &animations[size_t(ActorState::Default)] : nullptr;
+    for (size_t state = 0; state < ActorStateCount && fallback == nullptr; state++) {
+        if (animations[state].frameCount != 0) {
+            fallback = &animations[state];
+        }
+    }
+    for (Animation& animation : animations) {
+        if (animation.frameCount == 0) {
+            animation = *fallback;
+        }
+    }
+    return true;
+}
+
+void AnimationTable::serialize(std::vector<char>& out) const
+{
+    BinaryHeader header{};
+    memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.tickMs = tickMs;
+    header.frameCount = uint32_t(frames.size());
+    header.tickCount = uint32_t(tickFrames.size());
+    header.nameLength = uint32_t(name.size());
+    auto append = [&out](const void* data, size_t length) {
+        out.insert(out.end(), static_cast<const char*>(data), static_cast<const char*>(data) + length);
+    };
+    out.clear();
+    append(&header, sizeof(header));
+    append(animations.data(), sizeof(Animation) * animations.size());
+    append(frames.data(), sizeof(SDL_Rect) * frames.size());
+    append(tickFrames.data(), sizeof(uint16_t) * tickFrames.size());
+    append(name.data(), name.size());
+}
+
+bool AnimationTable::parseBinary(const char* data, size_t length)
+{
+    BinaryHeader header;
+    if (length < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version || header.tickMs == 0) {
+        return false;
+    }
+    const size_t expected = sizeof(header) + sizeof(Animation) * animations.size() + sizeof(SDL_Rect) * size_t(header.frameCount) +
+        sizeof(uint16_t) * size_t(header.tickCount) + header.nameLength;
+    if (length != expected) {
+        return false;
+    }
+    const char* cursor = data + sizeof(header);
+    tickMs = header.tickMs;
+    memcpy(animations.data(), cursor, sizeof(Animation) * animations.size());
+    cursor += sizeof(Animation) * animations.size();
+    frames.resize(header.frameCount);
+    memcpy(frames.data(), cursor, sizeof(SDL_Rect) * frames.size());
+    cursor += sizeof(SDL_Rect) * frames.size();
+    tickFrames.resize(header.tickCount);
+    memcpy(tickFrames.data(), cursor, sizeof(uint16_t) * tickFrames.size());
+    cursor += sizeof(uint16_t) * tickFrames.size();
+    name.assign(cursor, header.nameLength);
+
+    // getFrame trusts the table, so make sure nothing in it points outside
+    for (const Animation& animation : animations) {
+        if (animation.tickCount == 0 || uint64_t(animation.firstTick) + animation.tickCount > tickFrames.size()) {
+            return false;
+        }
+        for (uint32_t tick = 0; tick < animation.tickCount; tick++) {
+            if (tickFrames[animation.firstTick + tick] >= animation.frameCount ||
+                uint64_t(animation.firstFrame) + animation.frameCount > frames.size()) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <SDL2/SDL_rect.h>
+#include "ActorState.h"
+
+const size_t ActorStateCount = size_t(ActorState::Dead) + 1;
+
+/// @brief A sprite's animations, flattened into a table indexed directly by ActorState. Every animation is
+/// also expanded into one frame index per tick (the greatest common divisor of all frame durations), so
+/// finding the frame for a state and time is a couple of array lookups. Read-only once built, so any
+/// number of actors can share one
+class AnimationTable
+{
+public:
+    static const uint32_t Version = 1;
+    static const char Magic[8];
+
+    struct Animation
+    {
+        uint32_t firstFrame = 0;
+        uint32_t frameCount = 0;
+        uint32_t firstTick = 0;
+        uint32_t tickCount = 0;
+        uint32_t loops = 1;
+    };
+
+private:
+    std::string name;
+    uint32_t tickMs;
+    std::array<Animation, ActorStateCount> animations;
+    std::vector<SDL_Rect> frames;
+    std::vector<uint16_t> tickFrames;
+
+    AnimationTable();
+    bool parseJson(const char* data, size_t length);
+    bool parseBinary(const char* data, size_t length);
+public:
+    /// @brief Load a sprite config, preferring its compiled form (same path with .anim for .json) if there is one
+    static AnimationTable* Create(const std::string& jsonPath);
+    static AnimationTable* FromJson(const std::string& data);
+    static AnimationTable* FromBinary(const std::string& data);
+    static std::string CompiledPath(const std::string& jsonPath);
+
+    /// @brief The compiled form: the table as it sits in memory, behind a small header
+    void serialize(std::vector<char>& out) const;
+
+    /// @brief Frame to draw for a state after it has been active for the given number of seconds
+    const SDL_Rect& getFrame(ActorState state, float time) const
+    {
+        const Animation& animation = animations[size_t(state) < ActorStateCount ? size_t(state) : size_t(ActorState::Default)];
+        uint32_t tick = uint32_t(time * 1000.f) / tickMs;
+        tick = animation.loops ? tick % animation.tickCount : (tick < animation.tickCount ? tick : animation.tickCount - 1);
+        return frames[animation.firstFrame + tickFrames[animation.firstTick + tick]];
+    }
+
+    const std::string& getName() const { return name; }
+};
@@ -0,0 +1,146 @@
+#include "AssetPack.h"
+#include "MappedFile.h"
+#include <SDL2/SDL_log.h>
+#include <zstd.h>
+#include <filesystem>
+#include <cstring>
+
+const char AssetPack::Magic[8] = { 'S', 'F', 'F', 'P', 'A', 'C', 'K', '\0' };
+
+std::string AssetPack::NormalizePath(const std::string& path)
+{
+    return std::filesystem::path(path).lexically_normal().generic_string();
+}
+
+uint64_t AssetPack::HashPath(const std::string& normalizedPath)
+{
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : normalizedPath) {
+        hash = (hash ^ uint8_t(c)) * 1099511628211ull;
+    }
+    return hash;
+}
+
+AssetPack::AssetPack() :
+    header(nullptr),
+    toc(nullptr),
+    names(nullptr),
+    dictionary(nullptr)
+{
+}
+
+AssetPack::~AssetPack()
+{
+    if (dictionary != nullptr) {
+        ZSTD_freeDDict(dictionary);
+    }
+}
+
+AssetPack* AssetPack::Open(const std::string& path)
+{
+    std::unique_ptr<MappedFile> file(MappedFile::Open(path));
+    if (file == nullptr) {
+        return nullptr;
+    }
+    const uint8_t* data = file->getData();
+    const size_t size = file->getSize();
+    if (size < sizeof(Header)) {
+        SDL_Log("Not an asset pack: %s", path.c_str());
+        return nullptr;
+    }
+    const Header* header = reinterpret_cast<const Header*>(data);
+    if (memcmp(header->magic, Magic, sizeof(Magic)) != 0 || header->version != Version) {
+        SDL_Log("Not an asset pack, or one from another version: %s", path.c_str());
+        return nullptr;
+    }
+    if (header->tocOffset % alignof(TocEntry) != 0 ||
+        header->tocOffset + uint64_t(header->entryCount) * sizeof(TocEntry) > size ||
+        header->namesOffset + header->namesSize > size ||
+        header->dictionaryOffset + header->dictionarySize > size) {
+        SDL_Log("Asset pack is truncated: %s", path.c_str());
+        return nullptr;
+    }
+
+    AssetPack* pack = new AssetPack();
+    pack->header = header;
+    pack->toc = reinterpret_cast<const TocEntry*>(data + header->tocOffset);
+    pack->names = reinterpret_cast<const char*>(data + header->namesOffset);
+    if (header->dictionarySize != 0) {
+        pack->dictionary = ZSTD_createDDict(data + header->dictionaryOffset, size_t(header->dictionarySize));
+    }
+    pack->file = std::move(file);
+    return pack;
+}
+
+const AssetPack::TocEntry* AssetPack::find(const std::string& path) const
+{
+    const std::string normalized = NormalizePath(path);
+    const uint64_t hash = HashPath(normalized);
+    size_t low = 0;
+    size_t high = header->entryCount;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        if (toc[middle].pathHash < hash) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low == header->entryCount || toc[low].pathHash != hash) {
+        return nullptr;
+    }
+    const TocEntry& entry = toc[low];
+    // the packer refuses hash collisions, but a different path can still land on an entry's hash
+    if (entry.nameOffset + uint64_t(entry.nameLength) > header->namesSize ||
+        normalized.size() != entry.nameLength || memcmp(names + entry.nameOffset, normalized.data(), entry.nameLength) != 0) {
+        return nullptr;
+    }
+    if (entry.offset + entry.storedSize > file->getSize()) {
+        return nullptr;
+    }
+    // an entry stored as is is read straight out of the mapping, so it must be exactly as long as it claims
+    if (!(entry.flags & Compressed) && entry.size != entry.storedSize) {
+        return nullptr;
+    }
+    return &entry;
+}
+
+const uint8_t* AssetPack::getStoredData(const TocEntry& entry) const
+{
+    return file->getData() + entry.offset;
+}
+
+bool AssetPack::read(const TocEntry& entry, void* destination, size_t capacity) const
+{
+    if (capacity < entry.size) {
+        return false;
+    }
+    const uint8_t* stored = getStoredData(entry);
+    if (!(entry.flags & Compressed)) {
+        memcpy(destination, stored, size_t(entry.size));
+        return true;
+    }
+    // one decompression context per thread, so workers can read assets in parallel
+    thread_local std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx*)> context(ZSTD_createDCtx(), ZSTD_freeDCtx);
+    size_t result;
+    if (entry.flags & UsesDictionary) {
+        if (dictionary == nullptr) {
+            return false;
+        }
+        result = ZSTD_decompress_usingDDict(context.get(), destination, capacity, stored, size_t(entry.storedSize), dictionary);
+    } else {
+        result = ZSTD_decompressDCtx(context.get(), destination, capacity, stored, size_t(entry.storedSize));
+    }
+    if (ZSTD_isError(result) || result != entry.size) {
+        SDL_Log("Failed to decompress %.*s: %s", int(entry.nameLength), names + entry.nameOffset,
+            ZSTD_isError(result) ? ZSTD_getErrorName(result) : "size mismatch");
+        return false;
+    }
+    return true;
+}
+
+uint32_t AssetPack::getEntryCount() const
+{
+    return header->entryCount;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// @brief Read-only view of a single-file asset pack: a header, every asset as its own zstd frame
+/// (or stored as-is when compressing doesn't pay off, e.g. PNGs), an optional shared zstd dictionary,
+/// then a table of contents sorted by path hash. The whole file is memory mapped and the table of
+/// contents used in place, so finding an asset costs a binary search and no I/O
+class AssetPack
+{
+public:
+    static const uint32_t Version = 1;
+
+    enum EntryFlags : uint32_t
+    {
+        Compressed = 1,
+        UsesDictionary = 2
+    };
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t entryCount;
+        uint64_t tocOffset;
+        uint64_t namesOffset;
+        uint64_t namesSize;
+        uint64_t dictionaryOffset;
+        uint64_t dictionarySize;
+    };
+
+    struct TocEntry
+    {
+        uint64_t pathHash;
+        uint64_t offset;
+        uint64_t storedSize;
+        uint64_t size;
+        uint32_t nameOffset;
+        uint32_t nameLength;
+        uint32_t flags;
+        uint32_t reserved;
+    };
+
+    static const char Magic[8];
+
+    // assets are looked up by their path relative to the working directory, e.g. "assets/robotropolis.tmj"
+    static std::string NormalizePath(const std::string& path);
+    static uint64_t HashPath(const std::string& normalizedPath);
+
+private:
+    std::unique_ptr<class MappedFile> file;
+    const Header* header;
+    const TocEntry* toc;
+    const char* names;
+    struct ZSTD_DDict_s* dictionary;
+    AssetPack();
+public:
+    static AssetPack* Open(const std::string& path);
+    ~AssetPack();
+
+    const TocEntry* find(const std::string& path) const;
+    /// @brief Where an entry's stored bytes sit in the mapping; for uncompressed entries these are the asset itself
+    const uint8_t* getStoredData(const TocEntry& entry) const;
+    /// @brief Decompress (or copy) an entry. Safe to call from several threads at once
+    bool read(const TocEntry& entry, void* destination, size_t capacity) const;
+
+    uint32_t getEntryCount() const;
+};
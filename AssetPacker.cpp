@@ -0,0 +1,308 @@
+// Builds the asset pack the game reads at startup:
+//     asset_packer <output.pack> <asset directory>... [--level N] [--dictionary KB]
+// Every file below each directory is stored under "<directory name>/<path inside it>", which is
+// the path the game opens it by. Sprite configs (JSON under a sprites directory) are also stored
+// compiled to animation tables, and tileset configs (JSON directly in an asset directory) compiled
+// to the form TilesetConfig loads in place.
+//     asset_packer --compile-tileset <config.json> [output.tsc]
+// regenerates a loose compiled tileset config, for running without a pack, and
+//     asset_packer --bench-tileset <config.json> [iterations]
+// compiles it the same way, then times loading the tileset config as the game does with the compiled form
+// beside it against reading and parsing the JSON.
+
+#include "AssetPack.h"
+#include "Assets.h"
+#include "AnimationTable.h"
+#include "TilesetConfig.h"
+#include <zstd.h>
+#include <zdict.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <cstring>
+
+namespace fs = std::filesystem;
+
+struct PackInput
+{
+    std::string name;
+    std::vector<char> data;
+    std::vector<char> stored;
+    uint32_t flags = 0;
+};
+
+static bool readWholeFile(const fs::path& path, std::vector<char>& data)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+// images are compressed already, so only text-like assets are worth training a dictionary on
+static bool isDictionaryCandidate(const std::string& name)
+{
+    std::string extension = fs::path(name).extension().string();
+    return extension == ".json" || extension == ".tmj" || extension == ".tmx" || extension == ".tsx";
+}
+
+static void writePadding(std::ofstream& out, size_t alignment)
+{
+    static const char zeros[16] = {};
+    size_t position = size_t(out.tellp());
+    if (position % alignment != 0) {
+        out.write(zeros, std::streamsize(alignment - position % alignment));
+    }
+}
+
+static int compileTileset(const fs::path& jsonPath, const fs::path& outputPath)
+{
+    std::vector<char> json;
+    if (!readWholeFile(jsonPath, json)) {
+        std::cerr << "Failed to read " << jsonPath << std::endl;
+        return 1;
+    }
+    std::unique_ptr<TilesetConfig> config(TilesetConfig::FromJson(json.data(), json.size()));
+    if (config == nullptr) {
+        std::cerr << "Failed to compile tileset config " << jsonPath << std::endl;
+        return 1;
+    }
+    std::vector<char> compiled;
+    config->serialize(compiled);
+    std::ofstream out(outputPath, std::ios::binary | std::ios::trunc);
+    out.write(compiled.data(), std::streamsize(compiled.size()));
+    if (!out.good()) {
+        std::cerr << "Failed to write " << outputPath << std::endl;
+        return 1;
+    }
+    std::cout << "Compiled " << jsonPath.generic_string() << " from " << json.size() << " to " << compiled.size() << " bytes" << std::endl;
+    return 0;
+}
+
+// times the two ways the game can load a tileset config, from the file on: TilesetConfig::Create finding the
+// compiled form beside the JSON, mapping it and checking it's up to date, against reading and parsing the JSON
+static int benchTileset(const fs::path& jsonPath, int iterations)
+{
+    // written fresh, so Create takes it rather than falling back to the JSON
+    const fs::path compiledPath = TilesetConfig::CompiledPath(jsonPath.generic_string());
+    if (compileTileset(jsonPath, compiledPath) != 0) {
+        return 1;
+    }
+    const std::string path = jsonPath.generic_string();
+    const uintmax_t jsonSize = fs::file_size(jsonPath);
+    const uintmax_t compiledSize = fs::file_size(compiledPath);
+
+    auto time = [iterations](auto&& load) {
+        auto start = std::chrono::steady_clock::now();
+        size_t loaded = 0;
+        for (int i = 0; i < iterations; i++) {
+            std::unique_ptr<TilesetConfig> result(load());
+            loaded += result != nullptr ? result->getObjectCount() + 1 : 0;
+        }
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        return loaded != 0 ? elapsed.count() / iterations : -1.0;
+    };
+    const double jsonUs = time([&]() -> TilesetConfig* {
+        std::string json;
+        return Assets::ReadFile(path, json) ? TilesetConfig::FromJson(json.data(), json.size()) : nullptr;
+    });
+    const double compiledUs = time([&]() { return TilesetConfig::Create(path); });
+    if (jsonUs < 0.0 || compiledUs < 0.0) {
+        std::cerr << "Loading " << jsonPath << " failed during the benchmark" << std::endl;
+        return 1;
+    }
+    std::cout << jsonPath.generic_string() << ", " << iterations << " loads each:" << std::endl;
+    std::cout << "  json     " << jsonSize << " bytes, " << jsonUs << " us per load" << std::endl;
+    std::cout << "  compiled " << compiledSize << " bytes, " << compiledUs << " us per load (" << jsonUs / compiledUs << "x faster)" << std::endl;
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc >= 3 && strcmp(argv[1], "--compile-tileset") == 0) {
+        return compileTileset(argv[2], argc >= 4 ? fs::path(argv[3]) : fs::path(TilesetConfig::CompiledPath(argv[2])));
+    }
+    if (argc >= 3 && strcmp(argv[1], "--bench-tileset") == 0) {
+        return benchTileset(argv[2], argc >= 4 ? std::max(atoi(argv[3]), 1) : 1000);
+    }
+    if (argc < 3) {
+        std::cerr << "usage: asset_packer <output.pack> <asset directory>... [--level N] [--dictionary KB]" << std::endl;
+        std::cerr << "       asset_packer --compile-tileset <config.json> [output.tsc]" << std::endl;
+        std::cerr << "       asset_packer --bench-tileset <config.json> [iterations]" << std::endl;
+        return 1;
+    }
+    const std::string outputPath = argv[1];
+    std::vector<fs::path> directories;
+    int level = 19;
+    size_t dictionaryCapacity = 0;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--level") == 0 && i + 1 < argc) {
+            level = std::clamp(atoi(argv[++i]), 1, ZSTD_maxCLevel());
+        } else if (strcmp(argv[i], "--dictionary") == 0 && i + 1 < argc) {
+            dictionaryCapacity = size_t(strtoul(argv[++i], nullptr, 10)) * 1024;
+        } else {
+            directories.push_back(fs::path(argv[i]).lexically_normal());
+        }
+    }
+
+    std::vector<PackInput> inputs;
+    for (fs::path directory : directories) {
+        if (!directory.has_filename()) {
+            directory = directory.parent_path();
+        }
+        for (const auto& item : fs::recursive_directory_iterator(directory)) {
+            if (!item.is_regular_file()) {
+                continue;
+            }
+            PackInput& input = inputs.emplace_back();
+            input.name = AssetPack::NormalizePath((directory.filename() / fs::relative(item.path(), directory)).generic_string());
+            if (!readWholeFile(item.path(), input.data)) {
+                std::cerr << "Failed to read " << item.path() << std::endl;
+                return 1;
+            }
+        }
+    }
+    // sprite and tileset configs also go in compiled, which is what the game loads when it's there
+    const size_t looseCount = inputs.size();
+    for (size_t i = 0; i < looseCount; i++) {
+        if (fs::path(inputs[i].name).extension() != ".json") {
+            continue;
+        }
+        if (inputs[i].name.find('/') == inputs[i].name.rfind('/')) {
+            std::unique_ptr<TilesetConfig> config(TilesetConfig::FromJson(inputs[i].data.data(), inputs[i].data.size()));
+            if (config == nullptr) {
+                std::cerr << "Failed to compile tileset config " << inputs[i].name << std::endl;
+                return 1;
+            }
+            PackInput compiled;
+            compiled.name = TilesetConfig::CompiledPath(inputs[i].name);
+            config->serialize(compiled.data);
+            inputs.push_back(std::move(compiled));
+            continue;
+        }
+        if (inputs[i].name.find("/sprites/") == std::string::npos) {
+            continue;
+        }
+        std::unique_ptr<AnimationTable> table(AnimationTable::FromJson(std::string(inputs[i].data.begin(), inputs[i].data.end())));
+        if (table == nullptr) {
+            std::cerr << "Failed to compile sprite config " << inputs[i].name << std::endl;
+            return 1;
+        }
+        PackInput compiled;
+        compiled.name = AnimationTable::CompiledPath(inputs[i].name);
+        table->serialize(compiled.data);
+        inputs.push_back(std::move(compiled));
+    }
+    std::sort(inputs.begin(), inputs.end(), [](const PackInput& a, const PackInput& b) {
+        return AssetPack::HashPath(a.name) < AssetPack::HashPath(b.name);
+    });
+    for (size_t i = 1; i < inputs.size(); i++) {
+        if (AssetPack::HashPath(inputs[i].name) == AssetPack::HashPath(inputs[i - 1].name)) {
+            std::cerr << "Path hash collision between " << inputs[i - 1].name << " and " << inputs[i].name << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<char> dictionary;
+    if (dictionaryCapacity != 0) {
+        std::vector<char> samples;
+        std::vector<size_t> sampleSizes;
+        for (const auto& input : inputs) {
+            if (isDictionaryCandidate(input.name)) {
+                samples.insert(samples.end(), input.data.begin(), input.data.end());
+                sampleSizes.push_back(input.data.size());
+            }
+        }
+        dictionary.resize(dictionaryCapacity);
+        size_t dictionarySize = ZDICT_trainFromBuffer(dictionary.data(), dictionary.size(), samples.data(), sampleSizes.data(), unsigned(sampleSizes.size()));
+        if (ZDICT_isError(dictionarySize)) {
+            // too few or too small samples is common for a small asset set, so carry on without one
+            std::cerr << "Not using a dictionary: " << ZDICT_getErrorName(dictionarySize) << std::endl;
+            dictionary.clear();
+        } else {
+            dictionary.resize(dictionarySize);
+        }
+    }
+
+    std::unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx*)> context(ZSTD_createCCtx(), ZSTD_freeCCtx);
+    std::unique_ptr<ZSTD_CDict, size_t (*)(ZSTD_CDict*)> compressionDictionary(
+        dictionary.empty() ? nullptr : ZSTD_createCDict(dictionary.data(), dictionary.size(), level), ZSTD_freeCDict);
+    size_t totalSize = 0;
+    size_t totalStored = 0;
+    for (auto& input : inputs) {
+        input.stored.resize(ZSTD_compressBound(input.data.size()));
+        const bool useDictionary = compressionDictionary != nullptr && isDictionaryCandidate(input.name);
+        size_t compressedSize = useDictionary ?
+            ZSTD_compress_usingCDict(context.get(), input.stored.data(), input.stored.size(), input.data.data(), input.data.size(), compressionDictionary.get()) :
+            ZSTD_compressCCtx(context.get(), input.stored.data(), input.stored.size(), input.data.data(), input.data.size(), level);
+        if (ZSTD_isError(compressedSize)) {
+            std::cerr << "Failed to compress " << input.name << ": " << ZSTD_getErrorName(compressedSize) << std::endl;
+            return 1;
+        }
+        // keep it as-is unless compressing saves a few percent, so it can be used straight from the mapping.
+        // Compiled tileset configs are always kept as-is, since being used in place is their point
+        const bool inPlace = fs::path(input.name).extension() == ".tsc";
+        if (!inPlace && compressedSize + compressedSize / 32 < input.data.size()) {
+            input.stored.resize(compressedSize);
+            input.flags = AssetPack::Compressed | (useDictionary ? AssetPack::UsesDictionary : 0);
+        } else {
+            input.stored = input.data;
+        }
+        totalSize += input.data.size();
+        totalStored += input.stored.size();
+    }
+
+    std::ofstream out(outputPath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Failed to create " << outputPath << std::endl;
+        return 1;
+    }
+    AssetPack::Header header{};
+    memcpy(header.magic, AssetPack::Magic, sizeof(header.magic));
+    header.version = AssetPack::Version;
+    header.entryCount = uint32_t(inputs.size());
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    std::vector<AssetPack::TocEntry> toc;
+    std::string names;
+    for (const auto& input : inputs) {
+        AssetPack::TocEntry entry{};
+        entry.pathHash = AssetPack::HashPath(input.name);
+        entry.offset = uint64_t(out.tellp());
+        entry.storedSize = input.stored.size();
+        entry.size = input.data.size();
+        entry.nameOffset = uint32_t(names.size());
+        entry.nameLength = uint32_t(input.name.size());
+        entry.flags = input.flags;
+        toc.push_back(entry);
+        names += input.name;
+        out.write(input.stored.data(), std::streamsize(input.stored.size()));
+    }
+    header.dictionaryOffset = uint64_t(out.tellp());
+    header.dictionarySize = dictionary.size();
+    out.write(dictionary.data(), std::streamsize(dictionary.size()));
+    writePadding(out, alignof(AssetPack::TocEntry));
+    header.tocOffset = uint64_t(out.tellp());
+    out.write(reinterpret_cast<const char*>(toc.data()), std::streamsize(toc.size() * sizeof(AssetPack::TocEntry)));
+    header.namesOffset = uint64_t(out.tellp());
+    header.namesSize = names.size();
+    out.write(names.data(), std::streamsize(names.size()));
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!out.good()) {
+        std::cerr << "Failed to write " << outputPath << std::endl;
+        return 1;
+    }
+
+    std::cout << "Packed " << inputs.size() << " assets, " << totalSize / 1024 << " KB into " << totalStored / 1024 << " KB";
+    if (!dictionary.empty()) {
+        std::cout << " with a " << dictionary.size() / 1024 << " KB dictionary";
+    }
+    std::cout << std::endl;
+    return 0;
+}
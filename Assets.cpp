@@ -0,0 +1,149 @@
+#include "Assets.h"
+#include "AssetPack.h"
+#include <SDL2/SDL.h>
+#include <memory>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+    std::unique_ptr<AssetPack> mountedPack;
+
+    // a decompressed asset, owned by the SDL_RWops reading it
+    struct BufferStream
+    {
+        std::vector<uint8_t> data;
+        size_t position = 0;
+    };
+
+    BufferStream* getStream(SDL_RWops* context)
+    {
+        return static_cast<BufferStream*>(context->hidden.unknown.data1);
+    }
+
+    Sint64 streamSize(SDL_RWops* context)
+    {
+        return Sint64(getStream(context)->data.size());
+    }
+
+    Sint64 streamSeek(SDL_RWops* context, Sint64 offset, int whence)
+    {
+        BufferStream* stream = getStream(context);
+        Sint64 base = 0;
+        if (whence == RW_SEEK_CUR) {
+            base = Sint64(stream->position);
+        } else if (whence == RW_SEEK_END) {
+            base = Sint64(stream->data.size());
+        }
+        Sint64 position = base + offset;
+        if (position < 0 || position > Sint64(stream->data.size())) {
+            return SDL_SetError("Seek out of range");
+        }
+        stream->position = size_t(position);
+        return position;
+    }
+
+    size_t streamRead(SDL_RWops* context, void* ptr, size_t size, size_t maxnum)
+    {
+        BufferStream* stream = getStream(context);
+        if (size == 0) {
+            return 0;
+        }
+        size_t count = std::min(maxnum, (stream->data.size() - stream->position) / size);
+        memcpy(ptr, stream->data.data() + stream->position, count * size);
+        stream->position += count * size;
+        return count;
+    }
+
+    size_t streamWrite(SDL_RWops* context, const void* ptr, size_t size, size_t num)
+    {
+        SDL_SetError("Assets are read-only");
+        return 0;
+    }
+
+    int streamClose(SDL_RWops* context)
+    {
+        delete getStream(context);
+        SDL_FreeRW(context);
+        return 0;
+    }
+}
+
+bool Assets::Mount(const std::string& packPath)
+{
+    AssetPack* pack = AssetPack::Open(packPath);
+    if (pack == nullptr) {
+        return false;
+    }
+    mountedPack.reset(pack);
+    SDL_Log("Mounted asset pack %s with %u entries", packPath.c_str(), pack->getEntryCount());
+    return true;
+}
+
+void Assets::Unmount()
+{
+    mountedPack.reset();
+}
+
+bool Assets::IsMounted()
+{
+    return mountedPack != nullptr;
+}
+
+SDL_RWops* Assets::Open(const std::string& path)
+{
+    const AssetPack::TocEntry* entry = mountedPack != nullptr ? mountedPack->find(path) : nullptr;
+    if (entry == nullptr) {
+        return SDL_RWFromFile(path.c_str(), "rb");
+    }
+    if (!(entry->flags & AssetPack::Compressed)) {
+        return SDL_RWFromConstMem(mountedPack->getStoredData(*entry), int(entry->size));
+    }
+
+    auto stream = std::make_unique<BufferStream>();
+    stream->data.resize(size_t(entry->size));
+    if (!mountedPack->read(*entry, stream->data.data(), stream->data.size())) {
+        SDL_SetError("Failed to read %s from the asset pack", path.c_str());
+        return nullptr;
+    }
+    SDL_RWops* rw = SDL_AllocRW();
+    if (rw == nullptr) {
+        return nullptr;
+    }
+    rw->size = streamSize;
+    rw->seek = streamSeek;
+    rw->read = streamRead;
+    rw->write = streamWrite;
+    rw->close = streamClose;
+    rw->type = SDL_RWOPS_UNKNOWN;
+    rw->hidden.unknown.data1 = stream.release();
+    return rw;
+}
+
+bool Assets::ReadFile(const std::string& path, std::string& contents)
+{
+    const AssetPack::TocEntry* entry = mountedPack != nullptr ? mountedPack->find(path) : nullptr;
+    if (entry != nullptr) {
+        contents.resize(size_t(entry->size));
+        return mountedPack->read(*entry, contents.data(), contents.size());
+    }
+    size_t length = 0;
+    void* data = SDL_LoadFile(path.c_str(), &length);
+    if (data == nullptr) {
+        return false;
+    }
+    contents.assign(static_cast<const char*>(data), length);
+    SDL_free(data);
+    return true;
+}
+
+const uint8_t* Assets::GetInPlace(const std::string& path, size_t& size)
+{
+    const AssetPack::TocEntry* entry = mountedPack != nullptr ? mountedPack->find(path) : nullptr;
+    if (entry == nullptr || (entry->flags & AssetPack::Compressed)) {
+        return nullptr;
+    }
+    size = size_t(entry->size);
+    return mountedPack->getStoredData(*entry);
+}
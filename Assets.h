@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct SDL_RWops;
+
+/// @brief Where the game gets its files from: the mounted asset pack if there is one and it has the file,
+/// otherwise the loose file on disk
+namespace Assets
+{
+    /// @brief Use an asset pack for every following read. Returns false, leaving loose files in use, if it can't be opened
+    bool Mount(const std::string& packPath);
+    void Unmount();
+    bool IsMounted();
+
+    /// @brief Open an asset for reading. Uncompressed pack entries are read straight from the mapping,
+    /// compressed ones are decompressed into a buffer the stream frees on close
+    SDL_RWops* Open(const std::string& path);
+    /// @brief Read a whole asset, e.g. to hand to a parser
+    bool ReadFile(const std::string& path, std::string& contents);
+    /// @brief An asset's contents where they sit in the mounted pack's mapping, valid until it's unmounted.
+    /// nullptr when the pack doesn't have it or it's stored compressed
+    const uint8_t* GetInPlace(const std::string& path, size_t& size);
+}
@@ -0,0 +1,200 @@
+#include "ChunkStreamer.h"
+#include "MapLayer.h"
+#include "Texture.h"
+#include <tmxlite/Map.hpp>
+#include <algorithm>
+
+ChunkStreamer::ChunkStreamer(const tmx::Map& map, const LayerTiles& layerTiles, const std::vector<std::shared_ptr<Texture>>& textures, size_t memoryBudget) :
+    map(map),
+    layerTiles(layerTiles),
+    textures(textures),
+    memoryBudget(memoryBudget),
+    residentBytes(0),
+    frame(0),
+    visibleChunks{ { 0, 0 }, { 0, 0 } },
+    building(NoChunk),
+    stopping(false)
+{
+    const auto& mapLayers = map.getLayers();
+    for (auto i = 0u; i < mapLayers.size(); ++i) {
+        if (mapLayers[i]->getType() == tmx::Layer::Type::Tile) {
+            tileLayerIndices.push_back(i);
+        }
+    }
+    const auto& mapSize = map.getTileCount();
+    chunksX = (mapSize.x + ChunkTiles - 1) / ChunkTiles;
+    chunksY = (mapSize.y + ChunkTiles - 1) / ChunkTiles;
+    worker = std::thread(&ChunkStreamer::workerLoop, this);
+}
+
+ChunkStreamer::~ChunkStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueCond.notify_all();
+    worker.join();
+}
+
+void ChunkStreamer::workerLoop()
+{
+    while (true) {
+        unsigned int key;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueCond.wait(lock, [this]() { return stopping || !requests.empty(); });
+            if (stopping) {
+                return;
+            }
+            key = requests.front();
+            requests.pop_front();
+            building = key;
+        }
+        std::unique_ptr<Chunk> chunk = buildChunk(key);
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            finished.emplace_back(key, std::move(chunk));
+            building = NoChunk;
+        }
+    }
+}
+
+std::unique_ptr<ChunkStreamer::Chunk> ChunkStreamer::buildChunk(unsigned int key) const
+{
+    const unsigned int cx = key % chunksX;
+    const unsigned int cy = key / chunksX;
+    const maprect tileRect{ { cx * ChunkTiles, cy * ChunkTiles }, { (cx + 1) * ChunkTiles, (cy + 1) * ChunkTiles } };
+
+    auto chunk = std::make_unique<Chunk>();
+    for (std::uint32_t layerIndex : tileLayerIndices) {
+        auto layer = std::make_unique<MapLayer>();
+        layer->create(map, layerTiles, layerIndex, textures, tileRect);
+        chunk->bytes += layer->getMemoryUsage();
+        chunk->layers.push_back(std::move(layer));
+    }
+    return chunk;
+}
+
+maprect ChunkStreamer::getChunkRect(int pixelX, int pixelY, int pixelW, int pixelH) const
+{
+    const auto& tileSize = map.getTileSize();
+    const int chunkW = int(tileSize.x * ChunkTiles);
+    const int chunkH = int(tileSize.y * ChunkTiles);
+    auto toChunk = [](int pixel, int chunkPixels, unsigned int chunkCount) {
+        if (pixel < 0) {
+            return 0u;
+        }
+        return std::min(unsigned(pixel / chunkPixels), chunkCount);
+    };
+    return maprect{
+        { toChunk(pixelX, chunkW, chunksX), toChunk(pixelY, chunkH, chunksY) },
+        { toChunk(pixelX + pixelW + chunkW - 1, chunkW, chunksX), toChunk(pixelY + pixelH + chunkH - 1, chunkH, chunksY) }
+    };
+}
+
+void ChunkStreamer::update(const pixelpos& camera, const pixelpos& viewSize, float velocityX, float velocityY)
+{
+    frame++;
+    visibleChunks = getChunkRect(camera.x, camera.y, viewSize.x, viewSize.y);
+    maprect predicted = getChunkRect(camera.x + int(velocityX * PrefetchSeconds), camera.y + int(velocityY * PrefetchSeconds), viewSize.x, viewSize.y);
+
+    // the view, the predicted view and a one-chunk border around both
+    maprect wanted{
+        { std::min(visibleChunks.p1.x, predicted.p1.x), std::min(visibleChunks.p1.y, predicted.p1.y) },
+        { std::max(visibleChunks.p2.x, predicted.p2.x), std::max(visibleChunks.p2.y, predicted.p2.y) }
+    };
+    wanted.p1.x = wanted.p1.x > 0 ? wanted.p1.x - 1 : 0;
+    wanted.p1.y = wanted.p1.y > 0 ? wanted.p1.y - 1 : 0;
+    wanted.p2.x = std::min(wanted.p2.x + 1, chunksX);
+    wanted.p2.y = std::min(wanted.p2.y + 1, chunksY);
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        for (auto& [key, chunk] : finished) {
+            if (resident.find(key) == resident.end()) {
+                chunk->lastUsedFrame = frame;
+                residentBytes += chunk->bytes;
+                resident[key] = std::move(chunk);
+            }
+        }
+        finished.clear();
+
+        // visible chunks first, then the prefetch area ordered by distance to the view
+        std::vector<std::pair<unsigned int, unsigned int>> missing;
+        for (unsigned int cy = wanted.p1.y; cy < wanted.p2.y; cy++) {
+            for (unsigned int cx = wanted.p1.x; cx < wanted.p2.x; cx++) {
+                unsigned int key = cy * chunksX + cx;
+                auto it = resident.find(key);
+                if (it != resident.end()) {
+                    it->second->lastUsedFrame = frame;
+                } else if (key != building) {
+                    unsigned int dx = cx < visibleChunks.p1.x ? visibleChunks.p1.x - cx : (cx >= visibleChunks.p2.x ? cx - visibleChunks.p2.x + 1 : 0);
+                    unsigned int dy = cy < visibleChunks.p1.y ? visibleChunks.p1.y - cy : (cy >= visibleChunks.p2.y ? cy - visibleChunks.p2.y + 1 : 0);
+                    missing.emplace_back(dx + dy, key);
+                }
+            }
+        }
+        std::sort(missing.begin(), missing.end());
+        requests.clear();
+        for (const auto& [distance, key] : missing) {
+            // only prefetch while there's budget left, otherwise we'd just be building chunks to evict them
+            if (distance > 0 && residentBytes >= memoryBudget) {
+                break;
+            }
+            requests.push_back(key);
+        }
+    }
+    queueCond.notify_one();
+
+    maprect keepRect = wanted;
+    keepRect.p1.x = keepRect.p1.x > 0 ? keepRect.p1.x - 1 : 0;
+    keepRect.p1.y = keepRect.p1.y > 0 ? keepRect.p1.y - 1 : 0;
+    keepRect.p2.x = std::min(keepRect.p2.x + 1, chunksX);
+    keepRect.p2.y = std::min(keepRect.p2.y + 1, chunksY);
+    evict(keepRect);
+}
+
+void ChunkStreamer::evict(const maprect& keepRect)
+{
+    // anything well outside the wanted area goes regardless of the budget
+    for (auto it = resident.begin(); it != resident.end();) {
+        if (!keepRect.intersects(mappoint{ it->first % chunksX, it->first / chunksX })) {
+            residentBytes -= it->second->bytes;
+            it = resident.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    // then least-recently-used chunks until we're under budget, but never one that's on screen
+    while (residentBytes > memoryBudget) {
+        auto lru = resident.end();
+        for (auto it = resident.begin(); it != resident.end(); ++it) {
+            if (visibleChunks.intersects(mappoint{ it->first % chunksX, it->first / chunksX })) {
+                continue;
+            }
+            if (lru == resident.end() || it->second->lastUsedFrame < lru->second->lastUsedFrame) {
+                lru = it;
+            }
+        }
+        if (lru == resident.end()) {
+            break;
+        }
+        residentBytes -= lru->second->bytes;
+        resident.erase(lru);
+    }
+}
+
+void ChunkStreamer::draw(Renderer& renderer, const pixelpos& camera) const
+{
+    for (size_t layer = 0; layer < tileLayerIndices.size(); layer++) {
+        for (unsigned int cy = visibleChunks.p1.y; cy < visibleChunks.p2.y; cy++) {
+            for (unsigned int cx = visibleChunks.p1.x; cx < visibleChunks.p2.x; cx++) {
+                auto it = resident.find(cy * chunksX + cx);
+                if (it != resident.end()) {
+                    it->second->layers[layer]->draw(renderer, camera.x, camera.y);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <unordered_map>
+#include "Geometry.h"
+
+namespace tmx
+{
+    class Map;
+}
+
+/// @brief Builds tile-layer vertex data in fixed-size chunks around the camera on a background thread,
+/// so that only the part of the map near the camera is ever resident
+class ChunkStreamer
+{
+    struct Chunk
+    {
+        // one MapLayer per tile layer of the map, in draw order
+        std::vector<std::unique_ptr<class MapLayer>> layers;
+        size_t bytes = 0;
+        uint64_t lastUsedFrame = 0;
+    };
+
+    const tmx::Map& map;
+    const class LayerTiles& layerTiles;
+    const std::vector<std::shared_ptr<class Texture>>& textures;
+    std::vector<std::uint32_t> tileLayerIndices;
+    unsigned int chunksX;
+    unsigned int chunksY;
+    size_t memoryBudget;
+    size_t residentBytes;
+    uint64_t frame;
+    maprect visibleChunks;
+
+    // owned by the main thread
+    std::unordered_map<unsigned int, std::unique_ptr<Chunk>> resident;
+
+    // shared with the worker thread, guarded by queueMutex
+    std::mutex queueMutex;
+    std::condition_variable queueCond;
+    std::deque<unsigned int> requests;
+    unsigned int building;
+    std::vector<std::pair<unsigned int, std::unique_ptr<Chunk>>> finished;
+    bool stopping;
+    std::thread worker;
+
+    void workerLoop();
+    std::unique_ptr<Chunk> buildChunk(unsigned int key) const;
+    maprect getChunkRect(int pixelX, int pixelY, int pixelW, int pixelH) const;
+    void evict(const maprect& keepRect);
+public:
+    static const unsigned int NoChunk = ~0u;
+    // chunk edge length, in tiles
+    static const unsigned int ChunkTiles = 32;
+    // how far ahead (in seconds of camera movement) chunks are prefetched
+    static constexpr float PrefetchSeconds = 0.75f;
+
+    ChunkStreamer(const tmx::Map& map, const class LayerTiles& layerTiles, const std::vector<std::shared_ptr<class Texture>>& textures, size_t memoryBudget);
+    ~ChunkStreamer();
+
+    /// @brief Collect finished chunks, queue the ones needed for the current and predicted view and evict far-away ones
+    /// @param camera top-left of the view, in pixels
+    /// @param viewSize size of the view, in pixels
+    /// @param velocityX camera velocity in pixels per second, used to prefetch ahead of the camera
+    /// @param velocityY camera velocity in pixels per second, used to prefetch ahead of the camera
+    void update(const pixelpos& camera, const pixelpos& viewSize, float velocityX, float velocityY);
+    void draw(class Renderer& renderer, const pixelpos& camera) const;
+
+    size_t getResidentBytes() const { return residentBytes; }
+};
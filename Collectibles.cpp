@@ -0,0 +1,166 @@
+#include "Collectibles.h"
+#include "RenderSnapshot.h"
+#include "StateHash.h"
+#include "WorldState.h"
+#include <SDL2/SDL_log.h>
+#include <tmxlite/Map.hpp>
+#include <tmxlite/ObjectGroup.hpp>
+#include <algorithm>
+
+Collectibles::Collectibles() :
+    rings(0),
+    bucketMask(0),
+    queryStamp(0)
+{
+}
+
+bool Collectibles::load(const tmx::Map& map)
+{
+    items.clear();
+    const tmx::Vector2u& tileSize = map.getTileSize();
+    bool found = false;
+    for (const auto& layer : map.getLayers()) {
+        if (layer->getType() != tmx::Layer::Type::Object || layer->getName() != LayerName) {
+            continue;
+        }
+        found = true;
+        for (const tmx::Object& object : layer->getLayerAs<tmx::ObjectGroup>().getObjects()) {
+            Item item{ { 0.f, 0.f, 0.f }, object.getClass() == "monitor" ? Kind::Monitor : Kind::Ring, 1 };
+            float z = 0.f;
+            if (item.kind == Kind::Monitor) {
+                item.value = 10;
+            }
+            for (const tmx::Property& property : object.getProperties()) {
+                if (property.getName() == "z") {
+                    z = property.getType() == tmx::Property::Type::Int ? float(property.getIntValue()) : property.getFloatValue();
+                } else if (property.getName() == "value" && property.getType() == tmx::Property::Type::Int) {
+                    item.value = uint32_t(std::max(property.getIntValue(), 0));
+                }
+            }
+            // the centre of the object, in map units, taken back into the world at its depth the way map points are
+            const tmx::FloatRect& bounds = object.getAABB();
+            const float mapX = (bounds.left + bounds.width / 2.f) / tileSize.x;
+            const float mapY = (bounds.top + bounds.height / 2.f) / tileSize.y;
+            item.pos = { mapX - z / c_x_ratio, mapY - z, z };
+            items.push_back(item);
+        }
+    }
+    collected.assign((items.size() + 63) / 64, 0);
+    rings = 0;
+    buildHash();
+    if (found) {
+        SDL_Log("Loaded %zu collectibles", items.size());
+    }
+    return found;
+}
+
+uint32_t Collectibles::bucketOf(int x, int y, int z) const
+{
+    return (uint32_t(x) * 73856093u ^ uint32_t(y) * 19349663u ^ uint32_t(z) * 83492791u) & bucketMask;
+}
+
+void Collectibles::buildHash()
+{
+    // at least twice as many buckets as items, so most cells have a bucket to themselves
+    size_t bucketCount = 1;
+    while (bucketCount < items.size() * 2) {
+        bucketCount *= 2;
+    }
+    bucketMask = uint32_t(bucketCount - 1);
+    bucketStart.assign(bucketCount + 1, 0);
+    for (const Item& item : items) {
+        bucketStart[bucketOf(cellOf(item.pos.x), cellOf(item.pos.y), cellOf(item.pos.z)) + 1]++;
+    }
+    for (size_t b = 0; b < bucketCount; b++) {
+        bucketStart[b + 1] += bucketStart[b];
+    }
+    bucketItems.resize(items.size());
+    std::vector<uint32_t> fill(bucketStart.begin(), bucketStart.end() - 1);
+    for (uint32_t i = 0; i < items.size(); i++) {
+        const Item& item = items[i];
+        bucketItems[fill[bucketOf(cellOf(item.pos.x), cellOf(item.pos.y), cellOf(item.pos.z))]++] = i;
+    }
+    bucketVisited.assign(bucketCount, 0);
+    queryStamp = 0;
+}
+
+uint32_t Collectibles::collect(const cylinder& collisionCyl, std::vector<uint32_t>& picked)
+{
+    picked.clear();
+    if (items.empty()) {
+        return 0;
+    }
+    if (++queryStamp == 0) {
+        std::fill(bucketVisited.begin(), bucketVisited.end(), 0);
+        queryStamp = 1;
+    }
+    const float reach = collisionCyl.r + ItemRadius;
+    const float top = std::min(collisionCyl.y1, collisionCyl.y2) - ItemRadius;
+    const float bottom = std::max(collisionCyl.y1, collisionCyl.y2) + ItemRadius;
+    uint32_t gained = 0;
+    for (int cz = cellOf(collisionCyl.z - reach); cz <= cellOf(collisionCyl.z + reach); cz++) {
+        for (int cy = cellOf(top); cy <= cellOf(bottom); cy++) {
+            for (int cx = cellOf(collisionCyl.x - reach); cx <= cellOf(collisionCyl.x + reach); cx++) {
+                const uint32_t bucket = bucketOf(cx, cy, cz);
+                if (bucketVisited[bucket] == queryStamp) {
+                    continue;
+                }
+                bucketVisited[bucket] = queryStamp;
+                for (uint32_t b = bucketStart[bucket]; b < bucketStart[bucket + 1]; b++) {
+                    const uint32_t index = bucketItems[b];
+                    const Item& item = items[index];
+                    const float dx = item.pos.x - collisionCyl.x;
+                    const float dz = item.pos.z - collisionCyl.z;
+                    if (isCollected(index) || item.pos.y < top || item.pos.y > bottom || dx * dx + dz * dz > reach * reach) {
+                        continue;
+                    }
+                    collected[index / 64] |= uint64_t(1) << (index % 64);
+                    gained += item.value;
+                    picked.push_back(index);
+                }
+            }
+        }
+    }
+    rings += gained;
+    return gained;
+}
+
+void Collectibles::reset()
+{
+    std::fill(collected.begin(), collected.end(), 0);
+    rings = 0;
+}
+
+void Collectibles::saveState(StateWriter& out) const
+{
+    out.write(rings);
+    out.writeVector(collected);
+}
+
+bool Collectibles::readState(StateReader& in, SavedState& out) const
+{
+    return in.read(out.rings) && in.readVector(out.collected) && out.collected.size() == collected.size();
+}
+
+void Collectibles::loadState(SavedState& state)
+{
+    collected.swap(state.collected);
+    rings = state.rings;
+}
+
+uint64_t Collectibles::hash(uint64_t seed) const
+{
+    return HashVector(collected, HashBytes(&rings, sizeof(rings), seed));
+}
+
+void Collectibles::snapshot(Kind kind, ParticleBatchSnapshot& out) const
+{
+    out.pos.clear();
+    for (uint32_t i = 0; i < items.size(); i++) {
+        if (items[i].kind == kind && !isCollected(i)) {
+            out.pos.push_back(items[i].pos);
+        }
+    }
+    // items never move
+    out.prevPos = out.pos;
+}
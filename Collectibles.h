@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Geometry.h"
+
+namespace tmx
+{
+    class Map;
+}
+struct ParticleBatchSnapshot;
+
+/// @brief Rings, monitors and anything else the player picks up by touching it. Placements come from a
+/// Tiled object layer and never move, so they're hashed into a fixed grid once at load; each step only
+/// the cells around the player's collision cylinder are looked at. Which items are gone is one bit each,
+/// so it's cheap to capture with the world state and to clear when the level starts over
+class Collectibles
+{
+public:
+    enum class Kind : uint8_t
+    {
+        Ring,
+        Monitor
+    };
+
+    struct Item
+    {
+        tripoint pos;
+        Kind kind;
+        // rings the item is worth
+        uint32_t value;
+    };
+
+    // the object layer placements are read from
+    static constexpr const char* LayerName = "collectibles";
+    // how close the player's cylinder has to get to an item, on top of its own radius
+    static constexpr float ItemRadius = 0.5f;
+    // edge of a spatial hash cell, in real units
+    static constexpr float CellSize = 2.f;
+
+private:
+    std::vector<Item> items;
+    std::vector<uint64_t> collected;
+    uint32_t rings;
+    // items by cell hash, as compressed buckets: items bucketItems[bucketStart[b]] to bucketItems[bucketStart[b + 1]] hash to b
+    std::vector<uint32_t> bucketStart;
+    std::vector<uint32_t> bucketItems;
+    uint32_t bucketMask;
+    // cell stamps from the current query, so a bucket shared by several of the cells around the player is only read once
+    std::vector<uint32_t> bucketVisited;
+    uint32_t queryStamp;
+
+    static int cellOf(float coordinate) { return int(std::floor(coordinate / CellSize)); }
+    uint32_t bucketOf(int x, int y, int z) const;
+    void buildHash();
+public:
+    Collectibles();
+
+    /// @brief Read the placements from the map's collectibles object layer. Objects are rings unless their
+    /// class is "monitor"; a "z" property sets how far into the screen they are, and "value" what they're worth
+    /// @return false if there's no such layer, which leaves the level without collectibles
+    bool load(const tmx::Map& map);
+
+    /// @brief Collect everything the cylinder touches that's still there
+    /// @param picked receives the newly collected items' indices, reusing its capacity
+    /// @return rings the newly collected items were worth
+    uint32_t collect(const cylinder& collisionCyl, std::vector<uint32_t>& picked);
+    // put every item back and the ring count to zero
+    void reset();
+
+    size_t size() const { return items.size(); }
+    const Item& getItem(uint32_t index) const { return items[index]; }
+    bool isCollected(uint32_t index) const { return (collected[index / 64] >> (index % 64)) & 1; }
+    uint32_t getRings() const { return rings; }
+
+    struct SavedState
+    {
+        uint32_t rings = 0;
+        std::vector<uint64_t> collected;
+    };
+    void saveState(class StateWriter& out) const;
+    // read into out, false if it's malformed or for another level's items; nothing changes until loadState
+    bool readState(class StateReader& in, SavedState& out) const;
+    void loadState(SavedState& state);
+    uint64_t hash(uint64_t seed) const;
+
+    // every item still there, of one kind, for drawing in one batch with the particles
+    void snapshot(Kind kind, ParticleBatchSnapshot& out) const;
+};
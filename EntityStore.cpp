@@ -0,0 +1,304 @@
+#include "EntityStore.h"
+#include "GameWindow.h"
+#include "Actor.h"
+#include "JobSystem.h"
+#include "StateHash.h"
+#include "WorldState.h"
+#include <algorithm>
+
+EntityStore::EntityId EntityStore::add(const tripoint& pos, float offsetX, float offsetY1, float offsetY2, float maxJumpTime)
+{
+    EntityId id;
+    if (freeIds.empty()) {
+        id = EntityId(idIndex.size());
+        idIndex.push_back(0);
+    } else {
+        id = freeIds.back();
+        freeIds.pop_back();
+    }
+    idIndex[id] = uint32_t(size());
+    indexId.push_back(id);
+    posX.push_back(pos.x);
+    posY.push_back(pos.y);
+    posZ.push_back(pos.z);
+    prevX.push_back(pos.x);
+    prevY.push_back(pos.y);
+    prevZ.push_back(pos.z);
+    moveX.push_back(0.f);
+    moveY.push_back(0.f);
+    moveZ.push_back(0.f);
+    intentX.push_back(0.f);
+    intentY.push_back(0.f);
+    intentZ.push_back(0.f);
+    jumpEnd.push_back(-1.f);
+    maxJump.push_back(maxJumpTime);
+    state.push_back(ActorState::Default);
+    colOffsetX.push_back(offsetX);
+    colOffsetY1.push_back(offsetY1);
+    colOffsetY2.push_back(offsetY2);
+    colX.push_back(-1.f);
+    colY1.push_back(-1.f);
+    colY2.push_back(-1.f);
+    colZ.push_back(-1.f);
+    collisionDirections.push_back(NoCollision);
+    groundY.push_back(0.f);
+    swapIndices(awakeCount, uint32_t(size() - 1));
+    awakeCount++;
+    return id;
+}
+
+void EntityStore::remove(EntityId id)
+{
+    sleep(id);
+    const uint32_t index = idIndex[id];
+    const uint32_t last = uint32_t(size() - 1);
+    ForEachField(*this, [index, last](auto& field) {
+        field[index] = field[last];
+        field.pop_back();
+    });
+    indexId[index] = indexId[last];
+    indexId.pop_back();
+    if (index != last) {
+        idIndex[indexId[index]] = index;
+    }
+    idIndex[id] = UINT32_MAX;
+    freeIds.push_back(id);
+}
+
+void EntityStore::swapIndices(uint32_t a, uint32_t b)
+{
+    if (a == b) {
+        return;
+    }
+    ForEachField(*this, [a, b](auto& field) { std::swap(field[a], field[b]); });
+    std::swap(indexId[a], indexId[b]);
+    idIndex[indexId[a]] = a;
+    idIndex[indexId[b]] = b;
+}
+
+void EntityStore::sleep(EntityId id)
+{
+    if (isAwake(id)) {
+        swapIndices(idIndex[id], awakeCount - 1);
+        awakeCount--;
+    }
+}
+
+void EntityStore::wake(EntityId id)
+{
+    if (!isAwake(id)) {
+        swapIndices(idIndex[id], awakeCount);
+        awakeCount++;
+    }
+}
+
+void EntityStore::setIntent(EntityId id, const MoveVector& intent)
+{
+    const size_t i = idIndex[id];
+    intentX[i] = intent.x;
+    intentY[i] = intent.y;
+    intentZ[i] = intent.z;
+}
+
+void EntityStore::teleport(EntityId id, const tripoint& pos)
+{
+    const size_t i = idIndex[id];
+    posX[i] = prevX[i] = pos.x;
+    posY[i] = prevY[i] = pos.y;
+    posZ[i] = prevZ[i] = pos.z;
+    moveX[i] = moveY[i] = moveZ[i] = 0.f;
+    jumpEnd[i] = -1.f;
+    state[i] = ActorState::Default;
+}
+
+void EntityStore::update(float deltaTime, const GameWindow& world, JobSystem& jobs)
+{
+    // entities don't touch each other, and each range only writes its own entities' slots, so splitting
+    // the step across threads gives the same result whatever the thread count
+    jobs.parallelFor(awakeCount, UpdateGrainSize, [&](size_t begin, size_t end) {
+        step(begin, end, deltaTime, world);
+    });
+}
+
+void EntityStore::saveState(StateWriter& out) const
+{
+    ForEachField(*this, [&out](const auto& field) { out.writeVector(field); });
+    out.writeVector(idIndex);
+    out.writeVector(indexId);
+    out.writeVector(freeIds);
+    out.write(awakeCount);
+}
+
+bool EntityStore::loadState(StateReader& in)
+{
+    ForEachField(*this, [&in](auto& field) { in.readVector(field); });
+    in.readVector(idIndex);
+    in.readVector(indexId);
+    in.readVector(freeIds);
+    in.read(awakeCount);
+    bool consistent = in.good() && indexId.size() == size() && idIndex.size() == size() + freeIds.size() && awakeCount <= size();
+    const size_t count = size();
+    ForEachField(*this, [&consistent, count](const auto& field) { consistent = consistent && field.size() == count; });
+    for (size_t i = 0; consistent && i < indexId.size(); i++) {
+        consistent = indexId[i] < idIndex.size() && idIndex[indexId[i]] == i;
+    }
+    return consistent;
+}
+
+uint64_t EntityStore::hash(uint64_t seed) const
+{
+    // prev* and col* are derived from the rest at the start of a step, so they'd add nothing
+    uint64_t hash = seed;
+    for (const std::vector<float>* field : { &posX, &posY, &posZ, &moveX, &moveY, &moveZ, &intentX, &intentY, &intentZ,
+        &jumpEnd, &maxJump, &colOffsetX, &colOffsetY1, &colOffsetY2, &groundY }) {
+        hash = HashVector(*field, hash);
+    }
+    hash = HashVector(state, hash);
+    hash = HashVector(indexId, hash);
+    hash = HashBytes(&awakeCount, sizeof(awakeCount), hash);
+    return HashVector(collisionDirections, hash);
+}
+
+float EntityStore::getMaxPixelX(JobSystem& jobs) const
+{
+    // each range reduces into its own slot, and the slots are combined in order afterwards
+    std::vector<float> rangeMax((awakeCount + UpdateGrainSize - 1) / UpdateGrainSize, 0.f);
+    jobs.parallelFor(awakeCount, UpdateGrainSize, [&](size_t begin, size_t end) {
+        float maxPixelX = 0.f;
+        for (size_t i = begin; i < end; i++) {
+            maxPixelX = std::max(maxPixelX, (posX[i] + posZ[i] / 2.f) * 16.f);
+        }
+        rangeMax[begin / UpdateGrainSize] = std::max(rangeMax[begin / UpdateGrainSize], maxPixelX);
+    });
+    float maxPixelX = 0.f;
+    for (float value : rangeMax) {
+        maxPixelX = std::max(maxPixelX, value);
+    }
+    return maxPixelX;
+}
+
+void EntityStore::step(size_t begin, size_t end, float deltaTime, const GameWindow& world)
+{
+    std::copy(posX.begin() + begin, posX.begin() + end, prevX.begin() + begin);
+    std::copy(posY.begin() + begin, posY.begin() + end, prevY.begin() + begin);
+    std::copy(posZ.begin() + begin, posZ.begin() + end, prevZ.begin() + begin);
+    collide(begin, end, world);
+    handleMovement(begin, end, deltaTime);
+    handleJump(begin, end, deltaTime);
+    handleGravity(begin, end, deltaTime);
+    integrate(begin, end, deltaTime);
+}
+
+void EntityStore::collide(size_t begin, size_t end, const GameWindow& world)
+{
+    for (size_t i = begin; i < end; i++) {
+        colX[i] = posX[i] + colOffsetX[i];
+        colY1[i] = posY[i] + colOffsetY1[i];
+        colY2[i] = posY[i] + colOffsetY2[i];
+        colZ[i] = posZ[i] + 2.f;
+        collisionDirections[i] = uint8_t(world.collide({ colX[i], colY1[i], colY2[i], colZ[i], CollisionRadius }, groundY[i]));
+    }
+}
+
+/// <summary>
+/// Accelerate every entity's horizontal velocity towards its intended one, stopping against walls
+/// </summary>
+void EntityStore::handleMovement(size_t begin, size_t end, float deltaTime)
+{
+    const float vDelta = PLAYER_RUN_ACCEL * deltaTime;
+    for (size_t i = begin; i < end; i++) {
+        const float intentMoveX = intentX[i];
+        const float intentMoveZ = intentZ[i];
+        float curX = moveX[i];
+        float curZ = moveZ[i];
+        if (intentMoveX == curX && intentMoveZ == curZ) {
+            continue;
+        }
+        const float zDelta = intentMoveZ - curZ;
+        const float xDelta = intentMoveX - curX;
+        const float xStep = xDelta < 0 ? -vDelta : vDelta;
+        const float zStep = zDelta < 0 ? -vDelta : vDelta;
+        if (zDelta == 0.f) {
+            curX += xStep;
+        } else if (xDelta == 0.f) {
+            curZ += zStep;
+        } else {
+            curX += 0.5f * xStep;
+            curZ += 0.5f * zStep;
+        }
+        // turning round brakes twice as hard
+        if ((curX > 0.f && intentMoveX <= 0.f) || (curX < 0.f && intentMoveX >= 0.f)) {
+            curX += xStep;
+        }
+        if ((curZ > 0.f && intentMoveZ <= 0.f) || (curZ < 0.f && intentMoveZ >= 0.f)) {
+            curZ += zStep;
+        }
+        if ((xDelta < 0 && curX < intentMoveX) || (xDelta > 0 && curX > intentMoveX)) {
+            curX = intentMoveX;
+        }
+        if ((zDelta < 0 && curZ < intentMoveZ) || (zDelta > 0 && curZ > intentMoveZ)) {
+            curZ = intentMoveZ;
+        }
+
+        const int directions = collisionDirections[i];
+        if ((directions & Left && curX < 0.f) || (directions & Right && curX > 0.f)) {
+            curX = 0.f;
+        }
+        if ((directions & Front && curZ > 0.f) || (directions & Back && curZ < 0.f)) {
+            curZ = 0.f;
+        }
+        moveX[i] = curX;
+        moveZ[i] = curZ;
+    }
+}
+
+void EntityStore::handleJump(size_t begin, size_t end, float deltaTime)
+{
+    for (size_t i = begin; i < end; i++) {
+        const int directions = collisionDirections[i];
+        if (jumpEnd[i] == -1.f && intentY[i] != 0.f && state[i] != ActorState::Hurt && state[i] != ActorState::Jumping && directions & Down) {
+            state[i] = ActorState::Jumping;
+            moveY[i] = intentY[i];
+            jumpEnd[i] = maxJump[i];
+        } else if (jumpEnd[i] != -1.f) {
+            jumpEnd[i] -= deltaTime;
+            if (jumpEnd[i] <= 0 || intentY[i] == 0.f) {
+                jumpEnd[i] = -1.f;
+                intentY[i] = 0.f;
+                state[i] = ActorState::Default;
+            }
+        }
+        if (directions & Up) {
+            jumpEnd[i] = -1.f;
+            state[i] = ActorState::Default;
+        }
+    }
+}
+
+void EntityStore::handleGravity(size_t begin, size_t end, float deltaTime)
+{
+    for (size_t i = begin; i < end; i++) {
+        if (jumpEnd[i] != -1.f) {
+            continue;
+        }
+        if (collisionDirections[i] & Down) {
+            moveY[i] = 0.f;
+            posY[i] = groundY[i];
+        } else {
+            moveY[i] = std::max(moveY[i] - gravity_accel * deltaTime, MIN_PLAYER_Y_VELOCITY);
+        }
+    }
+}
+
+void EntityStore::integrate(size_t begin, size_t end, float deltaTime)
+{
+    for (size_t i = begin; i < end; i++) {
+        posY[i] -= moveY[i] * deltaTime;
+    }
+    for (size_t i = begin; i < end; i++) {
+        posZ[i] += moveZ[i] * deltaTime;
+    }
+    for (size_t i = begin; i < end; i++) {
+        posX[i] += moveX[i] * deltaTime;
+    }
+}
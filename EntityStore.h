@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "Geometry.h"
+#include "ActorState.h"
+
+/// @brief The per-step state of every simulated actor, kept as one array per field so that each stage
+/// of a simulation step is a tight loop over contiguous data. Actor holds the rest (sprite, texture, input)
+/// and an id into here. Removing an entity moves the last one into its place, so the arrays stay dense;
+/// ids stay put, mapped to wherever their entity currently is. Awake entities come first in the arrays and
+/// sleeping ones after them, so a step only loops over the awake ones
+class EntityStore
+{
+public:
+    typedef uint32_t EntityId;
+
+    // entities per job when a step is split across threads
+    static const size_t UpdateGrainSize = 512;
+    // radius of every entity's collision cylinder
+    static constexpr float CollisionRadius = 0.5f;
+
+    // positions, as of the latest and the previous step
+    std::vector<float> posX, posY, posZ;
+    std::vector<float> prevX, prevY, prevZ;
+    // current and intended velocity
+    std::vector<float> moveX, moveY, moveZ;
+    std::vector<float> intentX, intentY, intentZ;
+    // seconds of jump left, -1 when not jumping
+    std::vector<float> jumpEnd;
+    std::vector<float> maxJump;
+    std::vector<ActorState> state;
+    // collision cylinder relative to the position, and where it was tested this step
+    std::vector<float> colOffsetX, colOffsetY1, colOffsetY2;
+    std::vector<float> colX, colY1, colY2, colZ;
+    // CollisionType flags from this step's collision test, and the top of the surface below when Down is set
+    std::vector<uint8_t> collisionDirections;
+    std::vector<float> groundY;
+
+    EntityId add(const tripoint& pos, float offsetX, float offsetY1, float offsetY2, float maxJumpTime);
+    void remove(EntityId id);
+    size_t size() const { return posX.size(); }
+    // ids ever handed out, live or free for reuse
+    size_t getIdCapacity() const { return idIndex.size(); }
+    // the id of the entity at an array index
+    EntityId getId(size_t index) const { return indexId[index]; }
+
+    // sleeping entities keep their state but aren't stepped until they wake; new entities start awake
+    void sleep(EntityId id);
+    void wake(EntityId id);
+    bool isAwake(EntityId id) const { return idIndex[id] < awakeCount; }
+    // awake entities are the ones at indices [0, getAwakeCount())
+    size_t getAwakeCount() const { return awakeCount; }
+
+    /// @brief Advance every awake entity by one fixed step, split into ranges of entities across the job system's threads
+    void update(float deltaTime, const class GameWindow& world, class JobSystem& jobs);
+
+    /// @brief Append every field of every entity to a state capture
+    void saveState(class StateWriter& out) const;
+    /// @brief Replace every entity with the ones in a state capture, false if it's malformed
+    bool loadState(class StateReader& in);
+
+    /// @brief Continue a hash over every entity's simulation state
+    uint64_t hash(uint64_t seed) const;
+
+    /// @brief Rightmost pixel x any awake entity is at, for deciding how far the map has to be traced
+    float getMaxPixelX(class JobSystem& jobs) const;
+
+    // where an entity currently is in the arrays
+    size_t indexOf(EntityId id) const { return idIndex[id]; }
+    tripoint getPos(EntityId id) const { size_t i = idIndex[id]; return { posX[i], posY[i], posZ[i] }; }
+    tripoint getPrevPos(EntityId id) const { size_t i = idIndex[id]; return { prevX[i], prevY[i], prevZ[i] }; }
+    cylinder getCollisionCylinder(EntityId id) const { size_t i = idIndex[id]; return { colX[i], colY1[i], colY2[i], colZ[i], CollisionRadius }; }
+    MoveVector getIntent(EntityId id) const { size_t i = idIndex[id]; return { intentX[i], intentY[i], intentZ[i] }; }
+    ActorState getState(EntityId id) const { return state[idIndex[id]]; }
+    void setIntent(EntityId id, const MoveVector& intent);
+    // put an entity somewhere else, standing still
+    void teleport(EntityId id, const tripoint& pos);
+
+private:
+    // array index of each id (UINT32_MAX when free), the id at each array index, and ids free for reuse
+    std::vector<uint32_t> idIndex;
+    std::vector<EntityId> indexId;
+    std::vector<EntityId> freeIds;
+    uint32_t awakeCount = 0;
+
+    // exchange two entities' places in every array
+    void swapIndices(uint32_t a, uint32_t b);
+
+    template<typename Store, typename Visit>
+    static void ForEachField(Store& store, Visit&& visit)
+    {
+        visit(store.posX); visit(store.posY); visit(store.posZ);
+        visit(store.prevX); visit(store.prevY); visit(store.prevZ);
+        visit(store.moveX); visit(store.moveY); visit(store.moveZ);
+        visit(store.intentX); visit(store.intentY); visit(store.intentZ);
+        visit(store.jumpEnd); visit(store.maxJump); visit(store.state);
+        visit(store.colOffsetX); visit(store.colOffsetY1); visit(store.colOffsetY2);
+        visit(store.colX); visit(store.colY1); visit(store.colY2); visit(store.colZ);
+        visit(store.collisionDirections); visit(store.groundY);
+    }
+
+    // collide, move, jump, fall and integrate entities [begin, end), each stage a loop over the whole range
+    void step(size_t begin, size_t end, float deltaTime, const class GameWindow& world);
+    void collide(size_t begin, size_t end, const class GameWindow& world);
+    void handleMovement(size_t begin, size_t end, float deltaTime);
+    void handleJump(size_t begin, size_t end, float deltaTime);
+    void handleGravity(size_t begin, size_t end, float deltaTime);
+    void integrate(size_t begin, size_t end, float deltaTime);
+};
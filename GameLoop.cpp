@@ -0,0 +1,280 @@
+#include "GameLoop.h"
+#include "GameWindow.h"
+#include "InputLog.h"
+#include "StateHash.h"
+#include <SDL2/SDL.h>
+#include <thread>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+GameLoop::GameLoop(GameWindow& window, const GameOptions& options) :
+    window(window),
+    options(options),
+    counterFrequency(SDL_GetPerformanceFrequency()),
+    running(false)
+{
+}
+
+GameLoop::~GameLoop()
+{
+}
+
+bool GameLoop::pollEvents()
+{
+    SDL_Event event;
+    while (SDL_PollEvent(&event) > 0)
+    {
+        if (event.type == SDL_QUIT) {
+            return false;
+        }
+        // a deterministic run's only input is the recorded one
+        if (!options.deterministic) {
+            window.handle_input(event);
+        }
+    }
+    return true;
+}
+
+void GameLoop::waitUntil(uint64_t deadline)
+{
+    // SDL_Delay can oversleep by a millisecond or two, so sleep until just short of the deadline and spin the rest
+    const uint64_t spinTicks = counterFrequency * 2 / 1000;
+    uint64_t now = SDL_GetPerformanceCounter();
+    while (now < deadline) {
+        if (deadline - now > spinTicks) {
+            SDL_Delay(Uint32((deadline - now - spinTicks) * 1000 / counterFrequency));
+        }
+        now = SDL_GetPerformanceCounter();
+    }
+}
+
+void GameLoop::step()
+{
+    if (inputLog != nullptr) {
+        std::vector<SDL_Event> events;
+        inputLog->eventsForStep(window.getUpdateCount(), events);
+        for (const SDL_Event& event : events) {
+            window.handle_input(event);
+        }
+    }
+    window.update(SimulationStep);
+    if (stateHashes != nullptr) {
+        stateHashes->record(window.stateHash());
+    }
+}
+
+void GameLoop::publishSnapshot()
+{
+    RenderSnapshot& snapshot = snapshots.getWriteBuffer();
+    window.snapshot(snapshot);
+    snapshot.publishCounter = SDL_GetPerformanceCounter();
+    snapshots.publish();
+}
+
+void GameLoop::simulationLoop()
+{
+    const uint64_t stepTicks = uint64_t(counterFrequency * SimulationStep);
+    const uint64_t maxCatchUpTicks = uint64_t(counterFrequency * MaxFrameTime);
+    uint64_t nextStep = SDL_GetPerformanceCounter();
+    while (running) {
+        step();
+        publishSnapshot();
+        if (window.isHeadless()) {
+            continue;
+        }
+        nextStep += stepTicks;
+        uint64_t now = SDL_GetPerformanceCounter();
+        if (now > nextStep + maxCatchUpTicks) {
+            // fell too far behind to catch up, drop the missed steps instead of running them back to back
+            nextStep = now;
+        }
+        waitUntil(nextStep);
+    }
+}
+
+void GameLoop::runThreaded()
+{
+    const uint64_t stepTicks = uint64_t(counterFrequency * SimulationStep);
+    const uint64_t targetFrameTicks = options.targetFps > 0 ? counterFrequency / options.targetFps : 0;
+    unsigned long frames = 0;
+    running = true;
+    std::thread simulation(&GameLoop::simulationLoop, this);
+    while (running && pollEvents()) {
+        uint64_t frameStart = SDL_GetPerformanceCounter();
+        const RenderSnapshot& snapshot = snapshots.read();
+        // the snapshot spans the step before it was published, so draw as far into that step as time has moved on since
+        float alpha = float(double(frameStart - snapshot.publishCounter) / stepTicks);
+        window.render(snapshot, std::clamp(alpha, 0.f, 1.f));
+        if (options.maxFrames != 0 && ++frames >= options.maxFrames) {
+            break;
+        }
+        if (!window.isHeadless() && targetFrameTicks != 0) {
+            waitUntil(frameStart + targetFrameTicks);
+        }
+    }
+    running = false;
+    simulation.join();
+}
+
+bool GameLoop::writeTimedemoReport(const std::vector<uint64_t>& simulationTicks, const std::vector<uint64_t>& renderTicks) const
+{
+    const double toMs = 1000.0 / counterFrequency;
+    auto percentiles = [toMs](std::vector<uint64_t> ticks) {
+        std::sort(ticks.begin(), ticks.end());
+        auto at = [&](double fraction) {
+            return ticks.empty() ? 0.0 : ticks[std::min(size_t(fraction * ticks.size()), ticks.size() - 1)] * toMs;
+        };
+        char json[160];
+        snprintf(json, sizeof(json), "{ \"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, \"max\": %.3f }",
+            at(0.50), at(0.95), at(0.99), ticks.empty() ? 0.0 : ticks.back() * toMs);
+        return std::string(json);
+    };
+    std::vector<uint64_t> frameTicks(simulationTicks.size());
+    uint64_t totalTicks = 0;
+    for (size_t i = 0; i < frameTicks.size(); i++) {
+        frameTicks[i] = simulationTicks[i] + renderTicks[i];
+        totalTicks += frameTicks[i];
+    }
+    const double seconds = double(totalTicks) / counterFrequency;
+
+    std::ostringstream report;
+    report << "{\n"
+        << "  \"input\": \"" << options.timedemo << "\",\n"
+        << "  \"frames\": " << frameTicks.size() << ",\n"
+        << "  \"seconds\": " << seconds << ",\n"
+        << "  \"average_fps\": " << (seconds > 0.0 ? frameTicks.size() / seconds : 0.0) << ",\n"
+        << "  \"frame_ms\": " << percentiles(frameTicks) << ",\n"
+        << "  \"simulation_ms\": " << percentiles(simulationTicks) << ",\n"
+        << "  \"render_ms\": " << percentiles(renderTicks) << "\n"
+        << "}\n";
+    if (options.timedemoReport.empty()) {
+        std::cout << report.str();
+        return true;
+    }
+    std::ofstream file(options.timedemoReport, std::ios::trunc);
+    file << report.str();
+    if (!file.good()) {
+        SDL_Log("Failed to write timedemo report %s", options.timedemoReport.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool GameLoop::runDeterministic()
+{
+    if (!options.inputLog.empty()) {
+        inputLog.reset(InputLog::Load(options.inputLog));
+        if (inputLog == nullptr) {
+            return false;
+        }
+    }
+    if (!options.hashOut.empty() || !options.hashCompare.empty()) {
+        stateHashes.reset(StateHashStream::Create(options.hashOut, options.hashCompare));
+        if (stateHashes == nullptr) {
+            return false;
+        }
+    }
+    // a timedemo runs to a second past the last recorded input unless told otherwise
+    unsigned long maxFrames = options.maxFrames;
+    if (!options.timedemo.empty() && maxFrames == 0) {
+        maxFrames = (unsigned long)(inputLog->lastStep() + 1 + uint64_t(1.f / SimulationStep));
+    }
+    std::vector<uint64_t> simulationTicks;
+    std::vector<uint64_t> renderTicks;
+    simulationTicks.reserve(maxFrames);
+    renderTicks.reserve(maxFrames);
+    // exactly one step per frame and nothing from the clock feeds into it, so the steps only depend on the input
+    // (the timedemo reads the clock, but only to time frames)
+    unsigned long frames = 0;
+    running = true;
+    while (running && pollEvents()) {
+        uint64_t frameStart = SDL_GetPerformanceCounter();
+        step();
+        publishSnapshot();
+        uint64_t stepped = SDL_GetPerformanceCounter();
+        window.render(snapshots.read(), 1.f);
+        simulationTicks.push_back(stepped - frameStart);
+        renderTicks.push_back(SDL_GetPerformanceCounter() - stepped);
+        if (maxFrames != 0 && ++frames >= maxFrames) {
+            break;
+        }
+    }
+    running = false;
+    bool success = true;
+    if (!options.timedemo.empty()) {
+        success = writeTimedemoReport(simulationTicks, renderTicks);
+    }
+    return (stateHashes == nullptr || stateHashes->report()) && success;
+}
+
+bool GameLoop::run()
+{
+    if (!options.recordInput.empty()) {
+        inputRecording = std::make_unique<InputLog>();
+        window.setInputRecorder(inputRecording.get());
+    }
+    // there's always something to draw, even before the first step
+    publishSnapshot();
+    bool success = true;
+    if (options.deterministic) {
+        success = runDeterministic();
+    } else if (options.simThread) {
+        runThreaded();
+    } else {
+        runFixedStep();
+    }
+    if (inputRecording != nullptr) {
+        window.setInputRecorder(nullptr);
+        if (inputRecording->save(options.recordInput)) {
+            SDL_Log("Recorded %zu input events over %llu steps to %s", inputRecording->size(), (unsigned long long)window.getUpdateCount(), options.recordInput.c_str());
+        } else {
+            success = false;
+        }
+    }
+    return success;
+}
+
+void GameLoop::runFixedStep()
+{
+    const uint64_t targetFrameTicks = options.targetFps > 0 ? counterFrequency / options.targetFps : 0;
+    uint64_t previous = SDL_GetPerformanceCounter();
+    double accumulator = 0.0;
+    unsigned long frames = 0;
+    running = true;
+    while (running && pollEvents()) {
+        uint64_t frameStart = SDL_GetPerformanceCounter();
+        if (window.isHeadless()) {
+            // nothing to keep in step with, so just simulate one step per frame as fast as we can
+            step();
+            publishSnapshot();
+            window.render(snapshots.read(), 1.f);
+        } else {
+            double frameTime = double(frameStart - previous) / counterFrequency;
+            if (frameTime > MaxFrameTime) {
+                frameTime = MaxFrameTime;
+            }
+            accumulator += frameTime;
+            bool stepped = false;
+            while (accumulator >= SimulationStep) {
+                step();
+                accumulator -= SimulationStep;
+                stepped = true;
+            }
+            if (stepped) {
+                publishSnapshot();
+            }
+            window.render(snapshots.read(), float(accumulator / SimulationStep));
+        }
+        previous = frameStart;
+        if (options.maxFrames != 0 && ++frames >= options.maxFrames) {
+            break;
+        }
+        if (!window.isHeadless() && targetFrameTicks != 0) {
+            waitUntil(frameStart + targetFrameTicks);
+        }
+    }
+    running = false;
+}
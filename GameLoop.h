@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "GameOptions.h"
+#include "RenderSnapshot.h"
+#include "TripleBuffer.h"
+
+/// @brief Runs the simulation at a fixed step, decoupled from how fast frames get drawn
+class GameLoop
+{
+    class GameWindow& window;
+    const GameOptions& options;
+    uint64_t counterFrequency;
+    // the simulation writes finished steps here and the renderer always reads the newest one
+    TripleBuffer<RenderSnapshot> snapshots;
+    std::atomic<bool> running;
+    // deterministic mode's input, and the hashes of the steps it produces
+    std::unique_ptr<class InputLog> inputLog;
+    std::unique_ptr<class StateHashStream> stateHashes;
+    // the player's input as the simulation applies it, when asked to record it
+    std::unique_ptr<class InputLog> inputRecording;
+
+    bool pollEvents();
+    // run one simulation step, feeding it any scripted input and recording its state hash
+    void step();
+    void runFixedStep();
+    bool runDeterministic();
+    // write a timedemo's frame time percentiles, overall and split into simulation and drawing, as JSON
+    bool writeTimedemoReport(const std::vector<uint64_t>& simulationTicks, const std::vector<uint64_t>& renderTicks) const;
+    void waitUntil(uint64_t deadline);
+    void publishSnapshot();
+    void simulationLoop();
+    void runThreaded();
+public:
+    // length of one simulation step, in seconds
+    static constexpr float SimulationStep = 1.f / 60.f;
+    // longest frame time fed into the simulation, so one hitch can't snowball into ever more steps per frame
+    static constexpr double MaxFrameTime = 0.25;
+
+    GameLoop(GameWindow& window, const GameOptions& options);
+    ~GameLoop();
+
+    /// @brief Run until the window closes or the frame limit is reached
+    /// @return false if a deterministic run's input or hash files couldn't be used, or its hashes didn't match
+    bool run();
+};
@@ -0,0 +1,113 @@
+#include "GameOptions.h"
+#include <SDL2/SDL_log.h>
+#include <cstdlib>
+#include <cstring>
+
+GameOptions GameOptions::FromArgs(int argc, char** argv)
+{
+    GameOptions options;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "--stream-chunks") == 0) {
+            options.streamChunks = true;
+        } else if (strcmp(arg, "--chunk-budget-kb") == 0 && value != nullptr) {
+            options.chunkMemoryBudget = size_t(strtoull(value, nullptr, 10)) * 1024;
+            i++;
+        } else if (strcmp(arg, "--lazy-tracing") == 0) {
+            options.lazyTracing = true;
+        } else if (strcmp(arg, "--check-trace") == 0) {
+            options.checkTrace = true;
+        } else if (strcmp(arg, "--headless") == 0) {
+            options.headless = true;
+        } else if (strcmp(arg, "--frames") == 0 && value != nullptr) {
+            options.maxFrames = strtoul(value, nullptr, 10);
+            i++;
+        } else if (strcmp(arg, "--fps") == 0 && value != nullptr) {
+            options.targetFps = unsigned(strtoul(value, nullptr, 10));
+            i++;
+        } else if (strcmp(arg, "--sim-thread") == 0) {
+            options.simThread = true;
+        } else if (strcmp(arg, "--texture-budget-mb") == 0 && value != nullptr) {
+            options.textureBudget = size_t(strtoull(value, nullptr, 10)) * 1024 * 1024;
+            i++;
+        } else if (strcmp(arg, "--stress-entities") == 0 && value != nullptr) {
+            options.stressEntities = size_t(strtoull(value, nullptr, 10));
+            i++;
+        } else if (strcmp(arg, "--stress-pathing") == 0) {
+            options.stressPathing = true;
+        } else if (strcmp(arg, "--stress-particles") == 0 && value != nullptr) {
+            options.stressParticles = size_t(strtoull(value, nullptr, 10));
+            i++;
+        } else if (strcmp(arg, "--activation-margin") == 0 && value != nullptr) {
+            options.activationMargin = atoi(value);
+            i++;
+        } else if (strcmp(arg, "--job-workers") == 0 && value != nullptr) {
+            options.jobWorkers = atoi(value);
+            i++;
+        } else if (strcmp(arg, "--deterministic") == 0) {
+            options.deterministic = true;
+        } else if (strcmp(arg, "--input") == 0 && value != nullptr) {
+            options.inputLog = value;
+            i++;
+        } else if (strcmp(arg, "--hash-out") == 0 && value != nullptr) {
+            options.hashOut = value;
+            i++;
+        } else if (strcmp(arg, "--hash-compare") == 0 && value != nullptr) {
+            options.hashCompare = value;
+            i++;
+        } else if (strcmp(arg, "--record-input") == 0 && value != nullptr) {
+            options.recordInput = value;
+            i++;
+        } else if (strcmp(arg, "--timedemo") == 0 && value != nullptr) {
+            options.timedemo = value;
+            i++;
+        } else if (strcmp(arg, "--timedemo-report") == 0 && value != nullptr) {
+            options.timedemoReport = value;
+            i++;
+        } else if (strcmp(arg, "--rewind-mb") == 0 && value != nullptr) {
+            options.rewindBudget = size_t(strtoull(value, nullptr, 10)) * 1024 * 1024;
+            i++;
+        } else if (strcmp(arg, "--rewind-uncompressed") == 0) {
+            options.rewindCompress = false;
+        } else if (strcmp(arg, "--savestate") == 0 && value != nullptr) {
+            options.savestate = value;
+            i++;
+        } else if (strcmp(arg, "--load-state") == 0 && value != nullptr) {
+            options.loadState = value;
+            i++;
+        } else if (strcmp(arg, "--acts") == 0 && value != nullptr) {
+            // comma separated
+            options.acts.clear();
+            for (const char* start = value; *start != '\0';) {
+                const char* end = strchr(start, ',');
+                if (end == nullptr) {
+                    end = start + strlen(start);
+                }
+                if (end != start) {
+                    options.acts.emplace_back(start, end);
+                }
+                start = *end == ',' ? end + 1 : end;
+            }
+            if (options.acts.empty()) {
+                options.acts = GameOptions().acts;
+            }
+            i++;
+        } else if (strcmp(arg, "--pack") == 0 && value != nullptr) {
+            options.assetPack = value;
+            i++;
+        } else if (strcmp(arg, "--loose-assets") == 0) {
+            options.assetPack.clear();
+        } else {
+            SDL_Log("Ignoring unknown argument: %s", arg);
+        }
+    }
+    if (!options.timedemo.empty()) {
+        options.inputLog = options.timedemo;
+    }
+    // replaying input and comparing hashes only make sense when nothing else can change the outcome
+    if (!options.inputLog.empty() || !options.hashOut.empty() || !options.hashCompare.empty()) {
+        options.deterministic = true;
+    }
+    return options;
+}
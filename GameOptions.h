@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/// @brief Start-up options, parsed from the command line
+struct GameOptions
+{
+    // build tile-layer vertex data in chunks around the camera instead of for the whole map
+    bool streamChunks = false;
+    // upper bound on the vertex data kept resident by the chunk streamer, in bytes
+    size_t chunkMemoryBudget = 8 * 1024 * 1024;
+    // trace collision surfaces region by region as the camera and actors approach, instead of all at start-up
+    bool lazyTracing = false;
+    // check while loading that tracing region by region gives the same surfaces as tracing the whole map at once
+    bool checkTrace = false;
+    // run without a window, drawing nothing and not waiting between frames
+    bool headless = false;
+    // quit after this many frames, 0 to run until the window is closed
+    unsigned long maxFrames = 0;
+    // frames per second to pace drawing to, 0 to leave it to vsync
+    unsigned int targetFps = 60;
+    // step the simulation on its own thread, handing finished steps to the renderer through a triple buffer
+    bool simThread = false;
+    // textures nothing references any more are released once the resident ones add up to more than this, in bytes
+    size_t textureBudget = 256 * 1024 * 1024;
+    // asset pack to read assets from, falling back to the loose files when it's missing; empty for loose files only
+    std::string assetPack = "assets.pack";
+    // extra wandering entities to simulate alongside the player, for measuring the simulation step
+    size_t stressEntities = 0;
+    // stress entities path-find to the player, each once a second, instead of wandering
+    bool stressPathing = false;
+    // particles to keep flying around the player, for measuring particle stepping and drawing
+    size_t stressParticles = 0;
+    // pixels around the view that entities stay awake in; further out they sleep until the view comes back. -1 keeps every entity awake
+    int activationMargin = 256;
+    // threads besides the simulation's to split each simulation step across, -1 for one per remaining core
+    int jobWorkers = -1;
+    // step the simulation once per frame as fast as possible, taking player input only from inputLog
+    bool deterministic = false;
+    // input to feed the player in deterministic mode, recorded by an earlier run
+    std::string inputLog;
+    // file to write the state hash of every simulation step to, and a file from an earlier run to compare them with
+    std::string hashOut;
+    std::string hashCompare;
+    // file to record the player's input to, for replaying with inputLog or timedemo
+    std::string recordInput;
+    // input log to replay as fast as frames can be drawn, timing every frame
+    std::string timedemo;
+    // file to write the timedemo's results to as JSON, empty for standard output
+    std::string timedemoReport;
+    // memory for rewinding through recent simulation steps, in bytes, 0 to turn rewinding off
+    size_t rewindBudget = 32 * 1024 * 1024;
+    // zstd-compress what the rewind buffer keeps, for much longer history at a small cost per step
+    bool rewindCompress = true;
+    // savestate file F5 saves to and F8 loads from
+    std::string savestate = "quicksave.sav";
+    // savestate to start from instead of the start of the map
+    std::string loadState;
+    // maps of the game's acts, played in order; each one is preloaded while the one before it plays
+    std::vector<std::string> acts = { "assets/robotropolis.tmj" };
+
+    static GameOptions FromArgs(int argc, char** argv);
+};
@@ -1,623 +1,771 @@
 #include "GameWindow.h"
-#include "SpriteSheet.h"
+#include "AnimationTable.h"
 #include "Actor.h"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
-#include "MapLayer.h"
-#include <tmxlite/Map.hpp>
-#include <tmxlite/TileLayer.hpp>
-#include <iostream>
-#include <fstream>
+#include "Level.h"
+#include "LevelManager.h"
+#include "Renderer.h"
+#include "Texture.h"
+#include "RenderSnapshot.h"
+#include "GameLoop.h"
+#include "TaskGraph.h"
+#include "TextureRegistry.h"
+#include "Assets.h"
+#include "EntityStore.h"
+#include "JobSystem.h"
+#include "StateHash.h"
+#include "InputLog.h"
+#include "RewindBuffer.h"
+#include "WorldState.h"
+#include "Savestate.h"
+#include "ParticleSystem.h"
+#include "Collectibles.h"
+#include "ActivationRegions.h"
+#include "TriggerVolumes.h"
+#include "NavGraph.h"
+#include <algorithm>
+#include <thread>
+
+GameWindow::GameWindow(std::unique_ptr<Renderer> renderer, pixelpos size, const GameOptions& options) : 
+    camera{ 0, 0 },
+    simCamera{ 0, 0 },
+    prevSimCamera{ 0, 0 },
+    step(0),
+    updates(0),
+    inputRecorder(nullptr),
+    size(size),
+    renderer(std::move(renderer)),
+    textureRegistry(std::make_unique<TextureRegistry>(*this->renderer, options.textureBudget)),
+    pendingTransition(false),
+    deterministic(options.deterministic),
+    lazyTracing(options.lazyTracing),
+    jobs(std::make_unique<JobSystem>(options.jobWorkers >= 0 ? unsigned(options.jobWorkers) : std::max(std::thread::hardware_concurrency(), 1u) - 1)),
+    entities(std::make_unique<EntityStore>()),
+    actors(std::make_unique<ObjectPool<Actor>>()),
+    activation(options.activationMargin >= 0 ? std::make_unique<ActivationRegions>(options.activationMargin) : nullptr),
+    particles(std::make_unique<ParticleSystem>()),
+    dustParticles(0),
+    sparkParticles(0),
+    stressEntities(options.stressEntities),
+    stressParticles(options.stressParticles),
+    stressPathing(options.stressPathing),
+    playerGrounded(false),
+    rewindBuffer(options.rewindBudget != 0 ? std::make_unique<RewindBuffer>(options.rewindBudget, RewindKeyframeInterval, options.rewindCompress) : nullptr),
+    rewinding(false),
+    savestatePath(options.savestate)
+{
+    levels = std::make_unique<LevelManager>(options.acts, options, size, *textureRegistry);
+}
 
-bool isSideWallTile(TileType tileType)
+bool GameWindow::load(const GameOptions& options)
 {
-    switch (tileType)
-    {
-    case TileType::SideWall:
-    case TileType::SideWallAngled1:
-    case TileType::SideWallAngled2:
-    case TileType::SideWallAngled3:
-    case TileType::SideWallAngled4:
-        return true;
-    default:
+    // everything but the texture uploads runs on workers; the level adds the tasks that depend on what's in
+    // the map once it knows how many tilesets and layers there are
+    TaskGraph graph;
+    TextureRegistry::DecodedImage playerImage;
+    std::shared_ptr<Texture> playerTexture;
+    std::shared_ptr<const AnimationTable> playerAnimations;
+    const char* playerImagePath = "assets/images/sonic3.png";
+    // without a display only the image size is needed, which the upload reads straight from the file
+    const bool decodeImages = !renderer->isHeadless();
+
+    TaskGraph::TaskId decodePlayer = graph.add("decode player sprite", [&]() {
+        return TextureRegistry::Decode(playerImagePath, decodeImages, playerImage);
+    });
+    TaskGraph::TaskId uploadPlayer = graph.add("upload player sprite", [&]() {
+        playerTexture = textureRegistry->acquire(playerImagePath, playerImage);
+        SDL_FreeSurface(playerImage.surface);
+        playerImage.surface = nullptr;
+        return playerTexture != nullptr;
+    }, { decodePlayer }, TaskGraph::Affinity::Main);
+    graph.add("create particle textures", [&]() {
+        return createParticleKinds();
+    }, {}, TaskGraph::Affinity::Main);
+    TaskGraph::TaskId parsePlayerSprite = graph.add("parse player sprite config", [&]() {
+        playerAnimations.reset(AnimationTable::Create("assets/sprites/sonic.json"));
+        return playerAnimations != nullptr;
+    });
+
+    level = std::make_shared<Level>(levels->getActPath(0), options, size);
+    level->addLoadTasks(graph, *textureRegistry, decodeImages, true, [&](TaskGraph::TaskId trace) {
+        TaskGraph::TaskId spawnPlayer = graph.add("spawn player", [&]() {
+            particles->setGround(level->get_geometries());
+            playerActor.reset(new PlayerActor(*this, *entities, playerAnimations, playerTexture, level->getSpawn()));
+            return true;
+        }, { trace, uploadPlayer, parsePlayerSprite });
+        if (options.stressEntities != 0) {
+            graph.add("spawn stress entities", [&]() {
+                spawnStressEntities(options.stressEntities);
+                return true;
+            }, { spawnPlayer });
+        }
+    });
+
+    unsigned int workerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    bool success = graph.run(workerCount);
+    graph.report("Startup");
+    if (!success) {
+        // whatever got decoded but never uploaded
+        SDL_FreeSurface(playerImage.surface);
         return false;
     }
+    textureRegistry->logStats();
+    // a single act would only preload a second copy of itself; restarting it loads it when the transition comes
+    if (levels->getActCount() > 1) {
+        levels->preload(levels->getFollowingAct());
+    }
+    return true;
 }
 
-bool isGroundTile(TileType tileType)
+GameWindow::~GameWindow()
 {
-    switch (tileType)
-    {
-    case TileType::Ground:
-    case TileType::GroundAngled1:
-    case TileType::GroundAngled2:
-    case TileType::GroundAngled3:
-    case TileType::GroundAngled4:
-        return true;
-    default:
-        return false;
-    }
+    // everything holding textures has to go before the renderer, and the renderer before SDL itself
+    logPoolStats();
+    playerActor.reset();
+    actors.reset();
+    particles.reset();
+    particleTexture.reset();
+    entities.reset();
+    jobs.reset();
+    levels.reset();
+    level.reset();
+    textureRegistry.reset();
+    renderer.reset();
+    Assets::Unmount();
+    IMG_Quit();
+    SDL_Quit();
 }
 
-SpriteConfig sonicSpriteCfg{
-  "Sonic",
-  {
-    {
-      ActorState::Default,
-      {
-        { 0, 0, 30, 42 }
-      }
-    },
-    {
-      ActorState::Idle,
-      {
-        { 30, 0, 31, 42 },
-        { 61, 0, 32, 42 },
-        { 94, 0, 33, 42 },
-        { 127, 0, 33, 42 },
-        { 160, 0, 33, 42 },
-        { 193, 0, 33, 42 },
-        { 226, 0, 34, 42 },
-        { 260, 0, 37, 42 },
-        { 297, 0, 34, 42 },
-        { 330, 0, 33, 42 },
-        { 363, 0, 28, 42 },
-        { 391, 0, 28, 42 }
-      }
-    },
-    {
-      ActorState::LookingUp,
-      {
-        { 419, 0, 33, 42 }, { 452, 0, 28, 42 }
-      }
+void GameWindow::switchLevel(std::shared_ptr<Level> nextLevel)
+{
+    const uint64_t start = SDL_GetPerformanceCounter();
+    // the old act's actors and stress entities go with it; the player carries on into the new one
+    actors->clear();
+    const EntityStore::EntityId playerEntity = playerActor->getEntity();
+    for (size_t i = entities->size(); i-- > 0;) {
+        if (entities->getId(i) != playerEntity) {
+            entities->remove(entities->getId(i));
+        }
     }
-  }
-};
+    stressIds.clear();
+    levels->retire(std::move(level));
+    level = std::move(nextLevel);
+    particles->setGround(level->get_geometries());
+    entities->teleport(playerEntity, level->getSpawnPos());
+    playerGrounded = false;
+    if (stressEntities != 0) {
+        spawnStressEntities(stressEntities);
+    }
+    if (activation != nullptr) {
+        activation->rebuild(*entities);
+    }
+    triggerEvents.clear();
+    updateTriggers(false);
+    // nothing before this step can be gone back to in the new act
+    if (rewindBuffer != nullptr) {
+        rewindBuffer->clear();
+    }
+    SDL_Log("Switched to act %zu of %zu, %s, in %.2f ms", levels->getCurrentAct() + 1, levels->getActCount(), level->getMapPath().c_str(),
+        (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency());
+    if (levels->getActCount() > 1) {
+        levels->preload(levels->getFollowingAct());
+    }
+}
 
-bool GameWindow::any_surface_intersects(TileLayerId surfaceType, const mappoint& mt)
+GameWindow *GameWindow::Create(const GameOptions& options)
 {
-    for(const auto& surface : surfaces) {
-        if((surfaceType == TileLayerId::Any || surface.layer == surfaceType) && surface.mapRect.intersects(mt)) {
-            return true;
+    uint64_t start = SDL_GetPerformanceCounter();
+    if(SDL_Init( options.headless ? SDL_INIT_EVENTS : SDL_INIT_VIDEO ) < 0) return nullptr;
+    
+    std::unique_ptr<Renderer> renderer;
+    if (options.headless) {
+        renderer = std::make_unique<NullRenderer>();
+    } else {
+        // a timedemo measures how fast frames can be drawn, so it mustn't wait for the display
+        renderer.reset(SdlRenderer::Create("Sonic Freedom Fighters", 852, 480, options.timedemo.empty()));
+        if(renderer == nullptr)
+        {
+            SDL_Quit();
+            return nullptr;
         }
     }
-    return false;
+    if(!(IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG)) 
+    {
+        SDL_Log("Failed to initialize SDL_Image: %s", SDL_GetError());
+        renderer.reset();
+        SDL_Quit();
+        return nullptr;
+    }
+    const double toMs = 1000.0 / SDL_GetPerformanceFrequency();
+    SDL_Log("Startup: %-32s %8.2f ms", "SDL and renderer init", (SDL_GetPerformanceCounter() - start) * toMs);
+
+    if (!options.assetPack.empty() && !Assets::Mount(options.assetPack)) {
+        SDL_Log("No asset pack at %s, reading loose files", options.assetPack.c_str());
+    }
+    GameWindow* window = new GameWindow(std::move(renderer), { 852, 480 }, options);
+    if (!window->load(options) ||
+        (!options.loadState.empty() && !window->loadStateFile(options.loadState))) {
+        delete window;
+        return nullptr;
+    }
+    SDL_Log("Startup: total %.2f ms", (SDL_GetPerformanceCounter() - start) * toMs);
+    return window;
+}
+
+bool GameWindow::isHeadless() const
+{
+    return renderer->isHeadless();
 }
 
 tripoint GameWindow::getTripointAtMapPoint(const mappoint& mt)
 {
-    float zlevel = getZLevelAtAdjacentPoint(mt);
-    tripoint output{ -1.f, -1.f, -1.f };
-    if (zlevel != -1) {
-        getRealPosFromMapPos(mt, output, zlevel);
-    }
-    return output;
+    return level->getTripointAtMapPoint(mt);
 }
 
-float GameWindow::getZLevelAtAdjacentPoint(const mappoint& mt, TileLayerId layer)
+int GameWindow::collide(const cylinder& collisionCyl, float& groundY) const
 {
-    if (layer == TileLayerId::Ground || layer == TileLayerId::Any) {
-        for (const SurfaceData& groundSurface : surfaces) {
-            if (groundSurface.layer == TileLayerId::Ground && groundSurface.mapRect.intersects(mappoint{ mt.x, mt.y - 1 })) {
-                return groundSurface.dimensions.p1.z + (mt.y - groundSurface.mapRect.p1.y);
-            }
-        }
-    }
-    for(const auto &surface : surfaces) {
-        if (surface.layer != TileLayerId::Ground && (surface.layer == layer || layer == TileLayerId::Any)) {
-            if (surface.mapRect.intersects(mappoint{ mt.x, mt.y - 1 })) {
-                if (surface.dimensions.p2.z > (surface.dimensions.p1.z + 1)) {
-                    return (float(mt.x) - surface.mapRect.p1.x) * 2;
-                } else {
-                    return  surface.dimensions.p2.z;
-                }
-            } else if (surface.mapRect.intersects(mappoint{ mt.x + 1, mt.y })) {
-                //currentZ = surface.dimensions.p2.z - surface.dimensions.p1.z + 
-            } else if (surface.layer == TileLayerId::ForegroundWall && 
-                surface.mapRect.intersects(mappoint{ mt.x - 1, mt.y }) && 
-                surface.mapRect.p2.x == mt.x) {
-                return surface.dimensions.p2.z;
-            }
-        }
-    }
-    return -1;
+    return level->collide(collisionCyl, groundY);
 }
 
-float GameWindow::getZLevelAtPoint(const mappoint &mt, TileLayerId layer)
+void GameWindow::handle_input(const SDL_Event& event)
 {
-    if (layer == TileLayerId::Ground || layer == TileLayerId::Any) {
-        for (const SurfaceData& groundSurface : surfaces) {
-            if (groundSurface.layer == TileLayerId::Ground && groundSurface.mapRect.intersects(mappoint{ mt.x, mt.y - 1 })) {
-                return groundSurface.dimensions.p1.z + (mt.y - groundSurface.mapRect.p1.y);
-            }
-        }
-    }
-    for(const auto &surface : surfaces) {
-        if (surface.layer != TileLayerId::Ground && (surface.layer == layer || layer == TileLayerId::Any)) {
-            if (surface.mapRect.intersects(mappoint{ mt.x, mt.y })) {
-                if (surface.dimensions.p2.z > (surface.dimensions.p1.z + 1)) {
-                    return (float(mt.x) - surface.mapRect.p1.x) * 2;
-                } else {
-                    return  surface.dimensions.p2.z;
-                }
-            } 
-        }
-    }
-    return -1;
+    std::lock_guard<std::mutex> lock(inputMutex);
+    pendingInput.push_back(event);
 }
 
-void GameWindow::parseLayerSurfaces(const char *layerName, TileLayerId layerId, std::function<bool (const tmx::TileLayer&, mappoint&, SurfaceData& surface)> parseFunc)
+void realPosToSdlPos(const tripoint &tp, SDL_Point &sp)
 {
-    auto layer = getLayerByName(layerName);
-    if(layer != nullptr) {
-        const auto& layerSize = layer->getSize();
-        float currentZ = 0;
-        mappoint mt{ 0, 0 };
-        SurfaceData surfaceData;
-        surfaceData.layer = layerId;
-        for (; mt.x < layerSize.x; ++mt.x) {
-            for (mt.y = 0; mt.y < layerSize.y; ++mt.y) {
-                if(parseFunc(*layer, mt, surfaceData)){
-                    surfaces.push_back(surfaceData);
-                }
-            }
-        }
-    }
+    pixelpos pp;
+    getPixelPosFromRealPos(tp, pp);
+    sp.x = pp.x;
+    sp.y = pp.y;
 }
 
-GameWindow::GameWindow(SDL_Window *window, SDL_Renderer *renderer, tmx::Map& map, pixelpos size) : 
-    camera{ 0, 0 },
-    size(size),
-    map(map),
-    curTime(0),
-    lastFrameTime(0),
-    z0pos{ 0, 0 },
-    bounds{ {0.f, 0.f, 0.f}, {0.f, 0.f, 0.f} },
-    mapSize(map.getTileCount()),
-    window(window),
-    renderer(renderer),
-    tilesetConfig(TilesetConfig::Create(std::string("assets/") + map.getTilesets()[0].getName() + ".json"))
+void drawLine(Renderer& renderer, const pixelpos& camera, const tripoint &p1, const tripoint &p2)
 {
-    //load the textures as they're shared between layers
-    const auto& tileSets = map.getTilesets();
-    assert(!tileSets.empty());
-    for (const auto& ts : tileSets) {
-        Texture* text = Texture::Create(renderer, ts.getImagePath());
-        if (text) {
-            textures.emplace_back(text);
-        }
-    }
-    //load the layers
-    const auto& mapLayers = map.getLayers();
-    for (auto i = 0u; i < mapLayers.size(); ++i) {
-        if (mapLayers[i]->getType() == tmx::Layer::Type::Tile) {
-            renderLayers.emplace_back(std::make_unique<MapLayer>());
-            renderLayers.back()->create(map, i, textures); //just cos we're using C++14
-        }
+    pixelpos pp1, pp2;
+    getPixelPosFromRealPos(p1, pp1);
+    getPixelPosFromRealPos(p2, pp2);
+    renderer.drawLine(pp1.x - camera.x, pp1.y - camera.y, pp2.x - camera.x, pp2.y - camera.y);
+    
+}
+
+void drawRect(Renderer& renderer, const pixelpos& camera, const tripoint& p1, const tripoint& p2)
+{
+    pixelpos pp1, pp2;
+    getPixelPosFromRealPos(p1, pp1);
+    getPixelPosFromRealPos(p2, pp2);
+    SDL_Rect rect{pp1.x - camera.x, pp1.y - camera.y, pp2.x - pp1.x, pp2.y - pp1.y};
+    renderer.drawRect(rect);
+}
+
+void drawCuboid(Renderer& renderer, const pixelpos& camera, const tripoint &p1, const tripoint &p2)
+{
+    // rectangle representing the rear side
+    drawRect(renderer, camera, p1, {p2.x, p2.y, p1.z});
+
+    // rectangle representing the front  side
+    drawRect(renderer, camera, {p1.x, p1.y, p2.z}, p2);
+
+    // lines connecting front side to rear side
+    drawLine(renderer, camera, {p1.x, p1.y, p1.z}, {p1.x, p1.y, p2.z});
+    drawLine(renderer, camera, {p2.x, p1.y, p1.z}, {p2.x, p1.y, p2.z});
+    drawLine(renderer, camera, {p1.x, p2.y, p1.z}, {p1.x, p2.y, p2.z});
+    drawLine(renderer, camera, {p2.x, p2.y, p1.z}, {p2.x, p2.y, p2.z});
+}
+
+void GameWindow::update(float deltaTime)
+{
+    {
+        std::lock_guard<std::mutex> lock(inputMutex);
+        stepInput.swap(pendingInput);
     }
-    float currentZ = 0.f;
-    parseLayerSurfaces("Background", TileLayerId::BackgroundWall, [this, &currentZ](const tmx::TileLayer &layer, mappoint &mt, SurfaceData &surface) {
-        TileType bgTileType = getTileType(mt, layer);
-        bool traceSuccess = false;
-        if(bgTileType == TileType::Wall) {
-            traceSuccess = traceWallTiles(mt, layer, currentZ, surface);
-        } else if(bgTileType == TileType::SideWallAngled1) {
-            traceSuccess = traceSideWallTiles(mt, layer, currentZ, surface);
-            currentZ = surface.dimensions.p2.z;
-        }
-        if(traceSuccess) {
-            mt.x = surface.mapRect.p2.x - 1;
-            mt.y = surface.mapRect.p2.y - 1;
+    for (const SDL_Event& event : stepInput) {
+        if (inputRecorder != nullptr) {
+            inputRecorder->add(updates, event);
         }
-        return traceSuccess;
-    });
-    parseLayerSurfaces("walls", TileLayerId::ForegroundWall, [this](const tmx::TileLayer &layer, mappoint &mt, SurfaceData &surface) {
-        bool parseSuccess = false;
-        TileType bgTileType = getTileType(mt, layer);
-        if((bgTileType == TileType::Wall || bgTileType == TileType::SideWallAngled1) && !any_surface_intersects(TileLayerId::ForegroundWall, mt)) {
-            float zOffset = 0;
-            if(bgTileType == TileType::Wall) {
-                zOffset = getZLevelAtAdjacentPoint({ mt.x, mt.y }, TileLayerId::ForegroundWall);
-                if(zOffset == -1) {
-                    zOffset = getZLevelAtPoint({ mt.x, mt.y }, TileLayerId::BackgroundWall);
-                }
-                parseSuccess = traceWallTiles(mt, layer, zOffset, surface);
+        if ((event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) && event.key.keysym.sym == SDLK_BACKSPACE) {
+            rewinding = event.type == SDL_KEYDOWN;
+        } else if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F9) {
+            retryFrom(5.f);
+        } else if (event.type == SDL_KEYDOWN && (event.key.keysym.sym == SDLK_F5 || event.key.keysym.sym == SDLK_F8)) {
+            // a run that's replayed or recorded mustn't depend on, or write over, whatever savestate is on disk
+            if (deterministic || inputRecorder != nullptr) {
+                SDL_Log("Savestates are off while input is being replayed or recorded");
+            } else if (event.key.keysym.sym == SDLK_F5) {
+                saveStateFile(savestatePath);
             } else {
-                zOffset = getZLevelAtPoint({ mt.x - 1, mt.y }, TileLayerId::BackgroundWall);
-                parseSuccess = traceSideWallTiles(mt, layer, zOffset, surface);
+                loadStateFile(savestatePath);
             }
+        } else if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F10) {
+            pendingTransition = true;
         }
-        return parseSuccess;
-    });
-    parseLayerSurfaces("Foreground", TileLayerId::Ground, [this](const tmx::TileLayer &layer, mappoint &mt, SurfaceData &surface) {
-        TileType fgTileType = getTileType(mt, layer);
-        if(isGroundTile(fgTileType) && !any_surface_intersects(TileLayerId::Ground, mt)) {
-            float currentZ = getZLevelAtAdjacentPoint(mt);
-            traceGroundTiles(mt, layer, currentZ, surface);
-            return true;
-        }
-        return false;
-    });
-    parseLayerSurfaces("collidables", TileLayerId::Obstacle, [this](const tmx::TileLayer &layer, mappoint &mt, SurfaceData &surface) {
-        TileType fgTileType = getTileType(mt, layer);
-        if(fgTileType == TileType::Box && !any_surface_intersects(TileLayerId::Obstacle, mt)) {
-            float currentZ = getZLevelAtPoint(mt);
-            traceBoxTiles(mt, layer, currentZ, surface);
-            return true;
-        }
-        return false;
-    });
-    z0pos = { surfaces[0].mapRect.p1.x, surfaces[0].mapRect.p1.y };
-    for(const auto &surface : surfaces) {
-        if(surface.dimensions.p1.x < bounds.p1.x) {
-            bounds.p1.x = surface.dimensions.p1.x;
-        }
-        if(surface.dimensions.p1.y < bounds.p1.y) {
-            bounds.p1.y = surface.dimensions.p1.y;
+        playerActor->handle_input(event);
+    }
+    stepInput.clear();
+    updates++;
+
+    if (rewinding && rewindBuffer != nullptr) {
+        // step back instead of forward, stopping at the oldest capture there is
+        if (step > rewindBuffer->oldestStep() && rewindBuffer->restore(step - 1, worldState)) {
+            loadState(worldState.data(), worldState.size());
+            rewindBuffer->truncateAfter(step);
         }
-        if(surface.dimensions.p1.z < bounds.p1.z) {
-            bounds.p1.z = surface.dimensions.p1.z;
+        return;
+    }
+
+    levels->collectRetired();
+    bool switched = false;
+    if (pendingTransition) {
+        if (levels->getState() == LevelManager::State::Failed) {
+            // retried once per transition asked for, rather than over and over while the player waits
+            SDL_Log("Act %zu failed to load, staying in this one and loading it again", levels->getFollowingAct() + 1);
+            levels->preload(levels->getFollowingAct());
+            pendingTransition = false;
+        } else {
+            if (levels->getState() == LevelManager::State::Idle) {
+                // nothing's preloaded when the only act restarts, so it's loaded again now
+                levels->preload(levels->getFollowingAct());
+            }
+            if (std::shared_ptr<Level> nextLevel = levels->takeNext(deterministic)) {
+                switchLevel(std::move(nextLevel));
+                pendingTransition = false;
+                switched = true;
+            }
         }
-        if(surface.dimensions.p2.x > bounds.p2.x) {
-            bounds.p2.x = surface.dimensions.p2.x;
+    }
+    const EntityStore::EntityId playerEntity = playerActor->getEntity();
+    // entities the view wakes this step count towards how far the map is traced below
+    if (activation != nullptr) {
+        activation->update(*entities, simCamera, size, playerEntity);
+    }
+    if (lazyTracing) {
+        const unsigned int tileWidth = level->getTileWidth();
+        // only what each region adds goes into the particles' height grid
+        if (level->ensureTraced(unsigned(std::max(playerActor->getWindowPos().x + size.x / 2, 0)) / tileWidth)) {
+            particles->addGround(level->getTracedSurfaces());
         }
-        if(surface.dimensions.p2.y > bounds.p2.y) {
-            bounds.p2.y = surface.dimensions.p2.y;
+        // the rightmost entity decides how far the map has to be traced
+        if (level->ensureTraced(unsigned(entities->getMaxPixelX(*jobs)) / tileWidth)) {
+            particles->addGround(level->getTracedSurfaces());
         }
-        if(surface.dimensions.p2.z > bounds.p2.z) {
-            bounds.p2.z = surface.dimensions.p2.z;
+    }
+    if (stressPathing) {
+        steerStressEntities();
+    }
+    entities->update(deltaTime, *this, *jobs);
+    const bool grounded = entities->collisionDirections[entities->indexOf(playerEntity)] & Down;
+    if (grounded && !playerGrounded) {
+        particles->burst(dustParticles, entities->getPos(playerEntity), 16, 3.f, 0.6f);
+    }
+    playerGrounded = grounded;
+    Collectibles& collectibles = level->getCollectibles();
+    if (collectibles.collect(entities->getCollisionCylinder(playerEntity), pickedItems) != 0) {
+        for (uint32_t item : pickedItems) {
+            particles->burst(sparkParticles, collectibles.getItem(item).pos, 8, 4.f, 0.4f);
         }
     }
-    playerActor.reset(new PlayerActor(*this, sonicSpriteCfg, Texture::Create(renderer, "assets/images/sonic3.png"), { 13, 11 }));
-}
-
-GameWindow::~GameWindow()
-{
-    SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(window);
-    IMG_Quit();
-    SDL_Quit();
-}
-
-TileType GameWindow::getTileType(const mappoint &mt, const tmx::TileLayer &layer)
-{
-    int tileId = layer.getTiles()[mapSize.x * mt.y + mt.x].ID;
-    if(tileId == 0) {
-        return TileType::None;
+    if (entities->getPos(playerEntity).y > level->getBounds().p2.y + FallOutDepth) {
+        respawnPlayer();
+    }
+    updateTriggers(true);
+    if (particles->size(sparkParticles) < stressParticles) {
+        tripoint fountain = entities->getPos(playerEntity);
+        fountain.y -= 2.f;
+        particles->burst(sparkParticles, fountain, std::min<size_t>(stressParticles - particles->size(sparkParticles), 512), 12.f, 3.f);
     }
-    int fgid = map.getTilesets()[0].getFirstGID();
-    int lgid = map.getTilesets()[0].getLastGID();
-    if(tileId >= fgid && tileId <= lgid) {
-        tileId -= fgid;
+    particles->update(deltaTime, *jobs);
+    playerActor->update(deltaTime);
+    actors->forEach([deltaTime](Actor& actor) {
+        actor.update(deltaTime);
+    });
+    prevSimCamera = simCamera;
+    simCamera.x = playerActor->getWindowPos().x - (size.x / 2);
+    simCamera.y = playerActor->getWindowPos().y - (size.y / 2);
+    // the camera cuts rather than pans to a new act
+    if (step == 0 || switched) {
+        prevSimCamera = simCamera;
+    }
+    step++;
+    if (rewindBuffer != nullptr) {
+        saveState(worldState);
+        rewindBuffer->capture(step, worldState);
     }
-    return tilesetConfig->getTileType(tileId);
 }
 
-tmx::TileLayer *GameWindow::getLayerByName(const char *name)
+uint64_t GameWindow::stateHash() const
 {
-    const auto& layers = map.getLayers();
-    for (auto i = 0u; i < layers.size(); ++i) {
-        if(layers[i]->getType() == tmx::TileLayer::Type::Tile) {
-            tmx::TileLayer &layer = layers[i]->getLayerAs<tmx::TileLayer>();
-            if(layer.getName() == name) {
-                return &layer;
-            }
-        }
-    }
-    return nullptr;
+    uint64_t hash = HashBytes(&step, sizeof(step), StateHashStream::Seed);
+    hash = HashBytes(&simCamera, sizeof(simCamera), hash);
+    hash = level->getCollectibles().hash(hash);
+    return entities->hash(hash);
 }
 
-bool GameWindow::getNextSideGroundTile(mappoint& mt, const tmx::TileLayer& layer)
+void GameWindow::saveState(std::vector<char>& out) const
 {
-    TileType tileTmp = getTileType(mt, layer);
-    if (tileTmp == TileType::GroundAngled2 || tileTmp == TileType::GroundAngled4) {
-        mt.x++;
-        mt.y++;
-        return true;
-    } else if (tileTmp == TileType::GroundAngled1 ||  tileTmp == TileType::GroundAngled3) {
-        mt.y++;
-        return true;
-    } else {
-        return false;
-    }
+    out.clear();
+    StateWriter writer(out);
+    writer.write(step);
+    writer.write(simCamera);
+    writer.write(prevSimCamera);
+    entities->saveState(writer);
+    writer.write(uint32_t(1 + actors->size()));
+    playerActor->saveState(writer);
+    actors->forEach([&writer](const Actor& actor) {
+        actor.saveState(writer);
+    });
+    level->getCollectibles().saveState(writer);
 }
 
-bool GameWindow::traceBoxTiles(const mappoint& mt, const tmx::TileLayer &layer, float currentZ, SurfaceData &surface)
+bool GameWindow::loadState(const char* data, size_t length)
 {
-    TileType lastTileType = TileType::None;
-    TileType curTileType = getTileType(mt, layer);
-    TileType expectedTileType = TileType::None;
-    if(curTileType != TileType::Box) {
-        std::cout << "Bad map! Ground tiles organized in a way that tracer cannot trace the geometry! [" << mt.x << "," << mt.y << "]" << std::endl;
+    StateReader reader(data, length);
+    uint64_t loadedStep = 0;
+    pixelpos loadedCamera, loadedPrevCamera;
+    reader.read(loadedStep);
+    reader.read(loadedCamera);
+    reader.read(loadedPrevCamera);
+    // the whole capture is read into temporaries and checked before the world gets touched, so a bad one
+    // leaves it as it was
+    EntityStore loaded;
+    uint32_t actorCount = 0;
+    if (!loaded.loadState(reader) || !reader.read(actorCount) || loaded.size() != entities->size() || actorCount != 1 + actors->size()) {
+        SDL_Log("World state doesn't match this world");
         return false;
     }
-    surface.mapRect.p1 = surface.mapRect.p2 = mt;
-    
-    while(surface.mapRect.p2.x < mapSize.x && getTileType(surface.mapRect.p2, layer) == TileType::Box) {
-        surface.mapRect.p2.x++;
+    std::vector<Actor::SavedState> actorStates(actorCount);
+    for (Actor::SavedState& actorState : actorStates) {
+        Actor::ReadState(reader, actorState);
     }
-    surface.mapRect.p2.y++;
-    while (surface.mapRect.p2.y < mapSize.y &&
-        surface.mapRect.p2.x < mapSize.x &&
-    getTileType({surface.mapRect.p2.x - 1, surface.mapRect.p2.y - 1}, layer) == TileType::Box) {
-        surface.mapRect.p2.y++;
+    Collectibles::SavedState collectibleState;
+    if (!level->getCollectibles().readState(reader, collectibleState)) {
+        SDL_Log("World state doesn't match this level's collectibles");
+        return false;
     }
-    if(surface.mapRect.p2.y == mt.y) {
-        std::cout << "Bad map! Did not parse a single row of box tiles! [" << surface.mapRect.p2.x << "," << surface.mapRect.p2.y << "]" << std::endl;
+    if (!reader.good()) {
+        SDL_Log("World state is truncated");
         return false;
     }
-    getRealPosFromMapPos(surface.mapRect.p1, surface.dimensions.p1, currentZ);
-    getRealPosFromMapPos(surface.mapRect.p2, surface.dimensions.p2, currentZ + 1);
+
+    const MoveVector intent = entities->getIntent(playerActor->getEntity());
+    *entities = std::move(loaded);
+    entities->setIntent(playerActor->getEntity(), intent);
+    playerActor->loadState(actorStates[0]);
+    size_t actorIndex = 1;
+    actors->forEach([&actorStates, &actorIndex](Actor& actor) {
+        actor.loadState(actorStates[actorIndex++]);
+    });
+    level->getCollectibles().loadState(collectibleState);
+    if (activation != nullptr) {
+        activation->rebuild(*entities);
+    }
+    updateTriggers(false);
+    step = loadedStep;
+    simCamera = loadedCamera;
+    prevSimCamera = loadedPrevCamera;
     return true;
 }
 
-bool GameWindow::traceGroundTiles(const mappoint& mt, const tmx::TileLayer &layer, float currentZ, SurfaceData &surface)
+bool GameWindow::saveStateFile(const std::string& path)
 {
-    surface.layer = TileLayerId::Ground;
-    TileType lastTileType = TileType::None;
-    TileType curTileType = getTileType(mt, layer);
-    TileType expectedTileType = TileType::None;
-    if(curTileType != TileType::GroundAngled1 && curTileType != TileType::GroundAngled2) {
-        std::cout << "Bad map! Ground tiles organized in a way that tracer cannot trace the geometry! [" << mt.x << "," << mt.y << "]" << std::endl;
+    const uint64_t start = SDL_GetPerformanceCounter();
+    saveState(worldState);
+    if (!Savestate::Write(path, level->getMapPath(), worldState)) {
         return false;
     }
-    surface.mapRect.p1 = surface.mapRect.p2 = mt;
-    
-    while(surface.mapRect.p2.x < mapSize.x && isGroundTile(getTileType(surface.mapRect.p2, layer))) {
-        surface.mapRect.p2.x++;
-    }
-    mappoint leftTile = mt;
-    mappoint rightTile{ surface.mapRect.p2.x - 1, surface.mapRect.p2.y };
-    while (rightTile.y < mapSize.y &&
-        rightTile.x < mapSize.x &&
-        getNextSideGroundTile(leftTile, layer) &&
-        getNextSideGroundTile(rightTile, layer));
-    surface.mapRect.p2 = rightTile;
-    if(surface.mapRect.p2.y == mt.y) {
-        std::cout << "Bad map! Did not parse a single row of ground tiles! [" << surface.mapRect.p2.x << "," << surface.mapRect.p2.y << "]" << std::endl;
+    SDL_Log("Saved step %llu to %s (%zu KB of state) in %.2f ms", (unsigned long long)step, path.c_str(), worldState.size() / 1024,
+        (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency());
+    return true;
+}
+
+bool GameWindow::loadStateFile(const std::string& path)
+{
+    const uint64_t start = SDL_GetPerformanceCounter();
+    if (!Savestate::Read(path, level->getMapPath(), worldState) || !loadState(worldState.data(), worldState.size())) {
+        SDL_Log("Failed to load savestate %s", path.c_str());
         return false;
     }
-    if(getTileType({rightTile.x, rightTile.y - 1}, layer) == TileType::GroundAngled3) {
-        surface.mapRect.p2.x++;
+    // the world didn't get here through what the rewind buffer holds
+    if (rewindBuffer != nullptr) {
+        rewindBuffer->clear();
     }
-    getRealPosFromMapPos(surface.mapRect.p1, surface.dimensions.p1, currentZ);
-    getRealPosFromMapPos(surface.mapRect.p2, surface.dimensions.p2, currentZ + (surface.mapRect.p2.y - surface.mapRect.p1.y) );
+    SDL_Log("Loaded step %llu from %s in %.2f ms", (unsigned long long)step, path.c_str(),
+        (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency());
     return true;
 }
 
-bool GameWindow::traceWallTiles(const mappoint& mt, const tmx::TileLayer &layer, float currentZ, SurfaceData &surface)
+bool GameWindow::retryFrom(float secondsAgo)
 {
-    TileType lastTileType = TileType::None;
-    TileType curTileType = getTileType(mt, layer);
-    TileType expectedTileType = TileType::None;
-    if(curTileType != TileType::Wall && curTileType != TileType::SideWallAngled1) {
-        std::cout << "Bad map! Wall tiles organized in a way that tracer cannot trace the geometry! [" << mt.x << "," << mt.y << "]" << std::endl;
+    if (rewindBuffer == nullptr || rewindBuffer->empty()) {
         return false;
     }
-    surface.mapRect.p1 = surface.mapRect.p2 = mt;
-    while(surface.mapRect.p2.y < mapSize.y && getTileType(surface.mapRect.p2, layer) == TileType::Wall) {
-        surface.mapRect.p2.y++;
-    }
-    surface.mapRect.p2.x++;
-    while(surface.mapRect.p2.x < mapSize.x && 
-        getTileType({ surface.mapRect.p2.x, surface.mapRect.p1.y }, layer) == TileType::Wall &&
-        getTileType({ surface.mapRect.p2.x, surface.mapRect.p2.y - 1 }, layer) == TileType::Wall) {
-
-        surface.mapRect.p2.x++;
+    const uint64_t stepsAgo = uint64_t(secondsAgo / GameLoop::SimulationStep);
+    const uint64_t target = std::max(step > stepsAgo ? step - stepsAgo : 0, rewindBuffer->oldestStep());
+    if (!rewindBuffer->restore(target, worldState) || !loadState(worldState.data(), worldState.size())) {
+        return false;
     }
-    getRealPosFromMapPos(surface.mapRect.p1, surface.dimensions.p1, currentZ);
-    getRealPosFromMapPos(surface.mapRect.p2, surface.dimensions.p2, currentZ);
+    rewindBuffer->truncateAfter(target);
     return true;
 }
 
-/// @brief Trace a 3D ground surface from the 2D map by looking at the geometry of the tiles as defined in JSON
-/// @param mt coordinate on the 2D map
-/// @param layer Current layer being considered
-/// @param currentZ derived Z-point in 3D space
-/// @param surface Surface data to be written, containing the 3D collision data from the detected surface
-bool GameWindow::traceSideWallTiles(const mappoint& mt, const tmx::TileLayer &layer, float currentZ, SurfaceData &surface)
+void GameWindow::snapshot(RenderSnapshot& out) const
 {
-    TileType lastTileType = TileType::None;
-    TileType curTileType = getTileType(mt, layer);
-    TileType expectedTileType = TileType::None;
-    if(curTileType != TileType::SideWallAngled1 && curTileType != TileType::SideWallAngled2) {
-        std::cout << "Bad map! Side-wall tiles organized in a way that tracer cannot trace the geometry! [" << mt.x << "," << mt.y << "]" << std::endl;
-        return false;
-    }
-    surface.mapRect.p1 = surface.mapRect.p2 = mt;
-    while(surface.mapRect.p2.y < mapSize.y && isSideWallTile(getTileType(surface.mapRect.p2, layer))) {
-        surface.mapRect.p2.y++;
-    }
-    surface.mapRect.p2.y--;
-    int y2_start = surface.mapRect.p2.y;
-    TileType tileTmp = TileType::None, lastTile = TileType::None;
-    while(surface.mapRect.p2.x < layer.getSize().x && 
-        surface.mapRect.p2.y < layer.getSize().y) {
-        tileTmp = getTileType({ surface.mapRect.p2.x, surface.mapRect.p2.y }, layer);
-        if (tileTmp == TileType::SideWallAngled1 || tileTmp == TileType::SideWallAngled4) {
-            surface.mapRect.p2.x++;
-            surface.mapRect.p2.y++;
-        } else if(tileTmp == TileType::SideWallAngled2 || tileTmp == TileType::SideWallAngled3) {
-            surface.mapRect.p2.y++;
-        } else {
-            break;
+    out.step = step;
+    out.level = level;
+    out.prevCamera = prevSimCamera;
+    out.camera = simCamera;
+    // the camera follows the player, so this is also how fast the camera is moving
+    out.cameraVelocityX = (simCamera.x - prevSimCamera.x) / GameLoop::SimulationStep;
+    out.cameraVelocityY = (simCamera.y - prevSimCamera.y) / GameLoop::SimulationStep;
+
+    // sleeping actors are off screen, so they're left out
+    out.actors.resize(1 + actors->size());
+    playerActor->snapshot(out.actors[0]);
+    size_t actorIndex = 1;
+    actors->forEach([this, &out, &actorIndex](const Actor& actor) {
+        if (entities->isAwake(actor.getEntity())) {
+            actor.snapshot(out.actors[actorIndex++]);
+        }
+    });
+    out.actors.resize(actorIndex);
+    particles->snapshot(out.particles);
+    out.collectibles.resize(2);
+    const Collectibles::Kind itemKinds[] = { Collectibles::Kind::Ring, Collectibles::Kind::Monitor };
+    const SDL_Color itemColors[] = { { 255, 200, 0, 255 }, { 80, 140, 255, 255 } };
+    const float itemSizes[] = { 8.f, 14.f };
+    for (size_t i = 0; i < out.collectibles.size(); i++) {
+        ParticleBatchSnapshot& batch = out.collectibles[i];
+        batch.texture = particleTexture.get();
+        batch.source = { 0, 0, 4, 4 };
+        batch.color = itemColors[i];
+        batch.size = itemSizes[i];
+        level->getCollectibles().snapshot(itemKinds[i], batch);
+    }
+
+    out.debugCuboids.clear();
+    for (const auto& surface : level->get_geometries()) {
+        // pixel x and y both grow with every real axis, so p1 and p2 give the surface's on-screen extent
+        pixelpos pp1, pp2;
+        getPixelPosFromRealPos(surface.dimensions.p1, pp1);
+        getPixelPosFromRealPos(surface.dimensions.p2, pp2);
+        if (std::max(pp1.x, pp2.x) >= simCamera.x && std::min(pp1.x, pp2.x) < simCamera.x + size.x &&
+            std::max(pp1.y, pp2.y) >= simCamera.y && std::min(pp1.y, pp2.y) < simCamera.y + size.y) {
+            out.debugCuboids.push_back(surface.dimensions);
         }
-        lastTile = tileTmp;
     }
-    if (surface.mapRect.p2.y == mt.y) {
-        std::cout << "Bad map! Did not parse a single column of side-wall tiles!" << std::endl;
-        return false;
-    } 
-    getRealPosFromMapPos(surface.mapRect.p1, surface.dimensions.p1, currentZ);
-    getRealPosFromMapPos(surface.mapRect.p2, surface.dimensions.p2, currentZ + (surface.mapRect.p2.y - y2_start) + 1);
-    return true;
+    const auto &pCyl = playerActor->getCollisionGeometry();
+    out.debugCuboids.push_back({ {pCyl.x - pCyl.r, pCyl.y1, pCyl.z - pCyl.r}, {pCyl.x + pCyl.r, pCyl.y2, pCyl.z + pCyl.r} });
 }
 
-GameWindow *GameWindow::Create()
+void GameWindow::render(const RenderSnapshot& snapshot, float alpha)
 {
-    if(SDL_Init( SDL_INIT_VIDEO ) < 0) return nullptr;
-    
-    SDL_Window *window = SDL_CreateWindow("Sonic Freedom Fighters", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 852, 480, SDL_WINDOW_SHOWN);
-  
-    if(window == nullptr) 
-    {
-        SDL_Log("Failed to create window: %s", SDL_GetError());
-        SDL_Quit();
-        return nullptr;
+    // this is the renderer thread, where the next act's tilesets get uploaded, a frame's worth at a time
+    levels->pumpUploads();
+    renderer->setDrawColor(100, 149, 237, 255);
+    renderer->clear();
+    camera.x = snapshot.prevCamera.x + int((snapshot.camera.x - snapshot.prevCamera.x) * alpha);
+    camera.y = snapshot.prevCamera.y + int((snapshot.camera.y - snapshot.prevCamera.y) * alpha);
+    snapshot.level->draw(*renderer, camera, size, snapshot.cameraVelocityX, snapshot.cameraVelocityY);
+    for (const ActorSnapshot& actor : snapshot.actors) {
+        if (actor.visible && actor.texture != nullptr) {
+            tripoint pos{
+                actor.prevPos.x + (actor.pos.x - actor.prevPos.x) * alpha,
+                actor.prevPos.y + (actor.pos.y - actor.prevPos.y) * alpha,
+                actor.prevPos.z + (actor.pos.z - actor.prevPos.z) * alpha
+            };
+            pixelpos drawPos;
+            getPixelPosFromRealPos(pos, drawPos);
+            actor.texture->draw(actor.spriteRect.x, actor.spriteRect.y, drawPos.x - camera.x, drawPos.y - camera.y, actor.spriteRect.w, actor.spriteRect.h);
+        }
     }
-  
-    SDL_Renderer *renderer = SDL_CreateRenderer( window, -1, SDL_RENDERER_ACCELERATED |
-                                        SDL_RENDERER_PRESENTVSYNC | SDL_RENDERER_TARGETTEXTURE );
-    if(renderer == nullptr)
-    {
-        SDL_DestroyWindow(window);
-        SDL_Log("Failed to create renderer: %s", SDL_GetError());
-        SDL_Quit();
-        return nullptr;
+    for (const ParticleBatchSnapshot& batch : snapshot.collectibles) {
+        drawParticleBatch(batch, alpha);
     }
-    if(!(IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG)) 
-    {
-        SDL_Log("Failed to initialize SDL_Image: %s", SDL_GetError());
-        SDL_DestroyRenderer(renderer);
-        SDL_DestroyWindow(window);
-        SDL_Quit();
-        return nullptr;
+    for (const ParticleBatchSnapshot& batch : snapshot.particles) {
+        drawParticleBatch(batch, alpha);
     }
 
-    std::vector<std::unique_ptr<Texture>> textures;
-    std::vector<std::unique_ptr<MapLayer>> renderLayers;
-    tmx::Map map;
-    if (!map.load("assets/robotropolis.tmj")) {
-        SDL_Log("Failed to load map: %s", SDL_GetError());
-        SDL_DestroyRenderer(renderer);
-        SDL_DestroyWindow(window);
-        return nullptr;
-    }
-    return new GameWindow(window, renderer, map, { 852, 480 });
-}
-
-void GameWindow::handle_input(const SDL_Event& event)
-{
-    if (playerActor != nullptr) {
-        playerActor->handle_input(event);
+    renderer->setDrawColor(255, 255, 255, 255);
+    for (const cuboid& debugCuboid : snapshot.debugCuboids) {
+        drawCuboid(*renderer, camera, debugCuboid.p1, debugCuboid.p2);
     }
+    
+    renderer->present();
 }
 
-void realPosToSdlPos(const tripoint &tp, SDL_Point &sp)
+// one draw call for the whole batch, two triangles per particle
+void GameWindow::drawParticleBatch(const ParticleBatchSnapshot& batch, float alpha)
 {
-    pixelpos pp;
-    getPixelPosFromRealPos(tp, pp);
-    sp.x = pp.x;
-    sp.y = pp.y;
+    if (batch.texture == nullptr || batch.pos.empty()) {
+        return;
+    }
+    const SDL_Point textureSize = batch.texture->getSize();
+    const float u1 = float(batch.source.x) / textureSize.x;
+    const float v1 = float(batch.source.y) / textureSize.y;
+    const float u2 = float(batch.source.x + batch.source.w) / textureSize.x;
+    const float v2 = float(batch.source.y + batch.source.h) / textureSize.y;
+    const float half = batch.size / 2.f;
+    particleVertices.resize(batch.pos.size() * 6);
+    SDL_Vertex* vertex = particleVertices.data();
+    for (size_t i = 0; i < batch.pos.size(); i++) {
+        const tripoint& prev = batch.prevPos[i];
+        const tripoint& cur = batch.pos[i];
+        pixelpos drawPos;
+        getPixelPosFromRealPos({ prev.x + (cur.x - prev.x) * alpha, prev.y + (cur.y - prev.y) * alpha, prev.z + (cur.z - prev.z) * alpha }, drawPos);
+        const float x1 = float(drawPos.x - camera.x) - half, y1 = float(drawPos.y - camera.y) - half;
+        const float x2 = x1 + batch.size, y2 = y1 + batch.size;
+        *vertex++ = { { x1, y1 }, batch.color, { u1, v1 } };
+        *vertex++ = { { x2, y1 }, batch.color, { u2, v1 } };
+        *vertex++ = { { x1, y2 }, batch.color, { u1, v2 } };
+        *vertex++ = { { x2, y1 }, batch.color, { u2, v1 } };
+        *vertex++ = { { x2, y2 }, batch.color, { u2, v2 } };
+        *vertex++ = { { x1, y2 }, batch.color, { u1, v2 } };
+    }
+    renderer->geometry(*batch.texture, particleVertices.data(), int(particleVertices.size()));
 }
 
-void drawLine(SDL_Renderer* renderer, const pixelpos& camera, const tripoint &p1, const tripoint &p2)
-{
-    pixelpos pp1, pp2;
-    getPixelPosFromRealPos(p1, pp1);
-    getPixelPosFromRealPos(p2, pp2);
-    SDL_RenderDrawLine(renderer, pp1.x - camera.x, pp1.y - camera.y, pp2.x - camera.x, pp2.y - camera.y);
-    
-}
 
-void drawRect(SDL_Renderer* renderer, const pixelpos& camera, const tripoint& p1, const tripoint& p2)
+void GameWindow::spawnStressEntities(size_t count)
 {
-    pixelpos pp1, pp2;
-    getPixelPosFromRealPos(p1, pp1);
-    getPixelPosFromRealPos(p2, pp2);
-    SDL_Rect rect{pp1.x - camera.x, pp1.y - camera.y, pp2.x - pp1.x, pp2.y - pp1.y};
-    SDL_RenderDrawRect(renderer, &rect);
+    // a fixed seed so every run simulates the same crowd
+    uint32_t seed = 12345;
+    auto next = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return seed >> 8;
+    };
+    const float speed = MAX_PLAYER_X_VELOCITY / 2;
+    const unsigned int columns = std::max(level->getTracedColumns(), 1u);
+    size_t spawned = 0;
+    for (size_t attempt = 0; spawned < count && attempt < count * 16; attempt++) {
+        const mappoint mt{ next() % columns, next() % level->getMapSize().y };
+        const tripoint pos = level->getTripointAtMapPoint(mt);
+        if (pos.z == -1.f) {
+            continue;
+        }
+        EntityStore::EntityId id = entities->add(pos, 0.f, -1.f, 0.f, DEFAULT_JUMP_TIME);
+        const float angle = float(next() % 360) * M_PI_F / 180.f;
+        entities->setIntent(id, { speed * std::cos(angle), 0.f, speed * std::sin(angle) });
+        stressIds.push_back(id);
+        spawned++;
+    }
+    SDL_Log("Spawned %zu stress entities", spawned);
 }
 
-void drawCuboid(SDL_Renderer* renderer, const pixelpos& camera, const tripoint &p1, const tripoint &p2)
+void GameWindow::steerStressEntities()
 {
-    // rectangle representing the rear side
-    drawRect(renderer, camera, p1, {p2.x, p2.y, p1.z});
-
-    // rectangle representing the front  side
-    drawRect(renderer, camera, {p1.x, p1.y, p2.z}, p2);
-
-    // lines connecting front side to rear side
-    drawLine(renderer, camera, {p1.x, p1.y, p1.z}, {p1.x, p1.y, p2.z});
-    drawLine(renderer, camera, {p2.x, p1.y, p1.z}, {p2.x, p1.y, p2.z});
-    drawLine(renderer, camera, {p1.x, p2.y, p1.z}, {p1.x, p2.y, p2.z});
-    drawLine(renderer, camera, {p2.x, p2.y, p1.z}, {p2.x, p2.y, p2.z});
+    const NavGraph* navGraph = level->getNavGraph();
+    if (navGraph == nullptr) {
+        return;
+    }
+    const NavGraph::NodeId goal = navGraph->findNode(entities->getPos(playerActor->getEntity()));
+    if (goal == NavGraph::InvalidNode) {
+        return;
+    }
+    // every StressRepathSteps-th entity from this step's offset, so each one re-paths once per StressRepathSteps steps
+    const size_t offset = size_t(step % StressRepathSteps);
+    const size_t count = stressIds.size() > offset ? (stressIds.size() - offset + StressRepathSteps - 1) / StressRepathSteps : 0;
+    const float speed = MAX_PLAYER_X_VELOCITY / 2;
+    jobs->parallelFor(count, 64, [&](size_t begin, size_t end) {
+        thread_local std::vector<NavGraph::NodeId> path;
+        for (size_t i = begin; i < end; i++) {
+            const EntityStore::EntityId id = stressIds[offset + i * StressRepathSteps];
+            if (!entities->isAwake(id)) {
+                continue;
+            }
+            const tripoint pos = entities->getPos(id);
+            const NavGraph::NodeId from = navGraph->findNode(pos);
+            if (from == NavGraph::InvalidNode || !navGraph->findPath(from, goal, true, path) || path.size() < 2) {
+                continue;
+            }
+            // head for the middle of the next face along the way
+            const NavGraph::Node& next = navGraph->getNode(path[1]);
+            const float dx = (next.x1 + next.x2) / 2 - pos.x;
+            const float dz = (next.z1 + next.z2) / 2 - pos.z;
+            const float length = std::sqrt(dx * dx + dz * dz);
+            if (length > 0.f) {
+                entities->setIntent(id, { speed * dx / length, 0.f, speed * dz / length });
+            }
+        }
+    });
 }
 
-void GameWindow::drawFrame()
+bool GameWindow::createParticleKinds()
 {
-    curTime = SDL_GetTicks64();
-    float frameDeltaTime = float(curTime - lastFrameTime) / 1000.f;
-    SDL_SetRenderDrawColor(renderer, 100, 149, 237, 255);
-    SDL_RenderClear(renderer);
-    camera.x = playerActor->getWindowPos().x - (size.x / 2);
-    camera.y = playerActor->getWindowPos().y - (size.y / 2);
-    for (const auto& l : renderLayers) {
-        l->draw(renderer, camera.x, camera.y);
-    }
-    if (playerActor != nullptr) {
-        playerActor->draw(frameDeltaTime, camera);
-    }
-    for (Actor* actor : actors) {
-        actor->draw(frameDeltaTime, camera);
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, 4, 4, 32, SDL_PIXELFORMAT_RGBA32);
+    if (surface == nullptr) {
+        SDL_Log("Can't create the particle texture: %s", SDL_GetError());
+        return false;
     }
-
-    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-    for(const auto &surface : surfaces) {
-        const tripoint &p1 = surface.dimensions.p1, &p2 = surface.dimensions.p2;
-        drawCuboid(renderer, camera, p1, p2);
+    SDL_FillRect(surface, nullptr, 0xffffffff);
+    particleTexture.reset(Texture::Create(*renderer, surface));
+    SDL_FreeSurface(surface);
+    if (particleTexture == nullptr) {
+        return false;
     }
-    const auto &pCyl = playerActor->getCollisionGeometry();
+    dustParticles = particles->addKind({ particleTexture, { 0, 0, 4, 4 }, { 200, 180, 140, 200 }, 3.f, true, 0.f, 0.3f });
+    sparkParticles = particles->addKind({ particleTexture, { 0, 0, 4, 4 }, { 255, 220, 80, 255 }, 2.f, true, 0.5f, 0.8f });
+    return true;
+}
 
-    drawCuboid(renderer, camera, {pCyl.x - pCyl.r, pCyl.y1, pCyl.z - pCyl.r}, {pCyl.x + pCyl.r, pCyl.y2, pCyl.z + pCyl.r});
-    
-    SDL_RenderPresent(renderer);
-    lastFrameTime = curTime;
+void GameWindow::respawnPlayer()
+{
+    entities->teleport(playerActor->getEntity(), level->getSpawnPos());
+    level->getCollectibles().reset();
+    playerGrounded = false;
 }
 
-const CollisionData GameWindow::check_collision(const cylinder& collisionCyl)
+void GameWindow::updateTriggers(bool withEvents)
 {
-    CollisionData collisions;
-    collisions.directions = CollisionType::NoCollision;
-    for (const auto& geometry : get_geometries()) {
-        int cTypeTmp = get_collision(geometry.dimensions, collisionCyl);
-        if (cTypeTmp != CollisionType::NoCollision) {
-            collisions.directions |= cTypeTmp;
-            collisions.collisions.push_back(CollisionData::CollisionItem{ cTypeTmp, geometry });
+    TriggerVolumes& triggers = level->getTriggers();
+    if (triggers.size() == 0) {
+        return;
+    }
+    triggerTracked.clear();
+    triggerTracked.push_back(playerActor->getEntity());
+    actors->forEach([this](const Actor& actor) {
+        if (entities->isAwake(actor.getEntity())) {
+            triggerTracked.push_back(actor.getEntity());
+        }
+    });
+    triggers.update(*entities, triggerTracked, withEvents ? &triggerEvents : nullptr);
+    if (!withEvents) {
+        return;
+    }
+    for (const TriggerEvent& event : triggerEvents) {
+        if (event.entity == playerActor->getEntity() && event.type != TriggerEventType::Stay) {
+            const TriggerVolumes::Trigger& trigger = triggers.getTrigger(event.trigger);
+            SDL_Log("Player %s %s trigger \"%s\"", event.type == TriggerEventType::Enter ? "entered" : "left", trigger.layer.c_str(),
+                trigger.name.c_str());
+            if (event.type == TriggerEventType::Enter && trigger.type == ActEndTrigger) {
+                pendingTransition = true;
+            }
         }
     }
-    return collisions;
 }
 
-const std::vector<SurfaceData> GameWindow::get_wall_geometries() const 
-{ 
-    std::vector<SurfaceData> output;
-    for (auto& surface : surfaces) {
-        if (surface.layer == TileLayerId::ForegroundWall || surface.layer == TileLayerId::BackgroundWall) {
-            output.push_back(surface);
-        }
-    }
-    return output;
+PoolHandle GameWindow::spawnActor(std::shared_ptr<const AnimationTable> animations, std::shared_ptr<Texture> texture, const mappoint& mt)
+{
+    return actors->create(*this, *entities, std::move(animations), std::move(texture), mt);
 }
 
-const std::vector<SurfaceData> GameWindow::get_ground_geometries() const
+void GameWindow::despawnActor(PoolHandle actor)
 {
-    std::vector<SurfaceData> output;
-    for (auto& surface : surfaces) {
-        if (surface.layer == TileLayerId::Ground) {
-            output.push_back(surface);
+    const Actor* despawned = actors->get(actor);
+    if (despawned != nullptr) {
+        level->getTriggers().forget(despawned->getEntity());
+        if (activation != nullptr) {
+            activation->forget(despawned->getEntity());
         }
     }
-    return output;
+    actors->destroy(actor);
 }
 
-const std::vector<SurfaceData> GameWindow::get_obstacle_geometries() const
+void GameWindow::logPoolStats() const
 {
-    std::vector<SurfaceData> output;
-    for (auto& surface : surfaces) {
-        if (surface.layer == TileLayerId::Obstacle) {
-            output.push_back(surface);
-        }
-    }
-    return output;
-}
\ No newline at end of file
+    const ObjectPool<Actor>::Stats actorStats = actors->getStats();
+    SDL_Log("Actor pool: %zu live, %zu peak, %zu slots in %zu blocks", actorStats.live, actorStats.peak, actorStats.capacity, actorStats.blocks);
+    SDL_Log("Entity store: %zu live, %zu awake, %zu ids, %zu slots reserved", entities->size(), entities->getAwakeCount(),
+        entities->getIdCapacity(), entities->posX.capacity());
+}
+
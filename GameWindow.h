@@ -2,11 +2,18 @@
 
 #include <vector>
 #include <memory>
+#include <array>
+#include <cstdint>
 #include <unordered_map>
 #include <tmxlite/Types.hpp>
 #include "Geometry.h"
 #include "TilesetConfig.h"
+#include "GameOptions.h"
+#include "ObjectPool.h"
 #include <functional>
+#include <string>
+#include <mutex>
+#include <SDL2/SDL_events.h>
 
 const float gravity_accel = 40.f;//9.8f; // 9.8 m/s^2
 
@@ -33,6 +40,16 @@ struct SurfaceData
     maprect mapRect;
 };
 
+/// @brief A tileset custom object found drawn in the map
+struct MapObject
+{
+    const CustomTileObject* object;
+    // its top left tile
+    mappoint mt;
+    // the object's bounds in the world, known once its columns have been traced
+    cuboid dimensions;
+};
+
 struct CollisionData
 {
     struct CollisionItem
@@ -46,50 +63,134 @@ struct CollisionData
 
 class GameWindow
 {
+    // camera the last frame was drawn with
     pixelpos camera;
-    mappoint z0pos;
-    std::unique_ptr<TilesetConfig> tilesetConfig;
-    std::vector<SurfaceData> surfaces;
-    float getZLevelAtPoint(const mappoint &mt, TileLayerId layer = TileLayerId::Any);
-    float getZLevelAtAdjacentPoint(const mappoint &mt, TileLayerId layer = TileLayerId::Any);
-    bool getNextSideGroundTile(mappoint& mt, const tmx::TileLayer& layer);
-    bool traceBoxTiles(const mappoint& mt, const tmx::TileLayer &layer, float currentZ, SurfaceData &surface);
-    bool traceGroundTiles(const mappoint& mt, const tmx::TileLayer &layer, float currentZ, SurfaceData &surface);
-    bool traceSideWallTiles(const mappoint& mt, const tmx::TileLayer &layer, float currentZ, SurfaceData &surface);
-    bool traceWallTiles(const mappoint& mt, const tmx::TileLayer &layer, float currentZ, SurfaceData &surface);
-    void parseLayerSurfaces(const char *layerName, TileLayerId layerId, std::function<bool (const tmx::TileLayer&, mappoint&, SurfaceData& surface)> parseFunc);
-    tmx::TileLayer *getLayerByName(const char *name);
-    TileType getTileType(const mappoint& mt, const tmx::TileLayer &layer);
-    struct SDL_Window *window;
-    struct SDL_Renderer *renderer;
-    std::vector<std::unique_ptr<class MapLayer>> renderLayers;
-    std::vector<std::unique_ptr<class Texture>> textures;
-    tmx::Map& map;
+    // camera as of the last two simulation steps
+    pixelpos simCamera;
+    pixelpos prevSimCamera;
+    uint64_t step;
+    // calls to update() so far, rewinding ones included; unlike step it never goes back, so input is logged by it
+    uint64_t updates;
+    // events received since the last simulation step, guarded by inputMutex
+    std::mutex inputMutex;
+    std::vector<SDL_Event> pendingInput;
+    std::vector<SDL_Event> stepInput;
+    // where the player's input goes as it's applied, if it's being recorded
+    class InputLog* inputRecorder;
+    std::unique_ptr<class Renderer> renderer;
+    std::unique_ptr<class TextureRegistry> textureRegistry;
+    // the act being played; render snapshots share it, so it outlives being swapped out until they're all drawn
+    std::shared_ptr<class Level> level;
+    // the acts, and the next one loading in the background
+    std::unique_ptr<class LevelManager> levels;
+    // the player reached the end of the act; it switches to the next one as soon as that's ready
+    bool pendingTransition;
+    // the next act is taken the same step the transition comes, waiting for it if it has to, so replays stay exact
+    bool deterministic;
+    bool lazyTracing;
     pixelpos size;
+    std::unique_ptr<class JobSystem> jobs;
+    // the last few seconds of world state, stepped back through while the rewind key is held
+    std::unique_ptr<class RewindBuffer> rewindBuffer;
+    std::vector<char> worldState;
+    bool rewinding;
+    // where F5 saves the world state and F8 loads it from
+    std::string savestatePath;
+    std::unique_ptr<class EntityStore> entities;
     std::unique_ptr<class PlayerActor> playerActor;
-    std::vector<class Actor*> actors;
-    uint64_t curTime;
-    uint64_t lastFrameTime;
-    const tmx::Vector2u& mapSize;
-    cuboid bounds;
-    GameWindow(SDL_Window *window, SDL_Renderer *renderer, tmx::Map& map, pixelpos size);
-    bool any_surface_intersects(TileLayerId surfaceType, const mappoint &mt);
+    // every actor besides the player; pooled, so actors coming and going at game rate don't touch the heap
+    std::unique_ptr<ObjectPool<class Actor>> actors;
+    // sleeps entities far from the view; nullptr when every entity stays awake
+    std::unique_ptr<class ActivationRegions> activation;
+    std::unique_ptr<class ParticleSystem> particles;
+    uint32_t dustParticles;
+    uint32_t sparkParticles;
+    size_t stressEntities;
+    size_t stressParticles;
+    // the stress entities in the order they were spawned, and whether they path-find to the player
+    std::vector<uint32_t> stressIds;
+    bool stressPathing;
+    // whether the player stood on something last step, to kick up dust when it lands
+    bool playerGrounded;
+    // built again every frame from the particle snapshot, kept to reuse its capacity
+    std::vector<struct SDL_Vertex> particleVertices;
+    std::shared_ptr<class Texture> particleTexture;
+    // items the player picked up this step
+    std::vector<uint32_t> pickedItems;
+    // the player and every awake actor, for checking against the triggers
+    std::vector<uint32_t> triggerTracked;
+    std::vector<struct TriggerEvent> triggerEvents;
+    GameWindow(std::unique_ptr<class Renderer> renderer, pixelpos size, const GameOptions& options);
+    // load the first act, its tilesets and the player through a startup task graph, logging how long each stage
+    // took, then start preloading the act after it
+    bool load(const GameOptions& options);
+    // swap in the next act between two steps, moving the player to its start and dropping the old act's actors
+    void switchLevel(std::shared_ptr<class Level> nextLevel);
+    // add wandering entities with no actor, sprite or input behind them, at ground points spread over the traced map
+    void spawnStressEntities(size_t count);
+    // point this step's share of the stress entities along their path to the player
+    void steerStressEntities();
+    // add the particle kinds, sharing one small white texture tinted per kind
+    bool createParticleKinds();
+    void drawParticleBatch(const struct ParticleBatchSnapshot& batch, float alpha);
+    // put the player back at the start with every collectible back in place
+    void respawnPlayer();
+    // check the player and awake actors against the triggers; without events, just catch up after a load
+    void updateTriggers(bool withEvents);
 public:
-    static GameWindow *Create();
+    // simulation steps between whole captures in the rewind buffer
+    static const unsigned int RewindKeyframeInterval = 60;
+    // simulation steps between one stress entity's path-finds; each step takes its share of them
+    static const unsigned int StressRepathSteps = 60;
+    // class of the triggers that end an act when the player walks into them
+    static constexpr const char* ActEndTrigger = "act_end";
+    // how far below the lowest traced surface the player can fall before starting over
+    static constexpr float FallOutDepth = 20.f;
+
+    static GameWindow *Create(const GameOptions& options);
     ~GameWindow();
 
-    struct SDL_Renderer *getRenderer() { return renderer;}
+    class Renderer& getRenderer() { return *renderer; }
+    class TextureRegistry& getTextureRegistry() { return *textureRegistry; }
     const pixelpos& GetSize() { return size; }
     tripoint getTripointAtMapPoint(const mappoint& mt);
 
-    void handle_input(const union SDL_Event& event);
-
-    const CollisionData check_collision(const cylinder& collisionCyl);
+    // queue an event for the next simulation step, safe to call from any thread
+    void handle_input(const SDL_Event& event);
+    // record every event the player gets from now on into recorder, tagged with its update; nullptr to stop
+    void setInputRecorder(class InputLog* recorder) { inputRecorder = recorder; }
 
-    const std::vector<SurfaceData> get_wall_geometries() const;
-    const std::vector<SurfaceData> get_ground_geometries() const;
-    const std::vector<SurfaceData> get_obstacle_geometries() const;
-    const std::vector<SurfaceData> get_geometries() const { return surfaces; }
-    const cuboid& getBounds() const { return bounds; }
-    void drawFrame();
+    // CollisionType flags for an entity's collision cylinder against the current act, see Level::collide
+    int collide(const cylinder& collisionCyl, float& groundY) const;
+    // the act being played: its surfaces, custom objects and navigation graph
+    const class Level& getLevel() const { return *level; }
+    // what the player and the awake actors did with the triggers in the latest step
+    const std::vector<struct TriggerEvent>& getTriggerEvents() const { return triggerEvents; }
+    bool isHeadless() const;
+    // add an actor standing at mt, driven by the simulation like the player but with no input of its own
+    PoolHandle spawnActor(std::shared_ptr<const class AnimationTable> animations, std::shared_ptr<class Texture> texture, const mappoint& mt);
+    // remove an actor; handles to it stay invalid even once its slot is reused
+    void despawnActor(PoolHandle actor);
+    // log how full the actor pool and the entity store are, and how far they've grown
+    void logPoolStats() const;
+    // advance the simulation by one fixed step
+    void update(float deltaTime);
+    // simulation steps run so far
+    uint64_t getStep() const { return step; }
+    // updates run so far, which only ever goes up, even while rewinding or after loading a state
+    uint64_t getUpdateCount() const { return updates; }
+    // hash of everything the simulation steps on from: every entity, the camera and the step count
+    uint64_t stateHash() const;
+    // capture everything the simulation steps on from, and put a capture back; the player keeps the keys held now
+    void saveState(std::vector<char>& out) const;
+    bool loadState(const char* data, size_t length);
+    // write the world state to a savestate file, or replace it with one
+    bool saveStateFile(const std::string& path);
+    bool loadStateFile(const std::string& path);
+    // go back to the world as it was a number of seconds ago, or as far back as the rewind buffer goes
+    bool retryFrom(float secondsAgo);
+    // capture what the renderer needs from the latest simulation step
+    void snapshot(struct RenderSnapshot& out) const;
+    // draw a snapshot, alpha (0-1) of the way from its previous simulation step to its latest one
+    void render(const struct RenderSnapshot& snapshot, float alpha);
 };
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include "InputLog.h"
+#include <SDL2/SDL_log.h>
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+
+const char InputLog::Magic[8] = { 'S', 'F', 'F', 'I', 'N', 'P', 'T', '\0' };
+
+namespace
+{
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t entryCount;
+    };
+}
+
+InputLog::InputLog() :
+    cursor(0)
+{
+}
+
+InputLog* InputLog::Load(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    FileHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        SDL_Log("Failed to read input log %s", path.c_str());
+        return nullptr;
+    }
+    if (memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version) {
+        SDL_Log("%s is not a version %u input log", path.c_str(), Version);
+        return nullptr;
+    }
+    InputLog* log = new InputLog();
+    log->entries.resize(header.entryCount);
+    if (!file.read(reinterpret_cast<char*>(log->entries.data()), std::streamsize(sizeof(Entry) * log->entries.size()))) {
+        SDL_Log("Input log %s is truncated", path.c_str());
+        delete log;
+        return nullptr;
+    }
+    return log;
+}
+
+bool InputLog::save(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    FileHeader header{};
+    memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.entryCount = uint32_t(entries.size());
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(entries.data()), std::streamsize(sizeof(Entry) * entries.size()));
+    if (!file.good()) {
+        SDL_Log("Failed to write input log %s", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+void InputLog::add(uint64_t step, const SDL_Event& event)
+{
+    switch (event.type) {
+    case SDL_KEYDOWN:
+        entries.push_back({ uint32_t(step), EventKind::KeyDown, int32_t(event.key.keysym.sym) });
+        break;
+    case SDL_KEYUP:
+        entries.push_back({ uint32_t(step), EventKind::KeyUp, int32_t(event.key.keysym.sym) });
+        break;
+    case SDL_WINDOWEVENT:
+        if (event.window.event == SDL_WINDOWEVENT_FOCUS_LOST) {
+            entries.push_back({ uint32_t(step), EventKind::FocusLost, 0 });
+        }
+        break;
+    }
+}
+
+uint64_t InputLog::lastStep() const
+{
+    // logs recorded before updates were counted apart from the world's step can go back and forth
+    uint64_t last = 0;
+    for (const Entry& entry : entries) {
+        last = std::max<uint64_t>(last, entry.step);
+    }
+    return last;
+}
+
+void InputLog::eventsForStep(uint64_t step, std::vector<SDL_Event>& out)
+{
+    for (; cursor < entries.size() && entries[cursor].step <= step; cursor++) {
+        const Entry& entry = entries[cursor];
+        if (entry.step < step) {
+            continue;
+        }
+        SDL_Event event{};
+        switch (entry.kind) {
+        case EventKind::KeyDown:
+        case EventKind::KeyUp:
+            event.type = entry.kind == EventKind::KeyDown ? SDL_KEYDOWN : SDL_KEYUP;
+            event.key.keysym.sym = SDL_Keycode(entry.key);
+            break;
+        case EventKind::FocusLost:
+            event.type = SDL_WINDOWEVENT;
+            event.window.event = SDL_WINDOWEVENT_FOCUS_LOST;
+            break;
+        }
+        out.push_back(event);
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <SDL2/SDL_events.h>
+
+/// @brief Player input tagged with the update it was applied at, so a run can be fed exactly the same input
+/// again. Updates are counted from the start of the run and, unlike the world's step, never go back when the
+/// player rewinds or loads a state, so the tags only ever increase. Only what the player actor reacts to is kept: key presses, releases and losing focus
+class InputLog
+{
+public:
+    static const uint32_t Version = 1;
+    static const char Magic[8];
+
+    enum class EventKind : uint32_t
+    {
+        KeyDown,
+        KeyUp,
+        FocusLost
+    };
+
+    struct Entry
+    {
+        // GameWindow::getUpdateCount() when the event was applied
+        uint32_t step;
+        EventKind kind;
+        int32_t key;
+    };
+
+private:
+    std::vector<Entry> entries;
+    // first entry replay hasn't handed out yet
+    size_t cursor;
+
+public:
+    InputLog();
+
+    static InputLog* Load(const std::string& path);
+    bool save(const std::string& path) const;
+
+    /// @brief Keep an event if it's one the player actor reacts to
+    void add(uint64_t step, const SDL_Event& event);
+
+    /// @brief Append the events recorded for an update to out; updates have to be asked for in increasing order
+    void eventsForStep(uint64_t step, std::vector<SDL_Event>& out);
+
+    size_t size() const { return entries.size(); }
+    /// @brief Latest update any event was recorded at, 0 if there are none
+    uint64_t lastStep() const;
+};
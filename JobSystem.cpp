@@ -0,0 +1,110 @@
+#include "JobSystem.h"
+#include <algorithm>
+
+JobSystem::JobSystem(unsigned int workerCount) :
+    queued(0),
+    stopping(false)
+{
+    for (unsigned int i = 0; i <= workerCount; i++) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned int i = 0; i < workerCount; i++) {
+        workers.emplace_back(&JobSystem::workerLoop, this, size_t(i));
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+bool JobSystem::take(size_t queueIndex, Job& job)
+{
+    {
+        Queue& own = *queues[queueIndex];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.jobs.empty()) {
+            job = own.jobs.back();
+            own.jobs.pop_back();
+            queued--;
+            return true;
+        }
+    }
+    for (size_t offset = 1; offset < queues.size(); offset++) {
+        Queue& victim = *queues[(queueIndex + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty()) {
+            job = victim.jobs.front();
+            victim.jobs.pop_front();
+            queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::run(const Job& job)
+{
+    (*job.work)(job.begin, job.end);
+    job.remaining->fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void JobSystem::workerLoop(size_t queueIndex)
+{
+    Job job;
+    while (true) {
+        if (take(queueIndex, job)) {
+            run(job);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this]() { return stopping || queued > 0; });
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+void JobSystem::parallelFor(size_t count, size_t grainSize, const std::function<void(size_t begin, size_t end)>& work)
+{
+    if (count == 0) {
+        return;
+    }
+    grainSize = std::max<size_t>(grainSize, 1);
+    if (workers.empty() || count <= grainSize) {
+        work(0, count);
+        return;
+    }
+
+    // deal the ranges out round-robin so every worker starts on its own queue and only steals once that's empty
+    const size_t jobCount = (count + grainSize - 1) / grainSize;
+    std::atomic<size_t> remaining(jobCount);
+    for (size_t i = 0; i < jobCount; i++) {
+        Queue& queue = *queues[i % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back({ &work, i * grainSize, std::min((i + 1) * grainSize, count), &remaining });
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        queued += jobCount;
+    }
+    wake.notify_all();
+
+    const size_t callerQueue = queues.size() - 1;
+    Job job;
+    while (remaining.load(std::memory_order_acquire) != 0) {
+        if (take(callerQueue, job)) {
+            run(job);
+        } else {
+            // the last few ranges are running elsewhere
+            std::this_thread::yield();
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// @brief A pool of worker threads for splitting per-step work across cores. Every worker has its own queue
+/// and takes from the back of it; a worker with nothing left steals from the front of the others'. The
+/// thread calling parallelFor works through the batch too, so it returns as soon as the batch is done
+class JobSystem
+{
+    struct Job
+    {
+        const std::function<void(size_t, size_t)>* work;
+        size_t begin;
+        size_t end;
+        std::atomic<size_t>* remaining;
+    };
+
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    // one per worker, plus a last one for whichever thread calls parallelFor
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    // jobs queued and not yet taken, guarded by sleepMutex for waking workers
+    std::atomic<size_t> queued;
+    std::atomic<bool> stopping;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+
+    bool take(size_t queueIndex, Job& job);
+    void run(const Job& job);
+    void workerLoop(size_t queueIndex);
+public:
+    /// @param workerCount threads besides the caller's, 0 to run everything on the calling thread
+    explicit JobSystem(unsigned int workerCount);
+    ~JobSystem();
+
+    /// @brief Threads that work on a batch, counting the caller
+    size_t getThreadCount() const { return workers.size() + 1; }
+
+    /// @brief Run work over [0, count) in ranges of at most grainSize, blocking until every range is done.
+    /// Ranges may run in any order on any thread, so work must only write state belonging to its own range
+    void parallelFor(size_t count, size_t grainSize, const std::function<void(size_t begin, size_t end)>& work);
+};
@@ -0,0 +1,244 @@
+#include "LayerTiles.h"
+#include <cJSON/cJSON.h>
+#include <SDL2/SDL_log.h>
+#include <tmxlite/Map.hpp>
+#include <zstd.h>
+#include <zlib.h>
+#include <cstring>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BASE64_SSE2 1
+#endif
+
+namespace
+{
+    // base64 digit of each character, -1 for everything that isn't one
+    struct Base64Table
+    {
+        int8_t values[256];
+
+        Base64Table()
+        {
+            memset(values, -1, sizeof(values));
+            const char* digits = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+            for (int i = 0; i < 64; i++) {
+                values[uint8_t(digits[i])] = int8_t(i);
+            }
+        }
+    };
+    const Base64Table base64Table;
+
+    // Tiled keeps the flip flags in the top bits of every gid, where tmxlite splits them off too
+    const uint32_t FlipMask = 0xf0000000;
+
+    bool inflateInto(const std::vector<uint8_t>& compressed, uint8_t* out, size_t size)
+    {
+        z_stream stream{};
+        // 32 on top of the window size lets zlib tell gzip and zlib headers apart by itself
+        if (inflateInit2(&stream, 15 + 32) != Z_OK) {
+            return false;
+        }
+        stream.next_in = const_cast<Bytef*>(compressed.data());
+        stream.avail_in = uInt(compressed.size());
+        stream.next_out = out;
+        stream.avail_out = uInt(size);
+        const int result = inflate(&stream, Z_FINISH);
+        const bool complete = result == Z_STREAM_END && stream.total_out == size;
+        inflateEnd(&stream);
+        return complete;
+    }
+}
+
+size_t LayerTiles::DecodedSize(const char* text, size_t length)
+{
+    for (int padding = 0; padding < 2 && length != 0 && text[length - 1] == '='; padding++) {
+        length--;
+    }
+    return length % 4 == 1 ? SIZE_MAX : length / 4 * 3 + (length % 4 != 0 ? length % 4 - 1 : 0);
+}
+
+bool LayerTiles::DecodeBase64(const char* text, size_t length, uint8_t* out)
+{
+    for (int padding = 0; padding < 2 && length != 0 && text[length - 1] == '='; padding++) {
+        length--;
+    }
+    size_t i = 0;
+#ifdef BASE64_SSE2
+    // map every range of digits at once by adding the offset for whichever range each character is in,
+    // then pack each lane's four 6 bit values into the three bytes they make
+    const __m128i upperOffset = _mm_set1_epi8(-'A'), lowerOffset = _mm_set1_epi8(26 - 'a'), digitOffset = _mm_set1_epi8(52 - '0');
+    const __m128i plusOffset = _mm_set1_epi8(62 - '+'), slashOffset = _mm_set1_epi8(63 - '/');
+    auto inRange = [](__m128i chars, char first, char last) {
+        return _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8(char(first - 1))), _mm_cmplt_epi8(chars, _mm_set1_epi8(char(last + 1))));
+    };
+    for (; i + 16 <= length; i += 16, out += 12) {
+        const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        const __m128i upper = inRange(chars, 'A', 'Z'), lower = inRange(chars, 'a', 'z'), digit = inRange(chars, '0', '9');
+        const __m128i plus = _mm_cmpeq_epi8(chars, _mm_set1_epi8('+')), slash = _mm_cmpeq_epi8(chars, _mm_set1_epi8('/'));
+        const __m128i valid = _mm_or_si128(_mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, plus)), slash);
+        if (_mm_movemask_epi8(valid) != 0xffff) {
+            return false;
+        }
+        __m128i offset = _mm_and_si128(upper, upperOffset);
+        offset = _mm_or_si128(offset, _mm_and_si128(lower, lowerOffset));
+        offset = _mm_or_si128(offset, _mm_and_si128(digit, digitOffset));
+        offset = _mm_or_si128(offset, _mm_and_si128(plus, plusOffset));
+        offset = _mm_or_si128(offset, _mm_and_si128(slash, slashOffset));
+        const __m128i values = _mm_add_epi8(chars, offset);
+
+        // each lane holds digits a b c d from its lowest byte up, which make the 24 bits abcd
+        __m128i bits = _mm_slli_epi32(_mm_and_si128(values, _mm_set1_epi32(0x3f)), 18);
+        bits = _mm_or_si128(bits, _mm_slli_epi32(_mm_and_si128(values, _mm_set1_epi32(0x3f00)), 4));
+        bits = _mm_or_si128(bits, _mm_srli_epi32(_mm_and_si128(values, _mm_set1_epi32(0x3f0000)), 10));
+        bits = _mm_or_si128(bits, _mm_srli_epi32(values, 24));
+        // the high byte of the 24 comes first in the output, so swap the outer two bytes of each lane
+        const __m128i swapped = _mm_or_si128(_mm_or_si128(_mm_srli_epi32(bits, 16), _mm_and_si128(bits, _mm_set1_epi32(0xff00))),
+            _mm_slli_epi32(_mm_and_si128(bits, _mm_set1_epi32(0xff)), 16));
+        uint32_t lanes[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), swapped);
+        for (int lane = 0; lane < 4; lane++) {
+            memcpy(out + lane * 3, &lanes[lane], 3);
+        }
+    }
+#endif
+    uint32_t bits = 0;
+    int bitCount = 0;
+    for (; i < length; i++) {
+        const int8_t value = base64Table.values[uint8_t(text[i])];
+        if (value < 0) {
+            return false;
+        }
+        bits = (bits << 6) | uint32_t(value);
+        bitCount += 6;
+        if (bitCount >= 8) {
+            bitCount -= 8;
+            *out++ = uint8_t(bits >> bitCount);
+        }
+    }
+    return true;
+}
+
+size_t LayerTiles::extract(std::string& mapJson)
+{
+    encoded.clear();
+    bound.clear();
+    // every encoded layer says so, and a map without any is best left unparsed: it's the slow kind to parse
+    if (mapJson.find("\"base64\"") == std::string::npos) {
+        return 0;
+    }
+    cJSON* json = cJSON_ParseWithLength(mapJson.data(), mapJson.size());
+    if (json == nullptr) {
+        // tmxlite gets to report what's wrong with it
+        return 0;
+    }
+    uint32_t layerIndex = 0;
+    const cJSON* layer = nullptr;
+    cJSON_ArrayForEach(layer, cJSON_GetObjectItemCaseSensitive(json, "layers")) {
+        const uint32_t index = layerIndex++;
+        const cJSON* type = cJSON_GetObjectItemCaseSensitive(layer, "type");
+        const cJSON* encoding = cJSON_GetObjectItemCaseSensitive(layer, "encoding");
+        const cJSON* data = cJSON_GetObjectItemCaseSensitive(layer, "data");
+        if (!cJSON_IsString(type) || strcmp(type->valuestring, "tilelayer") != 0 || !cJSON_IsString(encoding) ||
+            strcmp(encoding->valuestring, "base64") != 0 || !cJSON_IsString(data)) {
+            continue;
+        }
+        const cJSON* compressionJson = cJSON_GetObjectItemCaseSensitive(layer, "compression");
+        const char* compressionName = cJSON_IsString(compressionJson) ? compressionJson->valuestring : "";
+        Compression compression = Compression::None;
+        if (strcmp(compressionName, "zstd") == 0) {
+            compression = Compression::Zstd;
+        } else if (strcmp(compressionName, "gzip") == 0) {
+            compression = Compression::Gzip;
+        } else if (strcmp(compressionName, "zlib") == 0) {
+            compression = Compression::Zlib;
+        } else if (compressionName[0] != '\0') {
+            SDL_Log("Leaving layer with unknown compression %s to tmxlite", compressionName);
+            continue;
+        }
+        const cJSON* width = cJSON_GetObjectItemCaseSensitive(layer, "width");
+        const cJSON* height = cJSON_GetObjectItemCaseSensitive(layer, "height");
+        if (!cJSON_IsNumber(width) || !cJSON_IsNumber(height) || width->valueint <= 0 || height->valueint <= 0) {
+            continue;
+        }
+        const cJSON* name = cJSON_GetObjectItemCaseSensitive(layer, "name");
+        EncodedLayer& taken = encoded.emplace_back();
+        taken.name = cJSON_IsString(name) ? name->valuestring : "";
+        taken.layerIndex = index;
+        taken.compression = compression;
+        taken.tileCount = size_t(width->valueint) * size_t(height->valueint);
+        taken.data = data->valuestring;
+        cJSON* mutableLayer = const_cast<cJSON*>(layer);
+        cJSON_ReplaceItemInObjectCaseSensitive(mutableLayer, "data", cJSON_CreateArray());
+        cJSON_ReplaceItemInObjectCaseSensitive(mutableLayer, "encoding", cJSON_CreateString("csv"));
+        cJSON_DeleteItemFromObjectCaseSensitive(mutableLayer, "compression");
+    }
+    if (!encoded.empty()) {
+        char* printed = cJSON_PrintUnformatted(json);
+        if (printed == nullptr) {
+            encoded.clear();
+        } else {
+            mapJson = printed;
+            cJSON_free(printed);
+        }
+    }
+    cJSON_Delete(json);
+    return encoded.size();
+}
+
+bool LayerTiles::bind(const tmx::Map& map)
+{
+    bound.clear();
+    const auto& layers = map.getLayers();
+    for (const EncodedLayer& layer : encoded) {
+        if (layer.layerIndex >= layers.size() || layers[layer.layerIndex]->getType() != tmx::Layer::Type::Tile ||
+            layers[layer.layerIndex]->getName() != layer.name) {
+            SDL_Log("Encoded layer %s isn't where it was in the map", layer.name.c_str());
+            return false;
+        }
+        bound.push_back({ &layers[layer.layerIndex]->getLayerAs<tmx::TileLayer>(), &layer.tiles });
+    }
+    return true;
+}
+
+bool LayerTiles::decode(size_t index)
+{
+    EncodedLayer& layer = encoded[index];
+    const size_t decodedSize = DecodedSize(layer.data.data(), layer.data.size());
+    const size_t gidBytes = layer.tileCount * sizeof(uint32_t);
+
+    // the gids go into the back half of the tile array and are spread forward over it from the front, which
+    // never overwrites a gid before it's been read, so there's no buffer in between
+    static_assert(sizeof(tmx::TileLayer::Tile) == 2 * sizeof(uint32_t), "tiles have to be twice the size of a gid");
+    layer.tiles.resize(layer.tileCount);
+    uint8_t* gids = reinterpret_cast<uint8_t*>(layer.tiles.data()) + gidBytes;
+    bool decoded = false;
+    if (layer.compression == Compression::None) {
+        decoded = decodedSize == gidBytes && DecodeBase64(layer.data.data(), layer.data.size(), gids);
+    } else if (decodedSize != SIZE_MAX) {
+        std::vector<uint8_t> compressed(decodedSize);
+        if (DecodeBase64(layer.data.data(), layer.data.size(), compressed.data())) {
+            if (layer.compression == Compression::Zstd) {
+                const size_t size = ZSTD_decompress(gids, gidBytes, compressed.data(), compressed.size());
+                decoded = !ZSTD_isError(size) && size == gidBytes;
+            } else {
+                decoded = inflateInto(compressed, gids, gidBytes);
+            }
+        }
+    }
+    std::string().swap(layer.data);
+    if (!decoded) {
+        SDL_Log("Failed to decode layer %s", layer.name.c_str());
+        layer.tiles.clear();
+        return false;
+    }
+    for (size_t i = 0; i < layer.tileCount; i++) {
+        // gids are little-endian
+        const uint8_t* bytes = gids + i * sizeof(uint32_t);
+        const uint32_t gid = uint32_t(bytes[0]) | uint32_t(bytes[1]) << 8 | uint32_t(bytes[2]) << 16 | uint32_t(bytes[3]) << 24;
+        layer.tiles[i].ID = gid & ~FlipMask;
+        layer.tiles[i].flipFlags = uint8_t(gid >> 28);
+    }
+    return true;
+}
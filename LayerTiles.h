@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include <tmxlite/TileLayer.hpp>
+
+namespace tmx
+{
+    class Map;
+}
+
+/// @brief The tiles of a map's tile layers. Layers Tiled stored as plain arrays are read by tmxlite as usual;
+/// ones it stored as base64, raw or zstd, gzip or zlib compressed, have their data cut out of the map before
+/// tmxlite sees it, so the loading thread never tokenizes or decodes it, and are then decoded one task per
+/// layer straight into their tile arrays
+class LayerTiles
+{
+public:
+    using Tiles = std::vector<tmx::TileLayer::Tile>;
+
+    enum class Compression : uint8_t
+    {
+        None,
+        Zstd,
+        Gzip,
+        Zlib
+    };
+
+private:
+    struct EncodedLayer
+    {
+        std::string name;
+        // index among the map's top-level layers
+        uint32_t layerIndex;
+        Compression compression;
+        size_t tileCount;
+        std::string data;
+        Tiles tiles;
+    };
+
+    std::vector<EncodedLayer> encoded;
+    // the tmxlite layer each encoded layer stands in for, once bound
+    std::vector<std::pair<const tmx::TileLayer*, const Tiles*>> bound;
+
+public:
+    /// @brief Take the base64 data out of the map's top-level tile layers, leaving each an empty csv layer.
+    /// Maps without any are left alone, without being parsed. Layers in groups, infinite maps' chunks and
+    /// unknown compressions stay as they are for tmxlite. Returns how many layers were taken
+    size_t extract(std::string& mapJson);
+    /// @brief Match the taken layers up with the loaded map's. Doesn't need them decoded yet
+    bool bind(const tmx::Map& map);
+
+    size_t getEncodedCount() const { return encoded.size(); }
+    const std::string& getEncodedName(size_t index) const { return encoded[index].name; }
+    /// @brief Decode one taken layer, releasing its base64 text. Layers can be decoded in parallel
+    bool decode(size_t index);
+
+    /// @brief Tiles of a layer of the bound map, row by row
+    const Tiles& get(const tmx::TileLayer& layer) const
+    {
+        for (const auto& [tileLayer, tiles] : bound) {
+            if (tileLayer == &layer) {
+                return *tiles;
+            }
+        }
+        return layer.getTiles();
+    }
+
+    /// @brief Decode base64 into out, which must have room for DecodedSize(length) bytes. The bulk of it
+    /// goes 16 characters at a time with SSE2 where that's available. Returns false on anything that isn't base64
+    static bool DecodeBase64(const char* text, size_t length, uint8_t* out);
+    // bytes the base64 text decodes to, ignoring trailing padding; SIZE_MAX if no base64 text has that length
+    static size_t DecodedSize(const char* text, size_t length);
+};
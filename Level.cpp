@@ -0,0 +1,882 @@
+#include "Level.h"
+#include <SDL2/SDL.h>
+#include "MapLayer.h"
+#include "ChunkStreamer.h"
+#include "Renderer.h"
+#include "Texture.h"
+#include "Assets.h"
+#include "NavGraph.h"
+#include "Collectibles.h"
+#include "TriggerVolumes.h"
+#include "LayerTiles.h"
+#include <tmxlite/Map.hpp>
+#include <tmxlite/TileLayer.hpp>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+
+bool isSideWallTile(TileType tileType)
+{
+    switch (tileType)
+    {
+    case TileType::SideWall:
+    case TileType::SideWallAngled1:
+    case TileType::SideWallAngled2:
+    case TileType::SideWallAngled3:
+    case TileType::SideWallAngled4:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool isGroundTile(TileType tileType)
+{
+    switch (tileType)
+    {
+    case TileType::Ground:
+    case TileType::GroundAngled1:
+    case TileType::GroundAngled2:
+    case TileType::GroundAngled3:
+    case TileType::GroundAngled4:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool Level::any_surface_intersects(TileLayerId surfaceType, const mappoint& mt, size_t surfaceLimit) const
+{
+    for (size_t i = 0; i < std::min(surfaceLimit, surfaces.size()); i++) {
+        const SurfaceData& surface = surfaces[i];
+        if((surfaceType == TileLayerId::Any || surface.layer == surfaceType) && surface.mapRect.intersects(mt)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+tripoint Level::getTripointAtMapPoint(const mappoint& mt) const
+{
+    float zlevel = getZLevelAtAdjacentPoint(mt);
+    tripoint output{ -1.f, -1.f, -1.f };
+    if (zlevel != -1) {
+        getRealPosFromMapPos(mt, output, zlevel);
+    }
+    return output;
+}
+
+float Level::getZLevelAtAdjacentPoint(const mappoint& mt, TileLayerId layer, size_t surfaceLimit) const
+{
+    if (layer == TileLayerId::Ground || layer == TileLayerId::Any) {
+        for (const SurfaceData& groundSurface : surfaces) {
+            if (groundSurface.layer == TileLayerId::Ground && groundSurface.mapRect.intersects(mappoint{ mt.x, mt.y - 1 })) {
+                return groundSurface.dimensions.p1.z + (mt.y - groundSurface.mapRect.p1.y);
+            }
+        }
+    }
+    for (size_t i = 0; i < std::min(surfaceLimit, surfaces.size()); i++) {
+        const SurfaceData& surface = surfaces[i];
+        if (surface.layer != TileLayerId::Ground && (surface.layer == layer || layer == TileLayerId::Any)) {
+            if (surface.mapRect.intersects(mappoint{ mt.x, mt.y - 1 })) {
+                if (surface.dimensions.p2.z > (surface.dimensions.p1.z + 1)) {
+                    return (float(mt.x) - surface.mapRect.p1.x) * 2;
+                } else {
+                    return  surface.dimensions.p2.z;
+                }
+            } else if (surface.mapRect.intersects(mappoint{ mt.x + 1, mt.y })) {
+                //currentZ = surface.dimensions.p2.z - surface.dimensions.p1.z + 
+            } else if (surface.layer == TileLayerId::ForegroundWall && 
+                surface.mapRect.intersects(mappoint{ mt.x - 1, mt.y }) && 
+                surface.mapRect.p2.x == mt.x) {
+                return surface.dimensions.p2.z;
+            }
+        }
+    }
+    return -1;
+}
+
+float Level::getZLevelAtPoint(const mappoint &mt, TileLayerId layer, size_t surfaceLimit) const
+{
+    if (layer == TileLayerId::Ground || layer == TileLayerId::Any) {
+        for (const SurfaceData& groundSurface : surfaces) {
+            if (groundSurface.layer == TileLayerId::Ground && groundSurface.mapRect.intersects(mappoint{ mt.x, mt.y - 1 })) {
+                return groundSurface.dimensions.p1.z + (mt.y - groundSurface.mapRect.p1.y);
+            }
+        }
+    }
+    for (size_t i = 0; i < std::min(surfaceLimit, surfaces.size()); i++) {
+        const SurfaceData& surface = surfaces[i];
+        if (surface.layer != TileLayerId::Ground && (surface.layer == layer || layer == TileLayerId::Any)) {
+            if (surface.mapRect.intersects(mappoint{ mt.x, mt.y })) {
+                if (surface.dimensions.p2.z > (surface.dimensions.p1.z + 1)) {
+                    return (float(mt.x) - surface.mapRect.p1.x) * 2;
+                } else {
+                    return  surface.dimensions.p2.z;
+                }
+            } 
+        }
+    }
+    return -1;
+}
+
+void Level::parseLayerSurfaces(const char *layerName, TileLayerId layerId, mappoint& mt, unsigned int endColumn, std::function<bool (const tmx::TileLayer&, mappoint&, SurfaceData& surface)> parseFunc)
+{
+    auto layer = getLayerByName(layerName);
+    if(layer != nullptr) {
+        const auto& layerSize = layer->getSize();
+        // keep each layer's surfaces together and in column order, whichever order the regions get traced in
+        size_t layerSlot = size_t(layerId) - size_t(TileLayerId::BackgroundWall);
+        SurfaceData surfaceData;
+        surfaceData.layer = layerId;
+        for (; mt.x < endColumn && mt.x < layerSize.x; ++mt.x, mt.y = 0) {
+            for (; mt.y < layerSize.y; ++mt.y) {
+                if(parseFunc(*layer, mt, surfaceData)){
+                    insertSurface(layerSlot, surfaceData);
+                }
+            }
+        }
+    }
+}
+
+void Level::traceSurfaces(unsigned int endColumn)
+{
+    // the background pass carries its z-level from column to column and may skip past endColumn,
+    // so it resumes from its own cursor; the other passes only look at surfaces starting at or left of
+    // the current column, which makes tracing region by region give the same result as one full pass
+    tracedSurfaces.clear();
+    parseLayerSurfaces("Background", TileLayerId::BackgroundWall, backgroundCursor, endColumn, [this](const tmx::TileLayer &layer, mappoint &mt, SurfaceData &surface) {
+        TileType bgTileType = getTileType(mt, layer);
+        bool traceSuccess = false;
+        if(bgTileType == TileType::Wall) {
+            traceSuccess = traceWallTiles(mt, layer, backgroundZ, surface);
+        } else if(bgTileType == TileType::SideWallAngled1) {
+            traceSuccess = traceSideWallTiles(mt, layer, backgroundZ, surface);
+            backgroundZ = surface.dimensions.p2.z;
+        }
+        if(traceSuccess) {
+            mt.x = surface.mapRect.p2.x - 1;
+            mt.y = surface.mapRect.p2.y - 1;
+        }
+        return traceSuccess;
+    });
+    mappoint regionStart{ tracedColumns, 0 };
+    parseLayerSurfaces("walls", TileLayerId::ForegroundWall, regionStart, endColumn, [this](const tmx::TileLayer &layer, mappoint &mt, SurfaceData &surface) {
+        bool parseSuccess = false;
+        TileType bgTileType = getTileType(mt, layer);
+        if((bgTileType == TileType::Wall || bgTileType == TileType::SideWallAngled1) && !any_surface_intersects(TileLayerId::ForegroundWall, mt)) {
+            float zOffset = 0;
+            if(bgTileType == TileType::Wall) {
+                zOffset = getZLevelAtAdjacentPoint({ mt.x, mt.y }, TileLayerId::ForegroundWall);
+                if(zOffset == -1) {
+                    zOffset = getZLevelAtPoint({ mt.x, mt.y }, TileLayerId::BackgroundWall);
+                }
+                parseSuccess = traceWallTiles(mt, layer, zOffset, surface);
+            } else {
+                zOffset = getZLevelAtPoint({ mt.x - 1, mt.y }, TileLayerId::BackgroundWall);
+                parseSuccess = traceSideWallTiles(mt, layer, zOffset, surface);
+            }
+        }
+        return parseSuccess;
+    });
+    regionStart = { tracedColumns, 0 };
+    parseLayerSurfaces("Foreground", TileLayerId::Ground, regionStart, endColumn, [this](const tmx::TileLayer &layer, mappoint &mt, SurfaceData &surface) {
+        TileType fgTileType = getTileType(mt, layer);
+        if(isGroundTile(fgTileType) && !any_surface_intersects(TileLayerId::Ground, mt)) {
+            // obstacles from regions already traced mustn't change the ground's z-level
+            float currentZ = getZLevelAtAdjacentPoint(mt, TileLayerId::Any, layerSurfaceEnd[size_t(TileLayerId::Ground) - size_t(TileLayerId::BackgroundWall)]);
+            traceGroundTiles(mt, layer, currentZ, surface);
+            return true;
+        }
+        return false;
+    });
+    regionStart = { tracedColumns, 0 };
+    parseLayerSurfaces("collidables", TileLayerId::Obstacle, regionStart, endColumn, [this](const tmx::TileLayer &layer, mappoint &mt, SurfaceData &surface) {
+        TileType fgTileType = getTileType(mt, layer);
+        // custom objects from regions already traced are left out, as they aren't placed yet in a full trace
+        const size_t tileSurfaces = layerSurfaceEnd[size_t(TileLayerId::Obstacle) - size_t(TileLayerId::BackgroundWall)];
+        if(fgTileType == TileType::Box && !any_surface_intersects(TileLayerId::Obstacle, mt, tileSurfaces)) {
+            float currentZ = getZLevelAtPoint(mt, TileLayerId::Any, tileSurfaces);
+            traceBoxTiles(mt, layer, currentZ, surface);
+            return true;
+        }
+        return false;
+    });
+    placeMapObjects(endColumn);
+    tracedColumns = endColumn;
+    if (surfaces.empty()) {
+        return;
+    }
+    if (navGraph == nullptr) {
+        navGraph.reset(NavGraph::Build(tracedSurfaces));
+    } else {
+        navGraph->extend(tracedSurfaces);
+    }
+    z0pos = { surfaces[0].mapRect.p1.x, surfaces[0].mapRect.p1.y };
+    for(const auto &surface : tracedSurfaces) {
+        if(surface.dimensions.p1.x < bounds.p1.x) {
+            bounds.p1.x = surface.dimensions.p1.x;
+        }
+        if(surface.dimensions.p1.y < bounds.p1.y) {
+            bounds.p1.y = surface.dimensions.p1.y;
+        }
+        if(surface.dimensions.p1.z < bounds.p1.z) {
+            bounds.p1.z = surface.dimensions.p1.z;
+        }
+        if(surface.dimensions.p2.x > bounds.p2.x) {
+            bounds.p2.x = surface.dimensions.p2.x;
+        }
+        if(surface.dimensions.p2.y > bounds.p2.y) {
+            bounds.p2.y = surface.dimensions.p2.y;
+        }
+        if(surface.dimensions.p2.z > bounds.p2.z) {
+            bounds.p2.z = surface.dimensions.p2.z;
+        }
+    }
+}
+
+void Level::insertSurface(size_t layerSlot, const SurfaceData& surface)
+{
+    const size_t blockStart = layerSlot == 0 ? 0 : layerSurfaceEnd[layerSlot - 1];
+    const uint64_t order = uint64_t(layerSlot) << 32 | uint64_t(layerSurfaceEnd[layerSlot] - blockStart);
+    surfaces.insert(surfaces.begin() + layerSurfaceEnd[layerSlot], surface);
+    tracedSurfaces.push_back(surface);
+    for (size_t i = layerSlot; i < layerSurfaceEnd.size(); i++) {
+        layerSurfaceEnd[i]++;
+    }
+
+    // a cylinder only reaches surfaces within its radius (plus get_collision's slack) of its centre, so a
+    // surface goes in every bucket within a unit of it and a collision test reads only its centre's bucket
+    const float reach = 1.f;
+    const int first = int(std::floor((std::min(surface.dimensions.p1.x, surface.dimensions.p2.x) - reach) / SurfaceBucketWidth));
+    const int last = int(std::floor((std::max(surface.dimensions.p1.x, surface.dimensions.p2.x) + reach) / SurfaceBucketWidth));
+    if (surfaceBuckets.empty()) {
+        firstSurfaceBucket = first;
+    } else if (first < firstSurfaceBucket) {
+        surfaceBuckets.insert(surfaceBuckets.begin(), size_t(firstSurfaceBucket - first), {});
+        firstSurfaceBucket = first;
+    }
+    if (size_t(last - firstSurfaceBucket) >= surfaceBuckets.size()) {
+        surfaceBuckets.resize(size_t(last - firstSurfaceBucket) + 1);
+    }
+    for (int column = first; column <= last; column++) {
+        // the new surface is the last of its layer so far, so it goes before any of the later layers' surfaces
+        std::vector<BucketedSurface>& bucket = surfaceBuckets[size_t(column - firstSurfaceBucket)];
+        auto at = std::upper_bound(bucket.begin(), bucket.end(), order, [](uint64_t value, const BucketedSurface& item) {
+            return value < item.order;
+        });
+        bucket.insert(at, { order, surface.dimensions });
+    }
+}
+
+bool Level::ensureTraced(unsigned int column)
+{
+    // keep a region of margin beyond the requested column, rounded out to whole regions
+    unsigned int wanted = column + TraceRegionColumns;
+    wanted = std::min(((wanted + TraceRegionColumns - 1) / TraceRegionColumns) * TraceRegionColumns, mapSize.x);
+    if (wanted <= tracedColumns) {
+        return false;
+    }
+    traceSurfaces(wanted);
+    return true;
+}
+
+void Level::resetTrace()
+{
+    surfaces.clear();
+    layerSurfaceEnd = { 0, 0, 0, 0, 0 };
+    placedMapObjects = 0;
+    triggers->clearAdded();
+    tracedColumns = 0;
+    backgroundCursor = { 0, 0 };
+    backgroundZ = 0.f;
+    z0pos = { 0, 0 };
+    bounds = { {0.f, 0.f, 0.f}, {0.f, 0.f, 0.f} };
+    surfaceBuckets.clear();
+    navGraph.reset();
+    tracedSurfaces.clear();
+}
+
+bool Level::checkLazyTrace()
+{
+    resetTrace();
+    while (ensureTraced(tracedColumns)) {
+    }
+    const std::vector<SurfaceData> lazySurfaces = surfaces;
+    resetTrace();
+    traceSurfaces(mapSize.x);
+    bool matches = lazySurfaces.size() == surfaces.size();
+    if (!matches) {
+        SDL_Log("%s: tracing region by region gave %zu surfaces, a full trace %zu", mapPath.c_str(), lazySurfaces.size(), surfaces.size());
+    }
+    for (size_t i = 0; matches && i < surfaces.size(); i++) {
+        const SurfaceData& lazy = lazySurfaces[i];
+        const SurfaceData& full = surfaces[i];
+        matches = lazy.layer == full.layer &&
+            lazy.mapRect.p1.x == full.mapRect.p1.x && lazy.mapRect.p1.y == full.mapRect.p1.y &&
+            lazy.mapRect.p2.x == full.mapRect.p2.x && lazy.mapRect.p2.y == full.mapRect.p2.y &&
+            lazy.dimensions.p1.x == full.dimensions.p1.x && lazy.dimensions.p1.y == full.dimensions.p1.y &&
+            lazy.dimensions.p1.z == full.dimensions.p1.z && lazy.dimensions.p2.x == full.dimensions.p2.x &&
+            lazy.dimensions.p2.y == full.dimensions.p2.y && lazy.dimensions.p2.z == full.dimensions.p2.z;
+        if (!matches) {
+            SDL_Log("%s: surface %zu differs between tracing region by region and a full trace, at [%u,%u] and [%u,%u]",
+                mapPath.c_str(), i, lazy.mapRect.p1.x, lazy.mapRect.p1.y, full.mapRect.p1.x, full.mapRect.p1.y);
+        }
+    }
+    if (matches) {
+        SDL_Log("%s: %zu surfaces and %zu custom objects trace the same region by region as in one pass", mapPath.c_str(),
+            surfaces.size(), mapObjects.size());
+    }
+    resetTrace();
+    return matches;
+}
+
+Level::Level(std::string mapPath, const GameOptions& options, pixelpos viewSize) :
+    mapPath(std::move(mapPath)),
+    lazyTracing(options.lazyTracing),
+    checkTrace(options.checkTrace),
+    streamChunks(options.streamChunks),
+    chunkMemoryBudget(options.chunkMemoryBudget),
+    viewSize(viewSize),
+    z0pos{ 0, 0 },
+    placedMapObjects(0),
+    layerSurfaceEnd{ 0, 0, 0, 0, 0 },
+    firstSurfaceBucket(0),
+    tracedColumns(0),
+    backgroundCursor{ 0, 0 },
+    backgroundZ(0.f),
+    uploadedTilesets(0),
+    collectibles(std::make_unique<Collectibles>()),
+    triggers(std::make_unique<TriggerVolumes>()),
+    spawn{ 13, 11 },
+    spawnPos{ 0.f, 0.f, 0.f },
+    mapSize(0, 0),
+    bounds{ {0.f, 0.f, 0.f}, {0.f, 0.f, 0.f} }
+{
+}
+
+Level::~Level()
+{
+    // whatever got decoded but never uploaded
+    for (auto& image : tilesetImages) {
+        SDL_FreeSurface(image.surface);
+    }
+}
+
+void Level::addLoadTasks(TaskGraph& graph, TextureRegistry& registry, bool decodeImages, bool uploadNow,
+    std::function<void(TaskGraph::TaskId)> onTraced)
+{
+    TextureRegistry* uploadTo = &registry;
+    graph.add("parse map " + mapPath, [this, &graph, uploadTo, decodeImages, uploadNow, onTraced]() {
+        auto loadedMap = std::make_unique<tmx::Map>();
+        auto loadedTiles = std::make_unique<LayerTiles>();
+        std::string mapData;
+        if (!Assets::ReadFile(mapPath, mapData)) {
+            SDL_Log("Failed to load map: %s", mapPath.c_str());
+            return false;
+        }
+        // encoded layers are decoded by their own tasks below, so tmxlite never sees their data
+        loadedTiles->extract(mapData);
+        if (!loadedMap->loadFromString(mapData, std::filesystem::path(mapPath).parent_path().generic_string()) ||
+            !loadedTiles->bind(*loadedMap)) {
+            SDL_Log("Failed to load map: %s", mapPath.c_str());
+            return false;
+        }
+        map = std::move(loadedMap);
+        layerTiles = std::move(loadedTiles);
+        mapSize = map->getTileCount();
+        const auto& tileSets = map->getTilesets();
+        if (tileSets.empty()) {
+            SDL_Log("Map has no tilesets: %s", mapPath.c_str());
+            return false;
+        }
+        for (const tmx::Property& property : map->getProperties()) {
+            if (property.getName() == "spawn_x" && property.getType() == tmx::Property::Type::Int) {
+                spawn.x = unsigned(std::max(property.getIntValue(), 0));
+            } else if (property.getName() == "spawn_y" && property.getType() == tmx::Property::Type::Int) {
+                spawn.y = unsigned(std::max(property.getIntValue(), 0));
+            }
+        }
+
+        // size everything the follow-up tasks write into up front, so they never reallocate under each other
+        tilesetImages.resize(tileSets.size());
+        tilesetSizes.resize(tileSets.size(), SDL_Point{ 0, 0 });
+        textures.resize(tileSets.size());
+        const auto& mapLayers = map->getLayers();
+        std::vector<std::uint32_t> tileLayers;
+        for (auto i = 0u; i < mapLayers.size(); ++i) {
+            if (mapLayers[i]->getType() == tmx::Layer::Type::Tile) {
+                tileLayers.push_back(i);
+            }
+        }
+        if (!streamChunks) {
+            for (size_t i = 0; i < tileLayers.size(); i++) {
+                renderLayers.emplace_back(std::make_unique<MapLayer>());
+            }
+        }
+
+        // everything reading tiles waits for these
+        std::vector<TaskGraph::TaskId> layerDecodes;
+        for (size_t i = 0; i < layerTiles->getEncodedCount(); i++) {
+            layerDecodes.push_back(graph.add("decode layer " + layerTiles->getEncodedName(i), [this, i]() {
+                return layerTiles->decode(i);
+            }));
+        }
+
+        graph.add("load collectibles", [this]() {
+            collectibles->load(*map);
+            return true;
+        });
+        // custom objects placed while tracing add triggers of their own, after the map's
+        TaskGraph::TaskId loadTriggers = graph.add("load triggers", [this]() {
+            triggers->load(*map);
+            return true;
+        });
+        TaskGraph::TaskId parseTileset = graph.add("parse tileset config", [this]() {
+            tilesetConfig.reset(TilesetConfig::Create(std::string("assets/") + map->getTilesets()[0].getName() + ".json"));
+            return tilesetConfig != nullptr;
+        });
+        std::vector<TaskGraph::TaskId> findObjectsDependencies = layerDecodes;
+        findObjectsDependencies.push_back(parseTileset);
+        TaskGraph::TaskId findObjects = graph.add("find custom objects", [this]() {
+            findMapObjects();
+            return true;
+        }, findObjectsDependencies);
+        std::vector<TaskGraph::TaskId> tilesetDecodes;
+        std::vector<TaskGraph::TaskId> tilesetUploads;
+        for (size_t i = 0; i < tileSets.size(); i++) {
+            const std::string path = tileSets[i].getImagePath();
+            tilesetDecodes.push_back(graph.add("decode " + path, [this, decodeImages, i, path]() {
+                if (!TextureRegistry::Decode(path, decodeImages, tilesetImages[i])) {
+                    return false;
+                }
+                if (tilesetImages[i].surface != nullptr) {
+                    tilesetSizes[i] = { tilesetImages[i].surface->w, tilesetImages[i].surface->h };
+                }
+                return true;
+            }));
+            if (uploadNow) {
+                tilesetUploads.push_back(graph.add("upload " + path, [this, uploadTo, i]() {
+                    return upload(i, *uploadTo);
+                }, { tilesetDecodes.back() }, TaskGraph::Affinity::Main));
+            }
+        }
+
+        // vertex data only needs the tiles and the image sizes, which are known once decoded, except without
+        // a display where the size comes with the upload
+        std::vector<TaskGraph::TaskId> sizesKnown = decodeImages ? tilesetDecodes : tilesetUploads;
+        sizesKnown.insert(sizesKnown.end(), layerDecodes.begin(), layerDecodes.end());
+        std::vector<TaskGraph::TaskId> layerBuilds;
+        if (!streamChunks) {
+            for (size_t i = 0; i < tileLayers.size(); i++) {
+                std::uint32_t layerIndex = tileLayers[i];
+                layerBuilds.push_back(graph.add("build layer " + mapLayers[layerIndex]->getName(), [this, i, layerIndex]() {
+                    return renderLayers[i]->create(*map, *layerTiles, layerIndex, tilesetSizes, maprect{ { 0, 0 }, { mapSize.x, mapSize.y } });
+                }, sizesKnown));
+            }
+        }
+        if (uploadNow) {
+            std::vector<TaskGraph::TaskId> bindDependencies = tilesetUploads;
+            bindDependencies.insert(bindDependencies.end(), layerDecodes.begin(), layerDecodes.end());
+            bindDependencies.insert(bindDependencies.end(), layerBuilds.begin(), layerBuilds.end());
+            graph.add("bind layer textures", [this]() {
+                bindTextures();
+                return true;
+            }, bindDependencies);
+        }
+
+        TaskGraph::TaskId trace = graph.add("trace surfaces", [this]() {
+            if (checkTrace && !checkLazyTrace()) {
+                return false;
+            }
+            if (lazyTracing) {
+                // just the regions around the spawn point, the rest gets traced as the camera and actors approach
+                ensureTraced(spawn.x + unsigned(viewSize.x) / map->getTileSize().x);
+            } else {
+                traceSurfaces(mapSize.x);
+            }
+            spawnPos = getTripointAtMapPoint(spawn);
+            if (navGraph != nullptr) {
+                SDL_Log("Navigation graph: %zu faces, %zu links, %zu clusters", navGraph->getNodeCount(), navGraph->getLinkCount(),
+                    navGraph->getClusterCount());
+            }
+            return true;
+        }, { findObjects, loadTriggers });
+        if (onTraced) {
+            onTraced(trace);
+        }
+        return true;
+    });
+}
+
+bool Level::upload(size_t index, TextureRegistry& registry)
+{
+    const std::string path = map->getTilesets()[index].getImagePath();
+    textures[index] = registry.acquire(path, tilesetImages[index]);
+    SDL_FreeSurface(tilesetImages[index].surface);
+    tilesetImages[index].surface = nullptr;
+    if (textures[index] == nullptr) {
+        return false;
+    }
+    tilesetSizes[index] = textures[index]->getSize();
+    uploadedTilesets++;
+    return true;
+}
+
+bool Level::uploadNext(TextureRegistry& registry)
+{
+    if (!hasPendingUploads()) {
+        return true;
+    }
+    // a deferred load uploads in tileset order, and the layers have long been built by the time the last one's up
+    if (!upload(uploadedTilesets, registry)) {
+        return false;
+    }
+    if (!hasPendingUploads()) {
+        bindTextures();
+    }
+    return true;
+}
+
+void Level::bindTextures()
+{
+    if (streamChunks) {
+        chunkStreamer = std::make_unique<ChunkStreamer>(*map, *layerTiles, textures, chunkMemoryBudget);
+    }
+    for (const auto& layer : renderLayers) {
+        layer->bindTextures(textures);
+    }
+}
+
+void Level::draw(Renderer& renderer, const pixelpos& camera, const pixelpos& viewSize, float cameraVelocityX, float cameraVelocityY)
+{
+    if (chunkStreamer != nullptr) {
+        chunkStreamer->update(camera, viewSize, cameraVelocityX, cameraVelocityY);
+        chunkStreamer->draw(renderer, camera);
+    }
+    for (const auto& l : renderLayers) {
+        l->draw(renderer, camera.x, camera.y);
+    }
+}
+
+unsigned int Level::getTileWidth() const
+{
+    return map->getTileSize().x;
+}
+
+TileType Level::getTileType(const mappoint &mt, const tmx::TileLayer &layer)
+{
+    int tileId = getTilesetTileId(mt, layer);
+    if(tileId == -1) {
+        return TileType::None;
+    }
+    return tilesetConfig->getTileType(tileId);
+}
+
+int Level::getTilesetTileId(const mappoint& mt, const tmx::TileLayer& layer) const
+{
+    int tileId = layerTiles->get(layer)[mapSize.x * mt.y + mt.x].ID;
+    if(tileId == 0) {
+        return -1;
+    }
+    int fgid = map->getTilesets()[0].getFirstGID();
+    int lgid = map->getTilesets()[0].getLastGID();
+    if(tileId >= fgid && tileId <= lgid) {
+        tileId -= fgid;
+    }
+    return tileId;
+}
+
+void Level::findMapObjects()
+{
+    mapObjects.clear();
+    placedMapObjects = 0;
+    if (tilesetConfig->getObjectCount() == 0) {
+        return;
+    }
+    for (const auto& mapLayer : map->getLayers()) {
+        if (mapLayer->getType() != tmx::Layer::Type::Tile) {
+            continue;
+        }
+        const tmx::TileLayer& layer = mapLayer->getLayerAs<tmx::TileLayer>();
+        for (unsigned int y = 0; y < mapSize.y; y++) {
+            for (unsigned int x = 0; x < mapSize.x; x++) {
+                // only tiles some object starts with get compared any further
+                const std::vector<uint32_t>* candidates = tilesetConfig->getObjectCandidates(getTilesetTileId({ x, y }, layer));
+                if (candidates == nullptr) {
+                    continue;
+                }
+                for (uint32_t candidate : *candidates) {
+                    const CustomTileObject& object = tilesetConfig->getObject(candidate);
+                    bool matches = y + object.tileIds.size() <= mapSize.y;
+                    for (size_t row = 0; matches && row < object.tileIds.size(); row++) {
+                        matches = x + object.tileIds[row].size() <= mapSize.x;
+                        for (size_t column = 0; matches && column < object.tileIds[row].size(); column++) {
+                            matches = getTilesetTileId({ x + unsigned(column), y + unsigned(row) }, layer) == object.tileIds[row][column];
+                        }
+                    }
+                    if (matches) {
+                        mapObjects.push_back({ &object, { x, y }, object.bounds });
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    std::stable_sort(mapObjects.begin(), mapObjects.end(), [](const MapObject& a, const MapObject& b) { return a.mt.x < b.mt.x; });
+    SDL_Log("Found %zu custom objects in the map", mapObjects.size());
+}
+
+void Level::placeMapObjects(unsigned int endColumn)
+{
+    std::vector<TriggerVolumes::Trigger> objectTriggers;
+    for (; placedMapObjects < mapObjects.size() && mapObjects[placedMapObjects].mt.x < endColumn; placedMapObjects++) {
+        MapObject& mapObject = mapObjects[placedMapObjects];
+        // standing on whatever's traced below its top left tile, or at the back where there's nothing
+        tripoint origin = getTripointAtMapPoint(mapObject.mt);
+        if (origin.z == -1.f) {
+            getRealPosFromMapPos(mapObject.mt, origin, 0.f);
+        }
+        const cuboid& bounds = mapObject.object->bounds;
+        mapObject.dimensions = { { origin.x + bounds.p1.x, origin.y + bounds.p1.y, origin.z + bounds.p1.z },
+            { origin.x + bounds.p2.x, origin.y + bounds.p2.y, origin.z + bounds.p2.z } };
+        const maprect mapRect{ mapObject.mt, { mapObject.mt.x + unsigned(mapObject.object->tileIds[0].size()),
+            mapObject.mt.y + unsigned(mapObject.object->tileIds.size()) } };
+        if (mapObject.object->typeName == "obstacle") {
+            // after every obstacle tile, so the surfaces come out the same whether they're traced region by region or not
+            insertSurface(ObjectSurfaceSlot, { TileLayerId::Obstacle, mapObject.dimensions, mapRect });
+        } else {
+            // anything else is something to walk into: a trigger over the tiles it's drawn with, of the object's type
+            objectTriggers.push_back({ mapObject.object->objectName, TriggerVolumes::ObjectLayer, mapObject.object->typeName,
+                std::min(mapObject.dimensions.p1.z, mapObject.dimensions.p2.z), std::max(mapObject.dimensions.p1.z, mapObject.dimensions.p2.z),
+                float(mapRect.p1.x), float(mapRect.p1.y), float(mapRect.p2.x), float(mapRect.p2.y), 0, 0 });
+        }
+    }
+    triggers->addBoxes(objectTriggers);
+}
+
+tmx::TileLayer *Level::getLayerByName(const char *name)
+{
+    const auto& layers = map->getLayers();
+    for (auto i = 0u; i < layers.size(); ++i) {
+        if(layers[i]->getType() == tmx::TileLayer::Type::Tile) {
+            tmx::TileLayer &layer = layers[i]->getLayerAs<tmx::TileLayer>();
+            if(layer.getName() == name) {
+                return &layer;
+            }
+        }
+    }
+    return nullptr;
+}
+
+bool Level::getNextSideGroundTile(mappoint& mt, const tmx::TileLayer& layer)
+{
+    TileType tileTmp = getTileType(mt, layer);
+    if (tileTmp == TileType::GroundAngled2 || tileTmp == TileType::GroundAngled4) {
+        mt.x++;
+        mt.y++;
+        return true;
+    } else if (tileTmp == TileType::GroundAngled1 ||  tileTmp == TileType::GroundAngled3) {
+        mt.y++;
+        return true;
+    } else {
+        return false;
+    }
+}
+
+bool Level::traceBoxTiles(const mappoint& mt, const tmx::TileLayer &layer, float currentZ, SurfaceData &surface)
+{
+    TileType lastTileType = TileType::None;
+    TileType curTileType = getTileType(mt, layer);
+    TileType expectedTileType = TileType::None;
+    if(curTileType != TileType::Box) {
+        std::cout << "Bad map! Ground tiles organized in a way that tracer cannot trace the geometry! [" << mt.x << "," << mt.y << "]" << std::endl;
+        return false;
+    }
+    surface.mapRect.p1 = surface.mapRect.p2 = mt;
+    
+    while(surface.mapRect.p2.x < mapSize.x && getTileType(surface.mapRect.p2, layer) == TileType::Box) {
+        surface.mapRect.p2.x++;
+    }
+    surface.mapRect.p2.y++;
+    while (surface.mapRect.p2.y < mapSize.y &&
+        surface.mapRect.p2.x < mapSize.x &&
+    getTileType({surface.mapRect.p2.x - 1, surface.mapRect.p2.y - 1}, layer) == TileType::Box) {
+        surface.mapRect.p2.y++;
+    }
+    if(surface.mapRect.p2.y == mt.y) {
+        std::cout << "Bad map! Did not parse a single row of box tiles! [" << surface.mapRect.p2.x << "," << surface.mapRect.p2.y << "]" << std::endl;
+        return false;
+    }
+    getRealPosFromMapPos(surface.mapRect.p1, surface.dimensions.p1, currentZ);
+    getRealPosFromMapPos(surface.mapRect.p2, surface.dimensions.p2, currentZ + 1);
+    return true;
+}
+
+bool Level::traceGroundTiles(const mappoint& mt, const tmx::TileLayer &layer, float currentZ, SurfaceData &surface)
+{
+    surface.layer = TileLayerId::Ground;
+    TileType lastTileType = TileType::None;
+    TileType curTileType = getTileType(mt, layer);
+    TileType expectedTileType = TileType::None;
+    if(curTileType != TileType::GroundAngled1 && curTileType != TileType::GroundAngled2) {
+        std::cout << "Bad map! Ground tiles organized in a way that tracer cannot trace the geometry! [" << mt.x << "," << mt.y << "]" << std::endl;
+        return false;
+    }
+    surface.mapRect.p1 = surface.mapRect.p2 = mt;
+    
+    while(surface.mapRect.p2.x < mapSize.x && isGroundTile(getTileType(surface.mapRect.p2, layer))) {
+        surface.mapRect.p2.x++;
+    }
+    mappoint leftTile = mt;
+    mappoint rightTile{ surface.mapRect.p2.x - 1, surface.mapRect.p2.y };
+    while (rightTile.y < mapSize.y &&
+        rightTile.x < mapSize.x &&
+        getNextSideGroundTile(leftTile, layer) &&
+        getNextSideGroundTile(rightTile, layer));
+    surface.mapRect.p2 = rightTile;
+    if(surface.mapRect.p2.y == mt.y) {
+        std::cout << "Bad map! Did not parse a single row of ground tiles! [" << surface.mapRect.p2.x << "," << surface.mapRect.p2.y << "]" << std::endl;
+        return false;
+    }
+    if(getTileType({rightTile.x, rightTile.y - 1}, layer) == TileType::GroundAngled3) {
+        surface.mapRect.p2.x++;
+    }
+    getRealPosFromMapPos(surface.mapRect.p1, surface.dimensions.p1, currentZ);
+    getRealPosFromMapPos(surface.mapRect.p2, surface.dimensions.p2, currentZ + (surface.mapRect.p2.y - surface.mapRect.p1.y) );
+    return true;
+}
+
+bool Level::traceWallTiles(const mappoint& mt, const tmx::TileLayer &layer, float currentZ, SurfaceData &surface)
+{
+    TileType lastTileType = TileType::None;
+    TileType curTileType = getTileType(mt, layer);
+    TileType expectedTileType = TileType::None;
+    if(curTileType != TileType::Wall && curTileType != TileType::SideWallAngled1) {
+        std::cout << "Bad map! Wall tiles organized in a way that tracer cannot trace the geometry! [" << mt.x << "," << mt.y << "]" << std::endl;
+        return false;
+    }
+    surface.mapRect.p1 = surface.mapRect.p2 = mt;
+    while(surface.mapRect.p2.y < mapSize.y && getTileType(surface.mapRect.p2, layer) == TileType::Wall) {
+        surface.mapRect.p2.y++;
+    }
+    surface.mapRect.p2.x++;
+    while(surface.mapRect.p2.x < mapSize.x && 
+        getTileType({ surface.mapRect.p2.x, surface.mapRect.p1.y }, layer) == TileType::Wall &&
+        getTileType({ surface.mapRect.p2.x, surface.mapRect.p2.y - 1 }, layer) == TileType::Wall) {
+
+        surface.mapRect.p2.x++;
+    }
+    getRealPosFromMapPos(surface.mapRect.p1, surface.dimensions.p1, currentZ);
+    getRealPosFromMapPos(surface.mapRect.p2, surface.dimensions.p2, currentZ);
+    return true;
+}
+
+/// @brief Trace a 3D ground surface from the 2D map by looking at the geometry of the tiles as defined in JSON
+/// @param mt coordinate on the 2D map
+/// @param layer Current layer being considered
+/// @param currentZ derived Z-point in 3D space
+/// @param surface Surface data to be written, containing the 3D collision data from the detected surface
+bool Level::traceSideWallTiles(const mappoint& mt, const tmx::TileLayer &layer, float currentZ, SurfaceData &surface)
+{
+    TileType lastTileType = TileType::None;
+    TileType curTileType = getTileType(mt, layer);
+    TileType expectedTileType = TileType::None;
+    if(curTileType != TileType::SideWallAngled1 && curTileType != TileType::SideWallAngled2) {
+        std::cout << "Bad map! Side-wall tiles organized in a way that tracer cannot trace the geometry! [" << mt.x << "," << mt.y << "]" << std::endl;
+        return false;
+    }
+    surface.mapRect.p1 = surface.mapRect.p2 = mt;
+    while(surface.mapRect.p2.y < mapSize.y && isSideWallTile(getTileType(surface.mapRect.p2, layer))) {
+        surface.mapRect.p2.y++;
+    }
+    surface.mapRect.p2.y--;
+    int y2_start = surface.mapRect.p2.y;
+    TileType tileTmp = TileType::None, lastTile = TileType::None;
+    while(surface.mapRect.p2.x < layer.getSize().x && 
+        surface.mapRect.p2.y < layer.getSize().y) {
+        tileTmp = getTileType({ surface.mapRect.p2.x, surface.mapRect.p2.y }, layer);
+        if (tileTmp == TileType::SideWallAngled1 || tileTmp == TileType::SideWallAngled4) {
+            surface.mapRect.p2.x++;
+            surface.mapRect.p2.y++;
+        } else if(tileTmp == TileType::SideWallAngled2 || tileTmp == TileType::SideWallAngled3) {
+            surface.mapRect.p2.y++;
+        } else {
+            break;
+        }
+        lastTile = tileTmp;
+    }
+    if (surface.mapRect.p2.y == mt.y) {
+        std::cout << "Bad map! Did not parse a single column of side-wall tiles!" << std::endl;
+        return false;
+    } 
+    getRealPosFromMapPos(surface.mapRect.p1, surface.dimensions.p1, currentZ);
+    getRealPosFromMapPos(surface.mapRect.p2, surface.dimensions.p2, currentZ + (surface.mapRect.p2.y - y2_start) + 1);
+    return true;
+}
+
+const CollisionData Level::check_collision(const cylinder& collisionCyl) const
+{
+    CollisionData collisions;
+    collisions.directions = CollisionType::NoCollision;
+    for (const auto& geometry : get_geometries()) {
+        int cTypeTmp = get_collision(geometry.dimensions, collisionCyl);
+        if (cTypeTmp != CollisionType::NoCollision) {
+            collisions.directions |= cTypeTmp;
+            collisions.collisions.push_back(CollisionData::CollisionItem{ cTypeTmp, geometry });
+        }
+    }
+    return collisions;
+}
+
+int Level::collide(const cylinder& collisionCyl, float& groundY) const
+{
+    int directions = CollisionType::NoCollision;
+    const int bucket = int(std::floor(collisionCyl.x / SurfaceBucketWidth)) - firstSurfaceBucket;
+    if (bucket < 0 || size_t(bucket) >= surfaceBuckets.size()) {
+        return directions;
+    }
+    for (const BucketedSurface& surface : surfaceBuckets[size_t(bucket)]) {
+        int cTypeTmp = get_collision(surface.dimensions, collisionCyl);
+        // buckets keep surfaces order, so the first surface below is the same one check_collision would find first
+        if (cTypeTmp & Down && !(directions & Down)) {
+            groundY = surface.dimensions.p1.y;
+        }
+        directions |= cTypeTmp;
+    }
+    return directions;
+}
+
+const std::vector<SurfaceData> Level::get_wall_geometries() const 
+{ 
+    std::vector<SurfaceData> output;
+    for (auto& surface : surfaces) {
+        if (surface.layer == TileLayerId::ForegroundWall || surface.layer == TileLayerId::BackgroundWall) {
+            output.push_back(surface);
+        }
+    }
+    return output;
+}
+
+const std::vector<SurfaceData> Level::get_ground_geometries() const
+{
+    std::vector<SurfaceData> output;
+    for (auto& surface : surfaces) {
+        if (surface.layer == TileLayerId::Ground) {
+            output.push_back(surface);
+        }
+    }
+    return output;
+}
+
+const std::vector<SurfaceData> Level::get_obstacle_geometries() const
+{
+    std::vector<SurfaceData> output;
+    for (auto& surface : surfaces) {
+        if (surface.layer == TileLayerId::Obstacle) {
+            output.push_back(surface);
+        }
+    }
+    return output;
+}
\ No newline at end of file
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <SDL2/SDL_rect.h>
+#include <tmxlite/Types.hpp>
+#include "GameWindow.h"
+#include "TaskGraph.h"
+#include "TextureRegistry.h"
+
+/// @brief One act: its map and tilesets, the layers drawn from them, and the collision surfaces, custom
+/// objects, collectibles and triggers found in it. Everything here is built by a load graph and then only
+/// changes as more of the map gets traced, so a level can be loaded in the background while another one
+/// plays and swapped in whole
+class Level
+{
+    std::string mapPath;
+    bool lazyTracing;
+    // trace the whole map both region by region and in one pass while loading, and fail the load if they differ
+    bool checkTrace;
+    bool streamChunks;
+    size_t chunkMemoryBudget;
+    // the view the spawn region gets traced wide enough to fill
+    pixelpos viewSize;
+    mappoint z0pos;
+    std::unique_ptr<TilesetConfig> tilesetConfig;
+    std::vector<SurfaceData> surfaces;
+    // sorted by column; the first placedMapObjects have been placed in the world
+    std::vector<MapObject> mapObjects;
+    size_t placedMapObjects;
+    // end of each TileLayerId's block in surfaces, Background through Obstacle, then the custom objects' block
+    std::array<size_t, 5> layerSurfaceEnd;
+    static const size_t ObjectSurfaceSlot = 4;
+    // a surface as a collision bucket keeps it: where it sits in surfaces, as its layer slot in the high half
+    // and its place within that layer's block in the low half, and its extent
+    struct BucketedSurface
+    {
+        uint64_t order;
+        cuboid dimensions;
+    };
+    // surfaces bucketed by real x, each bucket holding the ones within reach of it in surfaces order;
+    // surfaceBuckets[0] is the bucket for column firstSurfaceBucket of SurfaceBucketWidth. Tracing only adds to
+    // the buckets the new surfaces reach
+    std::vector<std::vector<BucketedSurface>> surfaceBuckets;
+    int firstSurfaceBucket;
+    // add a surface at the end of its layer's block, and to the collision buckets
+    void insertSurface(size_t layerSlot, const SurfaceData& surface);
+    // where actors can walk, extended with the walkable faces among each newly traced region's surfaces
+    std::unique_ptr<class NavGraph> navGraph;
+    // the surfaces the latest traceSurfaces() added, in the order it found them
+    std::vector<SurfaceData> tracedSurfaces;
+    // columns [0, tracedColumns) have had all four passes traced
+    unsigned int tracedColumns;
+    mappoint backgroundCursor;
+    float backgroundZ;
+    float getZLevelAtPoint(const mappoint &mt, TileLayerId layer = TileLayerId::Any, size_t surfaceLimit = SIZE_MAX) const;
+    float getZLevelAtAdjacentPoint(const mappoint &mt, TileLayerId layer = TileLayerId::Any, size_t surfaceLimit = SIZE_MAX) const;
+    bool getNextSideGroundTile(mappoint& mt, const tmx::TileLayer& layer);
+    bool traceBoxTiles(const mappoint& mt, const tmx::TileLayer &layer, float currentZ, SurfaceData &surface);
+    bool traceGroundTiles(const mappoint& mt, const tmx::TileLayer &layer, float currentZ, SurfaceData &surface);
+    bool traceSideWallTiles(const mappoint& mt, const tmx::TileLayer &layer, float currentZ, SurfaceData &surface);
+    bool traceWallTiles(const mappoint& mt, const tmx::TileLayer &layer, float currentZ, SurfaceData &surface);
+    void parseLayerSurfaces(const char *layerName, TileLayerId layerId, mappoint& cursor, unsigned int endColumn, std::function<bool (const tmx::TileLayer&, mappoint&, SurfaceData& surface)> parseFunc);
+    void traceSurfaces(unsigned int endColumn);
+    // forget everything traced, so the map can be traced again from its first column
+    void resetTrace();
+    // trace the whole map region by region and then in one pass, and compare the surfaces the two give
+    bool checkLazyTrace();
+    tmx::TileLayer *getLayerByName(const char *name);
+    TileType getTileType(const mappoint& mt, const tmx::TileLayer &layer);
+    // the id of the tile at mt within the tileset, -1 if there's no tile there
+    int getTilesetTileId(const mappoint& mt, const tmx::TileLayer& layer) const;
+    // find every custom object drawn in the tile layers, in one pass over the map
+    void findMapObjects();
+    // work out where the objects whose top left tile is left of endColumn are in the world, and add the
+    // obstacles among them to the surfaces
+    void placeMapObjects(unsigned int endColumn);
+    bool any_surface_intersects(TileLayerId surfaceType, const mappoint &mt, size_t surfaceLimit = SIZE_MAX) const;
+    std::vector<std::unique_ptr<class MapLayer>> renderLayers;
+    // one per tileset, in the map's tileset order
+    std::vector<std::shared_ptr<class Texture>> textures;
+    // tilesets decoded but not uploaded yet, and the image sizes the layers are built with
+    std::vector<TextureRegistry::DecodedImage> tilesetImages;
+    std::vector<SDL_Point> tilesetSizes;
+    size_t uploadedTilesets;
+    std::unique_ptr<tmx::Map> map;
+    // where tile layers' tiles are read from, covering layers the map stores encoded
+    std::unique_ptr<class LayerTiles> layerTiles;
+    std::unique_ptr<class ChunkStreamer> chunkStreamer;
+    std::unique_ptr<class Collectibles> collectibles;
+    std::unique_ptr<class TriggerVolumes> triggers;
+    // the map point the player starts at, and where in the world that is once it's traced
+    mappoint spawn;
+    tripoint spawnPos;
+    tmx::Vector2u mapSize;
+    cuboid bounds;
+    bool upload(size_t index, TextureRegistry& registry);
+    // hand the textures to whatever draws the layers, once they're all uploaded
+    void bindTextures();
+public:
+    // width of a lazily traced map region, in tiles
+    static const unsigned int TraceRegionColumns = 32;
+    // width of a collision bucket, in real units
+    static constexpr float SurfaceBucketWidth = 4.f;
+
+    Level(std::string mapPath, const GameOptions& options, pixelpos viewSize);
+    ~Level();
+
+    /// @brief Add the tasks that load the level to a graph. The map is parsed first, and the tasks that
+    /// depend on what's in it get added once it's known how many tilesets and layers there are
+    /// @param decodeImages decode the tilesets' pixels; without them the image sizes come with the upload
+    /// @param uploadNow upload the tilesets from Main tasks of the graph; otherwise they need decodeImages and
+    /// are left decoded for uploadNext(), so the graph can run entirely off the renderer thread
+    /// @param onTraced called from inside the graph with the trace task, to add the tasks that need the level traced
+    void addLoadTasks(TaskGraph& graph, TextureRegistry& registry, bool decodeImages, bool uploadNow,
+        std::function<void(TaskGraph::TaskId)> onTraced);
+    /// @brief Upload the next tileset a deferred load left decoded. Must be called on the renderer thread
+    /// @return false if the upload failed
+    bool uploadNext(TextureRegistry& registry);
+    // the level can't be drawn until this is false
+    bool hasPendingUploads() const { return uploadedTilesets < tilesetImages.size(); }
+
+    /// @brief Trace the map up to a region beyond column, if it isn't yet
+    /// @return true if that added surfaces
+    bool ensureTraced(unsigned int column);
+    /// @brief Draw the tile layers, moving the chunk streamer along with the camera first
+    void draw(class Renderer& renderer, const pixelpos& camera, const pixelpos& viewSize, float cameraVelocityX, float cameraVelocityY);
+
+    tripoint getTripointAtMapPoint(const mappoint& mt) const;
+    const CollisionData check_collision(const cylinder& collisionCyl) const;
+    // CollisionType flags for an entity's collision cylinder, with groundY set to the top of the first surface
+    // below it; only looks at the surfaces near it and allocates nothing
+    int collide(const cylinder& collisionCyl, float& groundY) const;
+
+    const std::vector<SurfaceData> get_wall_geometries() const;
+    const std::vector<SurfaceData> get_ground_geometries() const;
+    const std::vector<SurfaceData> get_obstacle_geometries() const;
+    const std::vector<SurfaceData>& get_geometries() const { return surfaces; }
+    // the surfaces the latest ensureTraced() that traced anything added
+    const std::vector<SurfaceData>& getTracedSurfaces() const { return tracedSurfaces; }
+    const std::vector<MapObject>& getMapObjects() const { return mapObjects; }
+    const cuboid& getBounds() const { return bounds; }
+    // navigation over the surfaces traced so far; tracing adds to it, leaving the node ids it had valid
+    const class NavGraph* getNavGraph() const { return navGraph.get(); }
+    class Collectibles& getCollectibles() { return *collectibles; }
+    class TriggerVolumes& getTriggers() { return *triggers; }
+    const mappoint& getSpawn() const { return spawn; }
+    const tripoint& getSpawnPos() const { return spawnPos; }
+    const std::string& getMapPath() const { return mapPath; }
+    const tmx::Vector2u& getMapSize() const { return mapSize; }
+    unsigned int getTileWidth() const;
+    unsigned int getTracedColumns() const { return tracedColumns; }
+};
@@ -0,0 +1,149 @@
+#include "LevelManager.h"
+#include "Level.h"
+#include "TaskGraph.h"
+#include "TextureRegistry.h"
+#include <SDL2/SDL_log.h>
+#include <SDL2/SDL_timer.h>
+#include <iterator>
+
+LevelManager::LevelManager(std::vector<std::string> acts, const GameOptions& options, pixelpos viewSize, TextureRegistry& registry) :
+    acts(std::move(acts)),
+    options(options),
+    viewSize(viewSize),
+    registry(registry),
+    currentAct(0),
+    nextAct(0),
+    state(State::Idle),
+    freedLevels(false),
+    stopping(false)
+{
+    worker = std::thread(&LevelManager::workerLoop, this);
+}
+
+LevelManager::~LevelManager()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    worker.join();
+}
+
+void LevelManager::workerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this]() { return stopping || toLoad != nullptr || !toFree.empty(); });
+        if (stopping) {
+            return;
+        }
+        std::vector<std::shared_ptr<Level>> freeing;
+        freeing.swap(toFree);
+        std::shared_ptr<Level> level = std::move(toLoad);
+        lock.unlock();
+
+        if (!freeing.empty()) {
+            const uint64_t start = SDL_GetPerformanceCounter();
+            const size_t count = freeing.size();
+            freeing.clear();
+            SDL_Log("Freed %zu retired levels in %.2f ms", count, (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency());
+            freedLevels = true;
+        }
+        bool success = true;
+        if (level != nullptr) {
+            // pixels are always decoded, so the layers can be built before anything's uploaded
+            TaskGraph graph;
+            level->addLoadTasks(graph, registry, true, false, nullptr);
+            success = graph.run(PreloadWorkers);
+            graph.report(("Preload " + level->getMapPath()).c_str());
+            level.reset();
+        }
+
+        lock.lock();
+        if (state.load() == State::Loading && toLoad == nullptr) {
+            state = success ? State::Uploading : State::Failed;
+            loaded.notify_all();
+        }
+    }
+}
+
+void LevelManager::preload(size_t act)
+{
+    if (next != nullptr) {
+        // a level that failed to load, or was never taken
+        retire(std::move(next));
+    }
+    nextAct = act;
+    next = std::make_shared<Level>(acts[act], options, viewSize);
+    SDL_Log("Preloading act %zu: %s", act + 1, acts[act].c_str());
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        state = State::Loading;
+        toLoad = next;
+    }
+    wake.notify_one();
+}
+
+void LevelManager::pumpUploads()
+{
+    if (state.load() == State::Uploading) {
+        if (!next->uploadNext(registry)) {
+            SDL_Log("Failed to upload act %zu's tilesets", nextAct + 1);
+            state = State::Failed;
+        } else if (!next->hasPendingUploads()) {
+            state = State::Ready;
+        }
+    }
+    if (freedLevels.exchange(false)) {
+        // nothing holds the freed levels' textures but the registry now
+        registry.trim();
+    }
+}
+
+std::shared_ptr<Level> LevelManager::takeNext(bool finishNow)
+{
+    if (finishNow) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            loaded.wait(lock, [this]() { return state.load() != State::Loading; });
+        }
+        while (state.load() == State::Uploading) {
+            pumpUploads();
+        }
+    }
+    if (state.load() != State::Ready) {
+        return nullptr;
+    }
+    currentAct = nextAct;
+    state = State::Idle;
+    return std::move(next);
+}
+
+void LevelManager::retire(std::shared_ptr<Level> level)
+{
+    retired.push_back(std::move(level));
+}
+
+void LevelManager::collectRetired()
+{
+    // render snapshots are only ever copied on this thread, so once nothing but this holds a level it stays that way
+    std::vector<std::shared_ptr<Level>> unused;
+    for (size_t i = 0; i < retired.size();) {
+        if (retired[i].use_count() == 1) {
+            unused.push_back(std::move(retired[i]));
+            retired[i] = std::move(retired.back());
+            retired.pop_back();
+        } else {
+            i++;
+        }
+    }
+    if (unused.empty()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        toFree.insert(toFree.end(), std::make_move_iterator(unused.begin()), std::make_move_iterator(unused.end()));
+    }
+    wake.notify_one();
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "GameOptions.h"
+#include "Geometry.h"
+
+/// @brief The game's acts, in order, with the one after the current act loaded in the background while the
+/// current one plays. A preload runs the next level's whole load graph (parsing, decoding, layer building and
+/// tracing) on a thread of its own, leaving only the tileset uploads, which the renderer thread does one per
+/// frame. Once those are done the level is ready to be swapped in between two simulation steps, with nothing
+/// left to wait for. Levels swapped out are freed on the same thread, once no render snapshot refers to them.
+/// A game of a single act preloads nothing, as the next act would be a copy of the current one
+class LevelManager
+{
+public:
+    enum class State
+    {
+        // nothing preloaded or being preloaded
+        Idle,
+        // the load graph is running on the loading thread
+        Loading,
+        // loaded, with tilesets left for the renderer thread to upload
+        Uploading,
+        Ready,
+        Failed
+    };
+
+    // threads the loading thread runs a preload's graph on, besides itself; few, so the game keeps its cores
+    static const unsigned int PreloadWorkers = 2;
+
+private:
+    std::vector<std::string> acts;
+    GameOptions options;
+    pixelpos viewSize;
+    class TextureRegistry& registry;
+    size_t currentAct;
+    // the level being preloaded and its act; only touched by whichever thread state hands it to
+    std::shared_ptr<class Level> next;
+    size_t nextAct;
+    std::atomic<State> state;
+    // levels swapped out, kept until the last snapshot drawing them has been overwritten
+    std::vector<std::shared_ptr<class Level>> retired;
+    // set once a retired level has been freed, so the renderer thread releases its textures
+    std::atomic<bool> freedLevels;
+
+    // work for the loading thread, guarded by mutex
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable loaded;
+    std::shared_ptr<class Level> toLoad;
+    std::vector<std::shared_ptr<class Level>> toFree;
+    bool stopping;
+    std::thread worker;
+
+    void workerLoop();
+public:
+    LevelManager(std::vector<std::string> acts, const GameOptions& options, pixelpos viewSize, class TextureRegistry& registry);
+    ~LevelManager();
+
+    size_t getActCount() const { return acts.size(); }
+    size_t getCurrentAct() const { return currentAct; }
+    const std::string& getActPath(size_t act) const { return acts[act]; }
+    // the act after the current one; the last act leads back to the first
+    size_t getFollowingAct() const { return (currentAct + 1) % acts.size(); }
+    State getState() const { return state.load(); }
+
+    /// @brief Start loading an act in the background. Called from the simulation thread while nothing is being
+    /// preloaded, or after the last preload failed, which the game retries when the next transition is asked for
+    void preload(size_t act);
+    /// @brief Upload one of the preloaded level's tilesets, and release the textures of freed levels. Must be
+    /// called on the renderer thread, once a frame
+    void pumpUploads();
+    /// @brief Take the preloaded level once it's ready, making its act the current one. Called from the simulation thread
+    /// @param finishNow wait for the load and do the remaining uploads right here, which then has to be the renderer thread
+    /// @return nullptr while it isn't ready yet, or if it failed to load
+    std::shared_ptr<class Level> takeNext(bool finishNow);
+    /// @brief Hand over a level that's been swapped out. It's freed on the loading thread once collectRetired()
+    /// finds nothing else holds it anymore
+    void retire(std::shared_ptr<class Level> level);
+    // pass retired levels nothing else refers to anymore to the loading thread to be freed; called from the simulation thread
+    void collectRetired();
+};
@@ -26,11 +26,14 @@ source distribution.
 *********************************************************************/
 
 #include "MapLayer.h"
+#include "Renderer.h"
+#include "LayerTiles.h"
 
 #include <tmxlite/TileLayer.hpp>
 
 #include <iostream>
 #include <array>
+#include <algorithm>
 #include <cassert>
 #include <cJSON/cJSON.h>
 
@@ -38,7 +41,26 @@ MapLayer::MapLayer()
 {
 }
 
-bool MapLayer::create(const tmx::Map& map, std::uint32_t layerIndex, const std::vector<std::unique_ptr<Texture>>& textures)
+bool MapLayer::create(const tmx::Map& map, const LayerTiles& layerTiles, std::uint32_t layerIndex, const std::vector<std::shared_ptr<Texture>>& textures)
+{
+    const auto mapSize = map.getTileCount();
+    return create(map, layerTiles, layerIndex, textures, maprect{ { 0, 0 }, { mapSize.x, mapSize.y } });
+}
+
+bool MapLayer::create(const tmx::Map& map, const LayerTiles& layerTiles, std::uint32_t layerIndex, const std::vector<std::shared_ptr<Texture>>& textures, const maprect& tileRect)
+{
+    std::vector<SDL_Point> textureSizes;
+    for (const auto& texture : textures) {
+        textureSizes.push_back(texture->getSize());
+    }
+    if (!create(map, layerTiles, layerIndex, textureSizes, tileRect)) {
+        return false;
+    }
+    bindTextures(textures);
+    return true;
+}
+
+bool MapLayer::create(const tmx::Map& map, const LayerTiles& layerTiles, std::uint32_t layerIndex, const std::vector<SDL_Point>& textureSizes, const maprect& tileRect)
 {
     const auto& layers = map.getLayers();
     assert(layers[layerIndex]->getType() == tmx::Layer::Type::Tile);
@@ -61,19 +83,22 @@ bool MapLayer::create(const tmx::Map& map, std::uint32_t layerIndex, const std::
     {
         //check tile ID to see if it falls within the current tile set
         const auto& ts = tileSets[i];
-        const auto& tileIDs = layer.getTiles();
+        const auto& tileIDs = layerTiles.get(layer);
 
-        const auto texSize = textures[i]->getSize();
+        const auto texSize = textureSizes[i];
         const auto tileCountX = texSize.x / mapTileSize.x;
         const auto tileCountY = texSize.y / mapTileSize.y;
 
         const float uNorm = static_cast<float>(mapTileSize.x) / texSize.x;
         const float vNorm = static_cast<float>(mapTileSize.y) / texSize.y;
 
+        const auto endX = std::min(tileRect.p2.x, mapSize.x);
+        const auto endY = std::min(tileRect.p2.y, mapSize.y);
+
         std::vector<SDL_Vertex> verts;
-        for (auto y = 0u; y < mapSize.y; ++y)
+        for (auto y = tileRect.p1.y; y < endY; ++y)
         {
-            for (auto x = 0u; x < mapSize.x; ++x)
+            for (auto x = tileRect.p1.x; x < endX; ++x)
             {
                 const auto idx = y * mapSize.x + x;
                 if (idx < tileIDs.size() && tileIDs[idx].ID >= ts.getFirstGID()
@@ -87,8 +112,8 @@ bool MapLayer::create(const tmx::Map& map, std::uint32_t layerIndex, const std::
                     v *= mapTileSize.y;
 
                     //normalise the UV
-                    u /= textures[i]->getSize().x;
-                    v /= textures[i]->getSize().y;
+                    u /= texSize.x;
+                    v /= texSize.y;
 
                     //vert pos
                     const float tilePosX = static_cast<float>(x) * mapTileSize.x;
@@ -148,7 +173,7 @@ bool MapLayer::create(const tmx::Map& map, std::uint32_t layerIndex, const std::
         if (!verts.empty())
         {
             m_subsets.emplace_back();
-            m_subsets.back().texture = *textures[i];
+            m_subsets.back().tileset = i;
             m_subsets.back().vertexData.swap(verts);
         }
     }
@@ -156,14 +181,29 @@ bool MapLayer::create(const tmx::Map& map, std::uint32_t layerIndex, const std::
     return true;
 }
 
-void MapLayer::draw(SDL_Renderer* renderer, int cameraX, int cameraY) const
+void MapLayer::bindTextures(const std::vector<std::shared_ptr<Texture>>& textures)
+{
+    for (auto& subset : m_subsets) {
+        subset.texture = *textures[subset.tileset];
+    }
+}
+
+void MapLayer::draw(Renderer& renderer, int cameraX, int cameraY) const
 {
-    assert(renderer);
     for(const auto& subset : m_subsets) {
         std::vector<SDL_Vertex> vertsCpy;
         for(const auto& vertex: subset.vertexData) {
             vertsCpy.push_back({ {vertex.position.x - cameraX, vertex.position.y - cameraY}, vertex.color, vertex.tex_coord });
         }
-        SDL_RenderGeometry(renderer, subset.texture, vertsCpy.data(), static_cast<std::int32_t>(vertsCpy.size()), nullptr, 0);
+        renderer.geometry(subset.texture, vertsCpy.data(), static_cast<std::int32_t>(vertsCpy.size()));
+    }
+}
+
+std::size_t MapLayer::getMemoryUsage() const
+{
+    std::size_t bytes = 0;
+    for (const auto& subset : m_subsets) {
+        bytes += subset.vertexData.capacity() * sizeof(SDL_Vertex);
     }
+    return bytes;
 }
\ No newline at end of file
@@ -45,15 +45,25 @@ class MapLayer final
 public:
     explicit MapLayer();
 
-    bool create(const tmx::Map&, std::uint32_t index, const std::vector<std::unique_ptr<Texture>>& textures);
+    bool create(const tmx::Map&, const class LayerTiles&, std::uint32_t index, const std::vector<std::shared_ptr<Texture>>& textures);
+    // build only the tiles inside tileRect (p2 exclusive), used for streamed chunks
+    bool create(const tmx::Map&, const class LayerTiles&, std::uint32_t index, const std::vector<std::shared_ptr<Texture>>& textures, const maprect& tileRect);
+    // build the vertex data from just the tileset image sizes, so it can be done before the textures exist;
+    // bindTextures has to be called before drawing
+    bool create(const tmx::Map&, const class LayerTiles&, std::uint32_t index, const std::vector<SDL_Point>& textureSizes, const maprect& tileRect);
+    void bindTextures(const std::vector<std::shared_ptr<Texture>>& textures);
 
-    void draw(SDL_Renderer*, int cameraX, int cameraY) const;
+    void draw(class Renderer&, int cameraX, int cameraY) const;
+
+    // bytes of vertex data held by this layer
+    std::size_t getMemoryUsage() const;
 
 private:
     struct Subset final
     {
         std::vector<SDL_Vertex> vertexData;
         SDL_Texture* texture = nullptr;
+        std::size_t tileset = 0;
     };
     std::vector<Subset> m_subsets;
 };
\ No newline at end of file
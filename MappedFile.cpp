@@ -0,0 +1,104 @@
+#include "MappedFile.h"
+#include <SDL2/SDL_log.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() :
+    data(nullptr),
+    length(0)
+#ifdef _WIN32
+    , fileHandle(INVALID_HANDLE_VALUE),
+    mappingHandle(nullptr)
+#endif
+{
+}
+
+#ifdef _WIN32
+
+MappedFile* MappedFile::Open(const std::string& path)
+{
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return nullptr;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        SDL_Log("Failed to map %s: error %lu", path.c_str(), GetLastError());
+        CloseHandle(file);
+        return nullptr;
+    }
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr) {
+        SDL_Log("Failed to map %s: error %lu", path.c_str(), GetLastError());
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return nullptr;
+    }
+    MappedFile* mapped = new MappedFile();
+    mapped->data = static_cast<const uint8_t*>(view);
+    mapped->length = size_t(fileSize.QuadPart);
+    mapped->fileHandle = file;
+    mapped->mappingHandle = mapping;
+    return mapped;
+}
+
+MappedFile::~MappedFile()
+{
+    if (data != nullptr) {
+        UnmapViewOfFile(data);
+    }
+    if (mappingHandle != nullptr) {
+        CloseHandle(mappingHandle);
+    }
+    if (fileHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(fileHandle);
+    }
+}
+
+#else
+
+MappedFile* MappedFile::Open(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+        close(fd);
+        return nullptr;
+    }
+    void* view = mmap(nullptr, size_t(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping stays valid without the descriptor
+    close(fd);
+    if (view == MAP_FAILED) {
+        SDL_Log("Failed to map %s", path.c_str());
+        return nullptr;
+    }
+    MappedFile* mapped = new MappedFile();
+    mapped->data = static_cast<const uint8_t*>(view);
+    mapped->length = size_t(fileStat.st_size);
+    return mapped;
+}
+
+MappedFile::~MappedFile()
+{
+    if (data != nullptr) {
+        munmap(const_cast<uint8_t*>(data), length);
+    }
+}
+
+#endif
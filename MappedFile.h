@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/// @brief Read-only memory mapping of a whole file, so its contents can be used in place without reading them in
+class MappedFile
+{
+    const uint8_t* data;
+    size_t length;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#endif
+    MappedFile();
+public:
+    static MappedFile* Open(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator = (const MappedFile&) = delete;
+
+    const uint8_t* getData() const { return data; }
+    size_t getSize() const { return length; }
+};
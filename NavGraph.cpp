@@ -0,0 +1,321 @@
+#include "NavGraph.h"
+#include "GameWindow.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    float distance(const tripoint& a, const tripoint& b)
+    {
+        return std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) + (a.z - b.z) * (a.z - b.z));
+    }
+
+    // extra cost on top of the distance, so paths prefer walking to stepping, dropping and jumping
+    float linkPenalty(NavGraph::LinkType type)
+    {
+        switch (type) {
+        case NavGraph::LinkType::StepUp:
+            return 0.5f;
+        case NavGraph::LinkType::Drop:
+            return 1.f;
+        case NavGraph::LinkType::Jump:
+            return 2.f;
+        default:
+            return 0.f;
+        }
+    }
+
+    struct SearchScratch
+    {
+        std::vector<float> cost;
+        std::vector<uint32_t> parent;
+        // a vertex's cost and parent are only valid when seen matches the current search's stamp
+        std::vector<uint32_t> seen;
+        std::vector<uint32_t> closed;
+        std::vector<std::pair<float, uint32_t>> open;
+        uint32_t stamp = 0;
+    };
+}
+
+NavGraph::NavGraph() :
+    firstNodeBucket(0),
+    cache(PathCacheSlots)
+{
+}
+
+NavGraph* NavGraph::Build(const std::vector<SurfaceData>& surfaces)
+{
+    NavGraph* graph = new NavGraph();
+    graph->extend(surfaces);
+    return graph;
+}
+
+void NavGraph::extend(const std::vector<SurfaceData>& surfaces)
+{
+    const NodeId firstNew = NodeId(nodes.size());
+    for (const SurfaceData& surface : surfaces) {
+        if (surface.layer != TileLayerId::Ground && surface.layer != TileLayerId::Obstacle) {
+            continue;
+        }
+        const cuboid& d = surface.dimensions;
+        nodes.push_back({ std::min(d.p1.x, d.p2.x), std::min(d.p1.z, d.p2.z), std::max(d.p1.x, d.p2.x), std::max(d.p1.z, d.p2.z),
+            std::min(d.p1.y, d.p2.y), 0 });
+        Node& node = nodes.back();
+        const tripoint center{ (node.x1 + node.x2) / 2.f, node.top, (node.z1 + node.z2) / 2.f };
+        nodeGraph.centers.push_back(center);
+        nodeGraph.links.emplace_back();
+        node.cluster = clusterAt(center.x);
+        clusterSums[node.cluster].x += center.x;
+        clusterSums[node.cluster].y += center.y;
+        clusterSums[node.cluster].z += center.z;
+        clusterMembers[node.cluster]++;
+        fileNode(NodeId(nodes.size() - 1));
+        linkVisitor.push_back(InvalidNode);
+    }
+    if (firstNew == nodes.size()) {
+        return;
+    }
+
+    // each new face is compared with the faces in reach of it along x, old and new, once per pair
+    for (NodeId a = firstNew; a < nodes.size(); a++) {
+        size_t first, last;
+        if (!bucketRange(nodes[a].x1 - JumpDistance, nodes[a].x2 + JumpDistance, first, last)) {
+            continue;
+        }
+        linkVisitor[a] = a;
+        for (size_t bucket = first; bucket <= last; bucket++) {
+            for (NodeId b : nodeBuckets[bucket]) {
+                if (linkVisitor[b] == a || (b >= firstNew && b < a)) {
+                    continue;
+                }
+                linkVisitor[b] = a;
+                const Node& na = nodes[a];
+                const Node& nb = nodes[b];
+                const float gapX = std::max(0.f, std::max(nb.x1 - na.x2, na.x1 - nb.x2));
+                const float gapZ = std::max(0.f, std::max(na.z1, nb.z1) - std::min(na.z2, nb.z2));
+                const float gap = std::sqrt(gapX * gapX + gapZ * gapZ);
+                tryLink(a, b, gap);
+                tryLink(b, a, gap);
+            }
+        }
+    }
+
+    // the clusters that gained faces moved, so their links' costs are worked out again; there's a cluster per
+    // ClusterWidth of map, so this stays small however many faces there are
+    for (size_t c = 0; c < clusterGraph.size(); c++) {
+        clusterGraph.centers[c] = { clusterSums[c].x / float(clusterMembers[c]), clusterSums[c].y / float(clusterMembers[c]),
+            clusterSums[c].z / float(clusterMembers[c]) };
+    }
+    for (size_t c = 0; c < clusterGraph.size(); c++) {
+        for (Link& link : clusterGraph.links[c]) {
+            link.cost = distance(clusterGraph.centers[c], clusterGraph.centers[link.target]);
+        }
+    }
+
+    // paths found before might have a cheaper way through the new faces
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    for (CachedPath& cached : cache) {
+        cached.from = cached.to = InvalidNode;
+    }
+}
+
+uint32_t NavGraph::clusterAt(float x)
+{
+    const int column = int(std::floor(x / ClusterWidth));
+    auto it = clusterByColumn.find(column);
+    if (it != clusterByColumn.end()) {
+        return it->second;
+    }
+    const uint32_t cluster = uint32_t(clusterGraph.size());
+    clusterByColumn.emplace(column, cluster);
+    clusterGraph.centers.push_back({ 0.f, 0.f, 0.f });
+    clusterGraph.links.emplace_back();
+    clusterSums.push_back({ 0.f, 0.f, 0.f });
+    clusterMembers.push_back(0);
+    return cluster;
+}
+
+void NavGraph::fileNode(NodeId id)
+{
+    const int first = int(std::floor(nodes[id].x1 / NodeBucketWidth));
+    const int last = int(std::floor(nodes[id].x2 / NodeBucketWidth));
+    if (nodeBuckets.empty()) {
+        firstNodeBucket = first;
+    } else if (first < firstNodeBucket) {
+        // only when a face turns up left of everything traced so far
+        nodeBuckets.insert(nodeBuckets.begin(), size_t(firstNodeBucket - first), {});
+        firstNodeBucket = first;
+    }
+    if (size_t(last - firstNodeBucket) >= nodeBuckets.size()) {
+        nodeBuckets.resize(size_t(last - firstNodeBucket) + 1);
+    }
+    for (int column = first; column <= last; column++) {
+        nodeBuckets[size_t(column - firstNodeBucket)].push_back(id);
+    }
+}
+
+bool NavGraph::bucketRange(float x1, float x2, size_t& first, size_t& last) const
+{
+    const int from = std::max(int(std::floor(x1 / NodeBucketWidth)), firstNodeBucket);
+    const int to = std::min(int(std::floor(x2 / NodeBucketWidth)), firstNodeBucket + int(nodeBuckets.size()) - 1);
+    if (from > to) {
+        return false;
+    }
+    first = size_t(from - firstNodeBucket);
+    last = size_t(to - firstNodeBucket);
+    return true;
+}
+
+void NavGraph::tryLink(NodeId from, NodeId to, float gap)
+{
+    // y grows downwards, so a positive rise is a climb
+    const float rise = nodes[from].top - nodes[to].top;
+    LinkType type;
+    if (gap <= WalkGap) {
+        if (std::abs(rise) <= StepHeight) {
+            type = rise > 0.f ? LinkType::StepUp : LinkType::Walk;
+        } else if (rise < 0.f) {
+            type = LinkType::Drop;
+        } else if (rise <= JumpHeight) {
+            type = LinkType::Jump;
+        } else {
+            return;
+        }
+    } else if (gap <= JumpDistance && rise <= JumpHeight) {
+        type = LinkType::Jump;
+    } else {
+        return;
+    }
+    const float cost = distance(nodeGraph.centers[from], nodeGraph.centers[to]) + linkPenalty(type);
+    nodeGraph.links[from].push_back({ to, cost, type });
+    nodeGraph.linkCount++;
+    // clusters are linked wherever any of their faces are
+    const uint32_t a = nodes[from].cluster;
+    const uint32_t b = nodes[to].cluster;
+    if (a != b) {
+        std::vector<Link>& clusterLinks = clusterGraph.links[a];
+        if (std::none_of(clusterLinks.begin(), clusterLinks.end(), [b](const Link& link) { return link.target == b; })) {
+            clusterLinks.push_back({ b, 0.f, LinkType::Walk });
+            clusterGraph.linkCount++;
+        }
+    }
+}
+
+NavGraph::NodeId NavGraph::findNode(const tripoint& pos) const
+{
+    // the highest face at or below the point, allowing for standing a little into it
+    NodeId best = InvalidNode;
+    size_t bucket, last;
+    if (!bucketRange(pos.x, pos.x, bucket, last)) {
+        return best;
+    }
+    for (NodeId i : nodeBuckets[bucket]) {
+        const Node& node = nodes[i];
+        if (pos.x >= node.x1 && pos.x <= node.x2 && pos.z >= node.z1 && pos.z <= node.z2 && node.top >= pos.y - StepHeight &&
+            (best == InvalidNode || node.top < nodes[best].top)) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+bool NavGraph::search(const Adjacency& graph, uint32_t from, uint32_t to, const std::vector<uint8_t>* allowedClusters, std::vector<uint32_t>& path) const
+{
+    thread_local SearchScratch scratch;
+    if (scratch.seen.size() < graph.size()) {
+        scratch.cost.resize(graph.size());
+        scratch.parent.resize(graph.size());
+        scratch.seen.resize(graph.size(), 0);
+        scratch.closed.resize(graph.size(), 0);
+    }
+    if (++scratch.stamp == 0) {
+        std::fill(scratch.seen.begin(), scratch.seen.end(), 0);
+        std::fill(scratch.closed.begin(), scratch.closed.end(), 0);
+        scratch.stamp = 1;
+    }
+    const uint32_t stamp = scratch.stamp;
+    const tripoint& goal = graph.centers[to];
+    auto byCost = [](const std::pair<float, uint32_t>& a, const std::pair<float, uint32_t>& b) { return a.first > b.first; };
+
+    scratch.open.clear();
+    scratch.cost[from] = 0.f;
+    scratch.parent[from] = from;
+    scratch.seen[from] = stamp;
+    scratch.open.push_back({ distance(graph.centers[from], goal), from });
+    while (!scratch.open.empty()) {
+        std::pop_heap(scratch.open.begin(), scratch.open.end(), byCost);
+        const uint32_t current = scratch.open.back().second;
+        scratch.open.pop_back();
+        if (scratch.closed[current] == stamp) {
+            continue;
+        }
+        scratch.closed[current] = stamp;
+        if (current == to) {
+            path.clear();
+            for (uint32_t v = to; v != from; v = scratch.parent[v]) {
+                path.push_back(v);
+            }
+            path.push_back(from);
+            std::reverse(path.begin(), path.end());
+            return true;
+        }
+        for (const Link& link : graph.links[current]) {
+            if (allowedClusters != nullptr && !(*allowedClusters)[nodes[link.target].cluster]) {
+                continue;
+            }
+            const float cost = scratch.cost[current] + link.cost;
+            if (scratch.seen[link.target] != stamp || cost < scratch.cost[link.target]) {
+                scratch.seen[link.target] = stamp;
+                scratch.cost[link.target] = cost;
+                scratch.parent[link.target] = current;
+                scratch.open.push_back({ cost + distance(graph.centers[link.target], goal), link.target });
+                std::push_heap(scratch.open.begin(), scratch.open.end(), byCost);
+            }
+        }
+    }
+    path.clear();
+    return false;
+}
+
+bool NavGraph::findPath(NodeId from, NodeId to, bool hierarchical, std::vector<NodeId>& path) const
+{
+    path.clear();
+    if (from >= nodes.size() || to >= nodes.size()) {
+        return false;
+    }
+    const size_t slot = ((uint64_t(from) * 0x9e3779b1u) ^ (uint64_t(to) * 0x85ebca6bu) ^ (hierarchical ? 1u : 0u)) % PathCacheSlots;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        const CachedPath& cached = cache[slot];
+        if (cached.from == from && cached.to == to && cached.hierarchical == hierarchical) {
+            path.assign(cached.nodes.begin(), cached.nodes.end());
+            return cached.found;
+        }
+    }
+
+    bool found = false;
+    if (hierarchical && nodes[from].cluster != nodes[to].cluster) {
+        thread_local std::vector<uint32_t> clusterPath;
+        thread_local std::vector<uint8_t> allowed;
+        if (search(clusterGraph, nodes[from].cluster, nodes[to].cluster, nullptr, clusterPath)) {
+            allowed.assign(clusterGraph.size(), 0);
+            for (uint32_t cluster : clusterPath) {
+                allowed[cluster] = 1;
+            }
+            found = search(nodeGraph, from, to, &allowed, path);
+        }
+    }
+    // a corridor of clusters can still be a dead end for the faces in it
+    if (!found) {
+        found = search(nodeGraph, from, to, nullptr, path);
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    CachedPath& cached = cache[slot];
+    cached.from = from;
+    cached.to = to;
+    cached.hierarchical = hierarchical;
+    cached.found = found;
+    cached.nodes.assign(path.begin(), path.end());
+    return found;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "Geometry.h"
+
+struct SurfaceData;
+
+/// @brief Where actors can get to across the level. Every walkable top face (ground and the tops of
+/// obstacles) is a node; links join faces an actor can walk, step, drop or jump between. Nodes are also
+/// grouped into clusters along x, with a coarser graph over the clusters that long queries can search
+/// first to narrow down which nodes the detailed search looks at. As more of the map is traced the new faces
+/// are added to the graph and linked to the ones around them, leaving the rest of it as it is.
+///
+/// Queries are safe from any number of threads at once. Each thread keeps its own search scratch and
+/// finished paths go in a cache shared by every thread, so steady-state re-pathing allocates nothing
+class NavGraph
+{
+public:
+    typedef uint32_t NodeId;
+    static constexpr NodeId InvalidNode = UINT32_MAX;
+
+    enum class LinkType : uint8_t
+    {
+        Walk,
+        StepUp,
+        Drop,
+        Jump
+    };
+
+    struct Node
+    {
+        // the face's extent in x and z, and its height (smaller y is higher up)
+        float x1, z1, x2, z2;
+        float top;
+        uint32_t cluster;
+    };
+
+    struct Link
+    {
+        NodeId target;
+        float cost;
+        LinkType type;
+    };
+
+    // how high an actor can step without jumping, how high it can jump, and how far across a gap
+    static constexpr float StepHeight = 0.5f;
+    static constexpr float JumpHeight = 5.f;
+    static constexpr float JumpDistance = 4.f;
+    // faces closer than this count as touching
+    static constexpr float WalkGap = 0.1f;
+    // width of a cluster, in real units
+    static constexpr float ClusterWidth = 32.f;
+    // width of the buckets nodes are found through, in real units
+    static constexpr float NodeBucketWidth = 4.f;
+    static const size_t PathCacheSlots = 4096;
+
+private:
+    // a graph as adjacency lists, links[i] leaving vertex i; tracing more of the map only ever adds to it
+    struct Adjacency
+    {
+        std::vector<std::vector<Link>> links;
+        std::vector<tripoint> centers;
+        size_t linkCount = 0;
+
+        size_t size() const { return centers.size(); }
+    };
+
+    struct CachedPath
+    {
+        NodeId from = InvalidNode;
+        NodeId to = InvalidNode;
+        bool hierarchical = false;
+        bool found = false;
+        std::vector<NodeId> nodes;
+    };
+
+    std::vector<Node> nodes;
+    Adjacency nodeGraph;
+    Adjacency clusterGraph;
+    // clusters by column of ClusterWidth along x, and the sum of their nodes' centres for placing them at the average
+    std::unordered_map<int, uint32_t> clusterByColumn;
+    std::vector<tripoint> clusterSums;
+    std::vector<uint32_t> clusterMembers;
+    // nodes by column of NodeBucketWidth along x, in every column they span; nodeBuckets[0] is column firstNodeBucket
+    std::vector<std::vector<NodeId>> nodeBuckets;
+    int firstNodeBucket;
+    // the node that last looked at each node for links, so one found through several buckets is only linked once
+    std::vector<NodeId> linkVisitor;
+
+    mutable std::mutex cacheMutex;
+    mutable std::vector<CachedPath> cache;
+
+    NavGraph();
+    uint32_t clusterAt(float x);
+    void fileNode(NodeId id);
+    // the range of nodeBuckets covering [x1, x2], false if none of them do
+    bool bucketRange(float x1, float x2, size_t& first, size_t& last) const;
+    void tryLink(NodeId from, NodeId to, float gap);
+    // A* over one of the graphs; allowedClusters, when given, limits a node search to the clusters marked in it
+    bool search(const Adjacency& graph, uint32_t from, uint32_t to, const std::vector<uint8_t>* allowedClusters, std::vector<uint32_t>& path) const;
+public:
+    /// @brief Build the graph over the walkable faces among the traced surfaces
+    static NavGraph* Build(const std::vector<SurfaceData>& surfaces);
+    /// @brief Add the walkable faces among newly traced surfaces, linked to each other and to the faces already
+    /// there. Node ids stay as they are, and cached paths are dropped. Not to be called while queries run
+    void extend(const std::vector<SurfaceData>& surfaces);
+
+    size_t getNodeCount() const { return nodes.size(); }
+    size_t getLinkCount() const { return nodeGraph.linkCount; }
+    size_t getClusterCount() const { return clusterGraph.size(); }
+    const Node& getNode(NodeId id) const { return nodes[id]; }
+
+    /// @brief The face a point is standing on or just above, InvalidNode if there's none below it. Only looks
+    /// at the faces in the point's bucket
+    NodeId findNode(const tripoint& pos) const;
+
+    /// @brief Find the cheapest way between two faces, from's id first and to's last
+    /// @param hierarchical search the cluster graph first and only look at the nodes along the way; much faster
+    /// across long distances, though not always the very cheapest path
+    /// @param path replaced with the path, reusing its capacity
+    bool findPath(NodeId from, NodeId to, bool hierarchical, std::vector<NodeId>& path) const;
+};
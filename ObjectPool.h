@@ -0,0 +1,144 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+/// @brief Generational handle to an object in an ObjectPool. A handle to an object that has been destroyed
+/// stays invalid even after its slot is reused
+struct PoolHandle
+{
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0;
+
+    bool operator==(const PoolHandle& other) const { return index == other.index && generation == other.generation; }
+};
+
+/// @brief Fixed-address storage for objects of one type that come and go at game rate. Slots are allocated
+/// a block at a time and never move; destroyed slots go on a free list and are handed out again first, so
+/// once the pool has grown to its peak population creating and destroying objects never touches the heap
+template <typename T, size_t BlockSize = 256>
+class ObjectPool
+{
+    struct Slot
+    {
+        alignas(T) unsigned char storage[sizeof(T)];
+        uint32_t generation = 0;
+        uint32_t nextFree = UINT32_MAX;
+        bool alive = false;
+
+        T* object() { return std::launder(reinterpret_cast<T*>(storage)); }
+        const T* object() const { return std::launder(reinterpret_cast<const T*>(storage)); }
+    };
+
+    std::vector<std::unique_ptr<Slot[]>> blocks;
+    uint32_t firstFree;
+    size_t live;
+    size_t peak;
+
+    Slot& slot(uint32_t index) { return blocks[index / BlockSize][index % BlockSize]; }
+    const Slot& slot(uint32_t index) const { return blocks[index / BlockSize][index % BlockSize]; }
+
+public:
+    struct Stats
+    {
+        size_t live;
+        size_t peak;
+        size_t capacity;
+        size_t blocks;
+    };
+
+    ObjectPool() : firstFree(UINT32_MAX), live(0), peak(0) {}
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+    ~ObjectPool() { clear(); }
+
+    template <typename... Args>
+    PoolHandle create(Args&&... args)
+    {
+        if (firstFree == UINT32_MAX) {
+            // thread the new block's slots onto the free list, lowest index first
+            const uint32_t base = uint32_t(blocks.size() * BlockSize);
+            blocks.push_back(std::make_unique<Slot[]>(BlockSize));
+            for (uint32_t i = BlockSize; i-- > 0;) {
+                blocks.back()[i].nextFree = firstFree;
+                firstFree = base + i;
+            }
+        }
+        const uint32_t index = firstFree;
+        Slot& s = slot(index);
+        new (s.storage) T(std::forward<Args>(args)...);
+        firstFree = s.nextFree;
+        s.alive = true;
+        live++;
+        peak = std::max(peak, live);
+        return { index, s.generation };
+    }
+
+    void destroy(PoolHandle handle)
+    {
+        if (get(handle) == nullptr) {
+            return;
+        }
+        Slot& s = slot(handle.index);
+        s.object()->~T();
+        s.alive = false;
+        s.generation++;
+        s.nextFree = firstFree;
+        firstFree = handle.index;
+        live--;
+    }
+
+    /// @brief The object a handle refers to, nullptr if it has been destroyed
+    T* get(PoolHandle handle)
+    {
+        if (handle.index >= blocks.size() * BlockSize) {
+            return nullptr;
+        }
+        Slot& s = slot(handle.index);
+        return s.alive && s.generation == handle.generation ? s.object() : nullptr;
+    }
+
+    const T* get(PoolHandle handle) const { return const_cast<ObjectPool*>(this)->get(handle); }
+
+    /// @brief Call f with every live object, in slot order
+    template <typename F>
+    void forEach(F&& f)
+    {
+        for (uint32_t index = 0; index < blocks.size() * BlockSize; index++) {
+            Slot& s = slot(index);
+            if (s.alive) {
+                f(*s.object());
+            }
+        }
+    }
+
+    template <typename F>
+    void forEach(F&& f) const
+    {
+        for (uint32_t index = 0; index < blocks.size() * BlockSize; index++) {
+            const Slot& s = slot(index);
+            if (s.alive) {
+                f(*s.object());
+            }
+        }
+    }
+
+    /// @brief Destroy every object, keeping the blocks for reuse
+    void clear()
+    {
+        for (uint32_t index = 0; index < blocks.size() * BlockSize; index++) {
+            Slot& s = slot(index);
+            if (s.alive) {
+                destroy({ index, s.generation });
+            }
+        }
+    }
+
+    size_t size() const { return live; }
+    Stats getStats() const { return { live, peak, blocks.size() * BlockSize, blocks.size() }; }
+};
@@ -0,0 +1,260 @@
+#include "ParticleSystem.h"
+#include "GameWindow.h"
+#include "JobSystem.h"
+#include "RenderSnapshot.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PARTICLES_SSE2 1
+#endif
+
+ParticleSystem::ParticleSystem() :
+    groundFirstColumn(0),
+    groundFirstRow(0),
+    groundColumns(0),
+    groundRows(0),
+    seed(12345)
+{
+}
+
+float ParticleSystem::random()
+{
+    // the same LCG the stress entities use; good enough for where dust flies
+    seed = seed * 1664525u + 1013904223u;
+    return float(seed >> 8) / float(1u << 24);
+}
+
+ParticleSystem::KindId ParticleSystem::addKind(const ParticleKind& kind)
+{
+    batches.push_back({});
+    batches.back().kind = kind;
+    return KindId(batches.size() - 1);
+}
+
+void ParticleSystem::emit(KindId kind, const tripoint& pos, const MoveVector& velocity, float life)
+{
+    Batch& batch = batches[kind];
+    if (batch.size() >= MaxParticlesPerKind) {
+        return;
+    }
+    batch.posX.push_back(pos.x);
+    batch.posY.push_back(pos.y);
+    batch.posZ.push_back(pos.z);
+    batch.prevX.push_back(pos.x);
+    batch.prevY.push_back(pos.y);
+    batch.prevZ.push_back(pos.z);
+    batch.velX.push_back(velocity.x);
+    batch.velY.push_back(velocity.y);
+    batch.velZ.push_back(velocity.z);
+    batch.life.push_back(life);
+}
+
+void ParticleSystem::burst(KindId kind, const tripoint& pos, size_t count, float speed, float life)
+{
+    for (size_t i = 0; i < count; i++) {
+        const float angle = random() * 2.f * M_PI_F;
+        const float outward = random() * speed;
+        // some variety in how long each one lasts, so a burst thins out instead of vanishing at once
+        emit(kind, pos, { outward * std::cos(angle), random() * speed, outward * std::sin(angle) }, life * (0.5f + 0.5f * random()));
+    }
+}
+
+void ParticleSystem::setGround(const std::vector<SurfaceData>& surfaces)
+{
+    groundTop.clear();
+    groundColumns = groundRows = 0;
+    addGround(surfaces);
+}
+
+void ParticleSystem::addGround(const std::vector<SurfaceData>& surfaces)
+{
+    auto cellOf = [](float coordinate) { return int(std::floor(coordinate / GroundCellSize)); };
+    int minColumn = std::numeric_limits<int>::max(), minRow = std::numeric_limits<int>::max();
+    int maxColumn = std::numeric_limits<int>::lowest(), maxRow = std::numeric_limits<int>::lowest();
+    for (const SurfaceData& surface : surfaces) {
+        if (surface.layer != TileLayerId::Ground && surface.layer != TileLayerId::Obstacle) {
+            continue;
+        }
+        const cuboid& d = surface.dimensions;
+        minColumn = std::min(minColumn, cellOf(std::min(d.p1.x, d.p2.x)));
+        maxColumn = std::max(maxColumn, cellOf(std::max(d.p1.x, d.p2.x)));
+        minRow = std::min(minRow, cellOf(std::min(d.p1.z, d.p2.z)));
+        maxRow = std::max(maxRow, cellOf(std::max(d.p1.z, d.p2.z)));
+    }
+    if (minColumn > maxColumn) {
+        return;
+    }
+    if (!groundTop.empty()) {
+        minColumn = std::min(minColumn, groundFirstColumn);
+        maxColumn = std::max(maxColumn, groundFirstColumn + int(groundColumns) - 1);
+        minRow = std::min(minRow, groundFirstRow);
+        maxRow = std::max(maxRow, groundFirstRow + int(groundRows) - 1);
+    }
+    size_t columns = size_t(maxColumn - minColumn + 1);
+    const size_t rows = size_t(maxRow - minRow + 1);
+    if (groundTop.empty() || columns != groundColumns || rows != groundRows) {
+        // the map gets traced a region at a time, so growing along x leaves room for as much again, and the
+        // grid is laid out anew only every so often rather than for every region
+        if (!groundTop.empty() && columns > groundColumns) {
+            const size_t slack = std::max(columns, groundColumns * 2) - columns;
+            if (maxColumn > groundFirstColumn + int(groundColumns) - 1) {
+                maxColumn += int(slack);
+            } else {
+                minColumn -= int(slack);
+            }
+            columns += slack;
+        }
+        std::vector<float> grown(columns * rows, std::numeric_limits<float>::infinity());
+        for (size_t z = 0; z < groundRows; z++) {
+            const size_t row = size_t(groundFirstRow - minRow) + z;
+            std::copy(groundTop.begin() + z * groundColumns, groundTop.begin() + (z + 1) * groundColumns,
+                grown.begin() + row * columns + size_t(groundFirstColumn - minColumn));
+        }
+        groundTop.swap(grown);
+        groundFirstColumn = minColumn;
+        groundFirstRow = minRow;
+        groundColumns = columns;
+        groundRows = rows;
+    }
+    for (const SurfaceData& surface : surfaces) {
+        if (surface.layer != TileLayerId::Ground && surface.layer != TileLayerId::Obstacle) {
+            continue;
+        }
+        const cuboid& d = surface.dimensions;
+        const size_t x1 = size_t(cellOf(std::min(d.p1.x, d.p2.x)) - groundFirstColumn);
+        const size_t x2 = size_t(cellOf(std::max(d.p1.x, d.p2.x)) - groundFirstColumn);
+        const size_t z1 = size_t(cellOf(std::min(d.p1.z, d.p2.z)) - groundFirstRow);
+        const size_t z2 = size_t(cellOf(std::max(d.p1.z, d.p2.z)) - groundFirstRow);
+        const float top = std::min(d.p1.y, d.p2.y);
+        for (size_t z = z1; z <= z2; z++) {
+            for (size_t x = x1; x <= x2; x++) {
+                // smaller y is higher up; a particle under an overhang lands on the overhang's top instead
+                float& cell = groundTop[z * groundColumns + x];
+                cell = std::min(cell, top);
+            }
+        }
+    }
+}
+
+void ParticleSystem::update(float deltaTime, JobSystem& jobs)
+{
+    for (Batch& batch : batches) {
+        jobs.parallelFor(batch.size(), UpdateGrainSize, [&](size_t begin, size_t end) {
+            step(batch, begin, end, deltaTime);
+            if (batch.kind.collides) {
+                collide(batch, begin, end);
+            }
+        });
+        removeDead(batch);
+    }
+}
+
+void ParticleSystem::step(Batch& batch, size_t begin, size_t end, float deltaTime) const
+{
+    std::copy(batch.posX.begin() + begin, batch.posX.begin() + end, batch.prevX.begin() + begin);
+    std::copy(batch.posY.begin() + begin, batch.posY.begin() + end, batch.prevY.begin() + begin);
+    std::copy(batch.posZ.begin() + begin, batch.posZ.begin() + end, batch.prevZ.begin() + begin);
+    float* posX = batch.posX.data();
+    float* posY = batch.posY.data();
+    float* posZ = batch.posZ.data();
+    float* velX = batch.velX.data();
+    float* velY = batch.velY.data();
+    float* velZ = batch.velZ.data();
+    float* life = batch.life.data();
+    // velY is upwards like the entities' moveY, so it comes off y
+    const float fall = gravity_accel * deltaTime;
+    size_t i = begin;
+#ifdef PARTICLES_SSE2
+    const __m128 dt = _mm_set1_ps(deltaTime);
+    const __m128 fall4 = _mm_set1_ps(fall);
+    for (; i + 4 <= end; i += 4) {
+        const __m128 vy = _mm_sub_ps(_mm_loadu_ps(velY + i), fall4);
+        _mm_storeu_ps(velY + i, vy);
+        _mm_storeu_ps(posY + i, _mm_sub_ps(_mm_loadu_ps(posY + i), _mm_mul_ps(vy, dt)));
+        _mm_storeu_ps(posX + i, _mm_add_ps(_mm_loadu_ps(posX + i), _mm_mul_ps(_mm_loadu_ps(velX + i), dt)));
+        _mm_storeu_ps(posZ + i, _mm_add_ps(_mm_loadu_ps(posZ + i), _mm_mul_ps(_mm_loadu_ps(velZ + i), dt)));
+        _mm_storeu_ps(life + i, _mm_sub_ps(_mm_loadu_ps(life + i), dt));
+    }
+#endif
+    for (; i < end; i++) {
+        velY[i] -= fall;
+        posY[i] -= velY[i] * deltaTime;
+        posX[i] += velX[i] * deltaTime;
+        posZ[i] += velZ[i] * deltaTime;
+        life[i] -= deltaTime;
+    }
+}
+
+void ParticleSystem::collide(Batch& batch, size_t begin, size_t end) const
+{
+    if (groundTop.empty()) {
+        return;
+    }
+    for (size_t i = begin; i < end; i++) {
+        const float cellX = batch.posX[i] / GroundCellSize - float(groundFirstColumn);
+        const float cellZ = batch.posZ[i] / GroundCellSize - float(groundFirstRow);
+        if (cellX < 0.f || cellZ < 0.f || cellX >= float(groundColumns) || cellZ >= float(groundRows)) {
+            continue;
+        }
+        const float top = groundTop[size_t(cellZ) * groundColumns + size_t(cellX)];
+        // only particles that went through the top this step, so ones already below it carry on falling
+        if (batch.prevY[i] <= top && batch.posY[i] > top) {
+            batch.posY[i] = top;
+            batch.velY[i] = -batch.velY[i] * batch.kind.bounce;
+            batch.velX[i] *= batch.kind.friction;
+            batch.velZ[i] *= batch.kind.friction;
+        }
+    }
+}
+
+void ParticleSystem::removeDead(Batch& batch)
+{
+    // swap the last live particle into each dead one's place; particles don't care about their order
+    size_t count = batch.size();
+    for (size_t i = 0; i < count;) {
+        if (batch.life[i] > 0.f) {
+            i++;
+            continue;
+        }
+        count--;
+        for (std::vector<float>* field : { &batch.posX, &batch.posY, &batch.posZ, &batch.prevX, &batch.prevY, &batch.prevZ,
+            &batch.velX, &batch.velY, &batch.velZ, &batch.life }) {
+            (*field)[i] = (*field)[count];
+        }
+    }
+    for (std::vector<float>* field : { &batch.posX, &batch.posY, &batch.posZ, &batch.prevX, &batch.prevY, &batch.prevZ,
+        &batch.velX, &batch.velY, &batch.velZ, &batch.life }) {
+        field->resize(count);
+    }
+}
+
+size_t ParticleSystem::size() const
+{
+    size_t count = 0;
+    for (const Batch& batch : batches) {
+        count += batch.size();
+    }
+    return count;
+}
+
+void ParticleSystem::snapshot(std::vector<ParticleBatchSnapshot>& out) const
+{
+    out.resize(batches.size());
+    for (size_t b = 0; b < batches.size(); b++) {
+        const Batch& batch = batches[b];
+        ParticleBatchSnapshot& batchOut = out[b];
+        batchOut.texture = batch.kind.texture.get();
+        batchOut.source = batch.kind.source;
+        batchOut.color = batch.kind.color;
+        batchOut.size = batch.kind.size;
+        batchOut.prevPos.resize(batch.size());
+        batchOut.pos.resize(batch.size());
+        for (size_t i = 0; i < batch.size(); i++) {
+            batchOut.prevPos[i] = { batch.prevX[i], batch.prevY[i], batch.prevZ[i] };
+            batchOut.pos[i] = { batch.posX[i], batch.posY[i], batch.posZ[i] };
+        }
+    }
+}
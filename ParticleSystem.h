@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <SDL2/SDL_pixels.h>
+#include <SDL2/SDL_rect.h>
+#include "Geometry.h"
+
+struct SurfaceData;
+struct ParticleBatchSnapshot;
+
+/// @brief How one kind of particle looks and behaves; every particle of a kind is drawn in one batch
+struct ParticleKind
+{
+    std::shared_ptr<class Texture> texture;
+    SDL_Rect source;
+    SDL_Color color;
+    // edge of the drawn square, in pixels
+    float size;
+    // stop at the ground instead of falling through it, keeping this much of the speed into and along it
+    bool collides;
+    float bounce;
+    float friction;
+};
+
+/// @brief Thousands of short-lived cosmetic particles: dust, sparks, debris. Positions, velocities and lifetimes
+/// are kept per kind in parallel arrays and stepped four at a time, with no collision query per particle
+/// beyond a lookup in a height grid of the traced ground. Particles aren't part of the world state, so
+/// rewinding, savestates and state hashes leave them alone
+class ParticleSystem
+{
+public:
+    typedef uint32_t KindId;
+
+    // most live particles of one kind; emitting more than that drops the new ones
+    static const size_t MaxParticlesPerKind = 65536;
+    // particles per range when a step is split across threads
+    static const size_t UpdateGrainSize = 4096;
+    // edge of a ground height grid cell, in real units
+    static constexpr float GroundCellSize = 1.f;
+
+private:
+    struct Batch
+    {
+        ParticleKind kind;
+        std::vector<float> posX, posY, posZ;
+        std::vector<float> prevX, prevY, prevZ;
+        std::vector<float> velX, velY, velZ;
+        // seconds left to live
+        std::vector<float> life;
+
+        size_t size() const { return posX.size(); }
+    };
+
+    std::vector<Batch> batches;
+    // the top of the highest ground in each cell, or infinity where there's none. Cells are counted from the
+    // world origin, groundTop[0] being the one at groundFirstColumn and groundFirstRow, so the grid can grow
+    // as more of the map is traced without any cell moving
+    std::vector<float> groundTop;
+    int groundFirstColumn, groundFirstRow;
+    size_t groundColumns, groundRows;
+    uint32_t seed;
+
+    float random();
+    void step(Batch& batch, size_t begin, size_t end, float deltaTime) const;
+    void collide(Batch& batch, size_t begin, size_t end) const;
+    void removeDead(Batch& batch);
+public:
+    ParticleSystem();
+
+    KindId addKind(const ParticleKind& kind);
+    void emit(KindId kind, const tripoint& pos, const MoveVector& velocity, float life);
+    // emit count particles from pos, flying off upwards in random directions at up to speed
+    void burst(KindId kind, const tripoint& pos, size_t count, float speed, float life);
+    // rebuild the height grid particles collide against from the ground and obstacle surfaces
+    void setGround(const std::vector<SurfaceData>& surfaces);
+    // add newly traced surfaces to the height grid, growing it only when they're outside it
+    void addGround(const std::vector<SurfaceData>& surfaces);
+
+    void update(float deltaTime, class JobSystem& jobs);
+    size_t size() const;
+    size_t size(KindId kind) const { return batches[kind].size(); }
+
+    // copy every live particle's previous and latest position for the renderer, reusing out's capacity
+    void snapshot(std::vector<ParticleBatchSnapshot>& out) const;
+};
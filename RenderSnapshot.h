@@ -0,0 +1,50 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <SDL2/SDL_pixels.h>
+#include <SDL2/SDL_rect.h>
+#include "Geometry.h"
+
+/// @brief What the renderer needs to draw one actor, as of one simulation step
+struct ActorSnapshot
+{
+    class Texture* texture;
+    SDL_Rect spriteRect;
+    tripoint prevPos;
+    tripoint pos;
+    bool visible;
+};
+
+/// @brief Every live particle of one kind, as of one simulation step
+struct ParticleBatchSnapshot
+{
+    class Texture* texture;
+    SDL_Rect source;
+    SDL_Color color;
+    float size;
+    std::vector<tripoint> prevPos;
+    std::vector<tripoint> pos;
+};
+
+/// @brief Everything drawn for a frame, published by the simulation after each step so rendering never touches live simulation state
+struct RenderSnapshot
+{
+    uint64_t step = 0;
+    // performance counter when the snapshot was published, to interpolate from when the simulation runs on its own thread
+    uint64_t publishCounter = 0;
+    // the act to draw; an act that's been swapped out stays alive while a snapshot still holds it
+    std::shared_ptr<class Level> level;
+    pixelpos prevCamera{ 0, 0 };
+    pixelpos camera{ 0, 0 };
+    // in pixels per second
+    float cameraVelocityX = 0.f;
+    float cameraVelocityY = 0.f;
+    std::vector<ActorSnapshot> actors;
+    std::vector<ParticleBatchSnapshot> particles;
+    // collectibles still there, drawn the same way as particles: rings then monitors
+    std::vector<ParticleBatchSnapshot> collectibles;
+    // collision surfaces around the view and the player's collision cylinder
+    std::vector<cuboid> debugCuboids;
+};
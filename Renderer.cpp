@@ -0,0 +1,147 @@
+#include "Renderer.h"
+#include "Assets.h"
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+SdlRenderer::SdlRenderer(SDL_Window* window, SDL_Renderer* renderer) :
+    window(window),
+    renderer(renderer)
+{
+}
+
+SdlRenderer* SdlRenderer::Create(const char* title, int width, int height, bool vsync)
+{
+    SDL_Window *window = SDL_CreateWindow(title, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, width, height, SDL_WINDOW_SHOWN);
+    if(window == nullptr) 
+    {
+        SDL_Log("Failed to create window: %s", SDL_GetError());
+        return nullptr;
+    }
+  
+    SDL_Renderer *renderer = SDL_CreateRenderer( window, -1, SDL_RENDERER_ACCELERATED |
+                                        (vsync ? SDL_RENDERER_PRESENTVSYNC : 0) | SDL_RENDERER_TARGETTEXTURE );
+    if(renderer == nullptr)
+    {
+        SDL_Log("Failed to create renderer: %s", SDL_GetError());
+        SDL_DestroyWindow(window);
+        return nullptr;
+    }
+    return new SdlRenderer(window, renderer);
+}
+
+SdlRenderer::~SdlRenderer()
+{
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+}
+
+bool SdlRenderer::loadTexture(const std::string& filename, SDL_Texture*& texture, SDL_Point& size)
+{
+    SDL_RWops* file = Assets::Open(filename);
+    texture = file != nullptr ? IMG_LoadTexture_RW(renderer, file, 1) : nullptr;
+    if(!texture)
+    {
+        SDL_Log("Failed to create texture: %s", SDL_GetError());
+        return false;
+    }
+    if (SDL_QueryTexture(texture, NULL, NULL, &size.x, &size.y) != 0)
+    {
+        SDL_Log("Failed to query texture size: %s", SDL_GetError());
+        SDL_DestroyTexture(texture);
+        texture = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool SdlRenderer::createTexture(SDL_Surface* surface, SDL_Texture*& texture, SDL_Point& size)
+{
+    texture = SDL_CreateTextureFromSurface(renderer, surface);
+    if(!texture)
+    {
+        SDL_Log("Failed to create texture: %s", SDL_GetError());
+        return false;
+    }
+    size.x = surface->w;
+    size.y = surface->h;
+    return true;
+}
+
+void SdlRenderer::destroyTexture(SDL_Texture* texture)
+{
+    SDL_DestroyTexture(texture);
+}
+
+void SdlRenderer::setDrawColor(Uint8 r, Uint8 g, Uint8 b, Uint8 a)
+{
+    SDL_SetRenderDrawColor(renderer, r, g, b, a);
+}
+
+void SdlRenderer::clear()
+{
+    SDL_RenderClear(renderer);
+}
+
+void SdlRenderer::drawLine(int x1, int y1, int x2, int y2)
+{
+    SDL_RenderDrawLine(renderer, x1, y1, x2, y2);
+}
+
+void SdlRenderer::drawRect(const SDL_Rect& rect)
+{
+    SDL_RenderDrawRect(renderer, &rect);
+}
+
+void SdlRenderer::copy(SDL_Texture* texture, const SDL_Rect& srcRect, const SDL_Rect& destRect, SDL_RendererFlip flip)
+{
+    SDL_RenderCopyEx(renderer, texture, &srcRect, &destRect, 0.0, NULL, flip);
+}
+
+void SdlRenderer::geometry(SDL_Texture* texture, const SDL_Vertex* vertices, int count)
+{
+    SDL_RenderGeometry(renderer, texture, vertices, count, nullptr, 0);
+}
+
+void SdlRenderer::present()
+{
+    SDL_RenderPresent(renderer);
+}
+
+bool NullRenderer::loadTexture(const std::string& filename, SDL_Texture*& texture, SDL_Point& size)
+{
+    texture = nullptr;
+    SDL_RWops* file = Assets::Open(filename);
+    if (file == nullptr) {
+        SDL_Log("Failed to open image: %s", SDL_GetError());
+        return false;
+    }
+    // a PNG's size sits in its IHDR chunk, straight after the 8-byte signature and the chunk's length and type
+    static const Uint8 pngSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    Uint8 header[24];
+    bool isPng = SDL_RWread(file, header, sizeof(header), 1) == 1 && SDL_memcmp(header, pngSignature, sizeof(pngSignature)) == 0;
+    if (isPng) {
+        SDL_RWclose(file);
+        size.x = int((Uint32(header[16]) << 24) | (Uint32(header[17]) << 16) | (Uint32(header[18]) << 8) | header[19]);
+        size.y = int((Uint32(header[20]) << 24) | (Uint32(header[21]) << 16) | (Uint32(header[22]) << 8) | header[23]);
+        return true;
+    }
+    // anything else has to be decoded to find out, but still never reaches the GPU
+    SDL_RWseek(file, 0, RW_SEEK_SET);
+    SDL_Surface* surface = IMG_Load_RW(file, 1);
+    if (surface == nullptr) {
+        SDL_Log("Failed to load image: %s", SDL_GetError());
+        return false;
+    }
+    size.x = surface->w;
+    size.y = surface->h;
+    SDL_FreeSurface(surface);
+    return true;
+}
+
+bool NullRenderer::createTexture(SDL_Surface* surface, SDL_Texture*& texture, SDL_Point& size)
+{
+    texture = nullptr;
+    size.x = surface->w;
+    size.y = surface->h;
+    return true;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <string>
+#include <SDL2/SDL_render.h>
+
+/// @brief The drawing calls the game makes, so the simulation can run against a real SDL renderer or no display at all
+class Renderer
+{
+public:
+    virtual ~Renderer() {}
+
+    /// @brief Load an image file into a texture
+    /// @param filename path of the image
+    /// @param texture receives the backend texture, may be nullptr for backends that don't keep textures
+    /// @param size receives the image size in pixels
+    /// @return false if the image could not be loaded
+    virtual bool loadTexture(const std::string& filename, SDL_Texture*& texture, SDL_Point& size) = 0;
+    /// @brief Upload an already decoded image, so decoding can happen off the thread that owns the renderer
+    virtual bool createTexture(SDL_Surface* surface, SDL_Texture*& texture, SDL_Point& size) = 0;
+    virtual void destroyTexture(SDL_Texture* texture) = 0;
+
+    virtual void setDrawColor(Uint8 r, Uint8 g, Uint8 b, Uint8 a) = 0;
+    virtual void clear() = 0;
+    virtual void drawLine(int x1, int y1, int x2, int y2) = 0;
+    virtual void drawRect(const SDL_Rect& rect) = 0;
+    virtual void copy(SDL_Texture* texture, const SDL_Rect& srcRect, const SDL_Rect& destRect, SDL_RendererFlip flip) = 0;
+    virtual void geometry(SDL_Texture* texture, const SDL_Vertex* vertices, int count) = 0;
+    virtual void present() = 0;
+
+    virtual bool isHeadless() const = 0;
+};
+
+/// @brief Renderer backed by an SDL window and SDL_Renderer
+class SdlRenderer final : public Renderer
+{
+    struct SDL_Window* window;
+    struct SDL_Renderer* renderer;
+    SdlRenderer(SDL_Window* window, SDL_Renderer* renderer);
+public:
+    static SdlRenderer* Create(const char* title, int width, int height, bool vsync = true);
+    ~SdlRenderer();
+
+    bool loadTexture(const std::string& filename, SDL_Texture*& texture, SDL_Point& size) override;
+    bool createTexture(SDL_Surface* surface, SDL_Texture*& texture, SDL_Point& size) override;
+    void destroyTexture(SDL_Texture* texture) override;
+
+    void setDrawColor(Uint8 r, Uint8 g, Uint8 b, Uint8 a) override;
+    void clear() override;
+    void drawLine(int x1, int y1, int x2, int y2) override;
+    void drawRect(const SDL_Rect& rect) override;
+    void copy(SDL_Texture* texture, const SDL_Rect& srcRect, const SDL_Rect& destRect, SDL_RendererFlip flip) override;
+    void geometry(SDL_Texture* texture, const SDL_Vertex* vertices, int count) override;
+    void present() override;
+
+    bool isHeadless() const override { return false; }
+};
+
+/// @brief Renderer that draws nothing. Images are never decoded or uploaded, only their sizes are read
+/// so that tile UVs and sprite rects still work out the same as with a real renderer
+class NullRenderer final : public Renderer
+{
+public:
+    bool loadTexture(const std::string& filename, SDL_Texture*& texture, SDL_Point& size) override;
+    bool createTexture(SDL_Surface* surface, SDL_Texture*& texture, SDL_Point& size) override;
+    void destroyTexture(SDL_Texture* texture) override {}
+
+    void setDrawColor(Uint8 r, Uint8 g, Uint8 b, Uint8 a) override {}
+    void clear() override {}
+    void drawLine(int x1, int y1, int x2, int y2) override {}
+    void drawRect(const SDL_Rect& rect) override {}
+    void copy(SDL_Texture* texture, const SDL_Rect& srcRect, const SDL_Rect& destRect, SDL_RendererFlip flip) override {}
+    void geometry(SDL_Texture* texture, const SDL_Vertex* vertices, int count) override {}
+    void present() override {}
+
+    bool isHeadless() const override { return true; }
+};
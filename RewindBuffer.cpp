@@ -0,0 +1,171 @@
+#include "RewindBuffer.h"
+#include <zstd.h>
+#include <SDL2/SDL_log.h>
+#include <algorithm>
+#include <cstring>
+
+RewindBuffer::RewindBuffer(size_t capacity, unsigned int keyframeInterval, bool compress) :
+    ring(capacity),
+    writeOffset(0),
+    keyframeInterval(std::max(keyframeInterval, 1u)),
+    compress(compress),
+    keyframeStep(0),
+    compressor(compress ? ZSTD_createCCtx() : nullptr),
+    decompressor(compress ? ZSTD_createDCtx() : nullptr)
+{
+}
+
+RewindBuffer::~RewindBuffer()
+{
+    ZSTD_freeCCtx(compressor);
+    ZSTD_freeDCtx(decompressor);
+}
+
+void RewindBuffer::capture(uint64_t step, const std::vector<char>& state)
+{
+    // a keyframe every so often, and whenever the state no longer lines up with the last one
+    const bool isKeyframe = keyframe.empty() || state.size() != keyframe.size() || step - keyframeStep >= keyframeInterval ||
+        find(keyframeStep) == SIZE_MAX;
+    if (isKeyframe) {
+        keyframe = state;
+        keyframeStep = step;
+        store(step, state, nullptr);
+        return;
+    }
+    scratch.resize(state.size());
+    // whole words at a time; the state is mostly floats, so this runs at memory speed
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= state.size(); i += sizeof(uint64_t)) {
+        uint64_t a, b;
+        memcpy(&a, state.data() + i, sizeof(a));
+        memcpy(&b, keyframe.data() + i, sizeof(b));
+        a ^= b;
+        memcpy(scratch.data() + i, &a, sizeof(a));
+    }
+    for (; i < state.size(); i++) {
+        scratch[i] = state[i] ^ keyframe[i];
+    }
+    store(step, scratch, &state);
+}
+
+bool RewindBuffer::store(uint64_t step, const std::vector<char>& data, const std::vector<char>* whole)
+{
+    Record record{ step, 0, data.size(), data.size(), whole == nullptr, false };
+    const char* source = data.data();
+    if (compress) {
+        packed.resize(ZSTD_compressBound(data.size()));
+        size_t packedSize = ZSTD_compressCCtx(compressor, packed.data(), packed.size(), data.data(), data.size(), 1);
+        if (!ZSTD_isError(packedSize) && packedSize < data.size()) {
+            record.storedSize = packedSize;
+            record.compressed = true;
+            source = packed.data();
+        }
+    }
+    if (record.storedSize > ring.size()) {
+        SDL_Log("World state of %zu bytes doesn't fit the %zu byte rewind buffer", record.storedSize, ring.size());
+        return false;
+    }
+    if (writeOffset + record.storedSize > ring.size()) {
+        // records are kept in one piece, so wrap round and leave the tail unused
+        evict(writeOffset, ring.size() - writeOffset);
+        writeOffset = 0;
+    }
+    evict(writeOffset, record.storedSize);
+    if (whole != nullptr && find(keyframeStep) == SIZE_MAX) {
+        // making room took the delta's own keyframe, so this capture becomes the keyframe instead
+        keyframe = *whole;
+        keyframeStep = step;
+        return store(step, *whole, nullptr);
+    }
+    record.offset = writeOffset;
+    memcpy(ring.data() + writeOffset, source, record.storedSize);
+    writeOffset += record.storedSize;
+    records.push_back(record);
+    return true;
+}
+
+void RewindBuffer::evict(size_t offset, size_t length)
+{
+    // the oldest records are the ones just past the write position, so they're the ones in the way
+    while (!records.empty() && records.front().offset < offset + length && offset < records.front().offset + records.front().storedSize) {
+        records.pop_front();
+    }
+    while (!records.empty() && !records.front().keyframe) {
+        records.pop_front();
+    }
+}
+
+size_t RewindBuffer::find(uint64_t step) const
+{
+    if (records.empty() || step < records.front().step || step > records.back().step) {
+        return SIZE_MAX;
+    }
+    // one record per step, give or take any the loop skipped, so start from where it would be and walk
+    size_t index = std::min(size_t(step - records.front().step), records.size() - 1);
+    while (index > 0 && records[index].step > step) {
+        index--;
+    }
+    while (index + 1 < records.size() && records[index].step < step) {
+        index++;
+    }
+    return records[index].step == step ? index : SIZE_MAX;
+}
+
+bool RewindBuffer::unpack(const Record& record, std::vector<char>& out)
+{
+    out.resize(record.size);
+    const char* stored = ring.data() + record.offset;
+    if (!record.compressed) {
+        memcpy(out.data(), stored, record.size);
+        return true;
+    }
+    size_t result = ZSTD_decompressDCtx(decompressor, out.data(), out.size(), stored, record.storedSize);
+    return !ZSTD_isError(result) && result == record.size;
+}
+
+bool RewindBuffer::restore(uint64_t step, std::vector<char>& state)
+{
+    const size_t index = find(step);
+    if (index == SIZE_MAX) {
+        return false;
+    }
+    // a delta's keyframe is the last one before it, and eviction never leaves a delta without one
+    size_t keyIndex = index;
+    while (!records[keyIndex].keyframe) {
+        if (keyIndex == 0) {
+            SDL_Log("Rewind capture for step %llu has no keyframe", (unsigned long long)step);
+            return false;
+        }
+        keyIndex--;
+    }
+    if (!unpack(records[keyIndex], state)) {
+        return false;
+    }
+    if (keyIndex == index) {
+        return true;
+    }
+    if (!unpack(records[index], scratch) || scratch.size() != state.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < state.size(); i++) {
+        state[i] ^= scratch[i];
+    }
+    return true;
+}
+
+void RewindBuffer::truncateAfter(uint64_t step)
+{
+    while (!records.empty() && records.back().step > step) {
+        records.pop_back();
+    }
+    // new captures go straight after what's left, starting with a fresh keyframe
+    writeOffset = records.empty() ? 0 : records.back().offset + records.back().storedSize;
+    keyframe.clear();
+}
+
+void RewindBuffer::clear()
+{
+    records.clear();
+    writeOffset = 0;
+    keyframe.clear();
+}
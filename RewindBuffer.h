@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+/// @brief The last few seconds of world state captures, kept in a fixed-size byte ring. Every keyframeInterval
+/// steps a capture is kept whole; the ones in between are kept as the XOR of themselves and their keyframe,
+/// which is mostly zeroes and compresses to very little. Any capture still in the ring can be restored
+/// from its keyframe and its own delta, whatever is between them. Once the ring is full the oldest
+/// captures make room for new ones
+class RewindBuffer
+{
+    struct Record
+    {
+        uint64_t step;
+        size_t offset;
+        size_t storedSize;
+        size_t size;
+        bool keyframe;
+        bool compressed;
+    };
+
+    std::vector<char> ring;
+    // where the next record goes
+    size_t writeOffset;
+    std::deque<Record> records;
+    unsigned int keyframeInterval;
+    bool compress;
+    // the latest keyframe, whole, to diff captures against
+    std::vector<char> keyframe;
+    uint64_t keyframeStep;
+    std::vector<char> scratch;
+    std::vector<char> packed;
+    struct ZSTD_CCtx_s* compressor;
+    struct ZSTD_DCtx_s* decompressor;
+
+    // store a keyframe, or with whole given, the delta of that state against the current keyframe
+    bool store(uint64_t step, const std::vector<char>& data, const std::vector<char>* whole);
+    bool unpack(const Record& record, std::vector<char>& out);
+    // index of the record for a step, or SIZE_MAX
+    size_t find(uint64_t step) const;
+    // drop records from the front while they sit in [offset, offset + length), and deltas left without their keyframe
+    void evict(size_t offset, size_t length);
+public:
+    /// @param capacity bytes of ring to keep captures in
+    /// @param keyframeInterval steps between whole captures
+    /// @param compress zstd-compress the captures, trading a little time per step for many more steps of history
+    RewindBuffer(size_t capacity, unsigned int keyframeInterval, bool compress);
+    ~RewindBuffer();
+
+    /// @brief Keep the world state after a step, its capture taking a few microseconds for a small world
+    void capture(uint64_t step, const std::vector<char>& state);
+
+    /// @brief Get back the capture for a step, false if it's no longer (or never was) in the ring
+    bool restore(uint64_t step, std::vector<char>& state);
+
+    /// @brief Forget every capture after a step, for carrying on from there after restoring it
+    void truncateAfter(uint64_t step);
+
+    /// @brief Forget every capture, when the world jumps somewhere its history doesn't lead
+    void clear();
+
+    bool empty() const { return records.empty(); }
+    uint64_t oldestStep() const { return records.empty() ? 0 : records.front().step; }
+    uint64_t newestStep() const { return records.empty() ? 0 : records.back().step; }
+};
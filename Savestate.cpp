@@ -0,0 +1,94 @@
+#include "Savestate.h"
+#include <zstd.h>
+#include <SDL2/SDL_log.h>
+#include <fstream>
+#include <cstring>
+
+const char Savestate::Magic[8] = { 'S', 'F', 'F', 'S', 'A', 'V', 'E', '\0' };
+
+namespace
+{
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t mapPathLength;
+        uint64_t stateSize;
+        uint64_t storedSize;
+    };
+
+    // fast enough to save within a frame, and world state is mostly repetition anyway
+    const int CompressionLevel = 3;
+    // far more than any world state; a header claiming more is corrupt, not something to allocate
+    const uint64_t MaxStateSize = 1ull << 30;
+}
+
+bool Savestate::Write(const std::string& path, const std::string& mapPath, const std::vector<char>& state)
+{
+    std::vector<char> stored(ZSTD_compressBound(state.size()));
+    size_t storedSize = ZSTD_compress(stored.data(), stored.size(), state.data(), state.size(), CompressionLevel);
+    if (ZSTD_isError(storedSize)) {
+        SDL_Log("Failed to compress savestate: %s", ZSTD_getErrorName(storedSize));
+        return false;
+    }
+    FileHeader header{};
+    memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.mapPathLength = uint32_t(mapPath.size());
+    header.stateSize = state.size();
+    header.storedSize = storedSize;
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(mapPath.data(), std::streamsize(mapPath.size()));
+    file.write(stored.data(), std::streamsize(storedSize));
+    if (!file.good()) {
+        SDL_Log("Failed to write savestate %s", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool Savestate::Read(const std::string& path, const std::string& mapPath, std::vector<char>& state)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    const std::streamoff fileSize = file ? std::streamoff(file.tellg()) : 0;
+    file.seekg(0);
+    FileHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        SDL_Log("Failed to read savestate %s", path.c_str());
+        return false;
+    }
+    if (memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version) {
+        SDL_Log("%s is not a version %u savestate", path.c_str(), Version);
+        return false;
+    }
+    // the sizes come from the file, so they're checked against it before anything is allocated for them
+    const uint64_t bodySize = uint64_t(fileSize) - sizeof(header);
+    if (header.mapPathLength > bodySize || header.storedSize != bodySize - header.mapPathLength) {
+        SDL_Log("Savestate %s is truncated", path.c_str());
+        return false;
+    }
+    std::string savedMap(header.mapPathLength, '\0');
+    std::vector<char> stored(size_t(header.storedSize));
+    if (!file.read(savedMap.data(), std::streamsize(savedMap.size())) || !file.read(stored.data(), std::streamsize(stored.size()))) {
+        SDL_Log("Savestate %s is truncated", path.c_str());
+        return false;
+    }
+    if (savedMap != mapPath) {
+        SDL_Log("Savestate %s is for %s, not %s", path.c_str(), savedMap.c_str(), mapPath.c_str());
+        return false;
+    }
+    const unsigned long long frameSize = ZSTD_getFrameContentSize(stored.data(), stored.size());
+    if (frameSize != header.stateSize || header.stateSize > MaxStateSize) {
+        SDL_Log("Savestate %s is corrupt", path.c_str());
+        return false;
+    }
+    state.resize(size_t(header.stateSize));
+    size_t result = ZSTD_decompress(state.data(), state.size(), stored.data(), stored.size());
+    if (ZSTD_isError(result) || result != state.size()) {
+        SDL_Log("Savestate %s is corrupt", path.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// @brief Savestate files: a world state capture (GameWindow::saveState) as one zstd frame, behind a small
+/// versioned header naming the map it was taken on
+namespace Savestate
+{
+    const uint32_t Version = 1;
+    extern const char Magic[8];
+
+    bool Write(const std::string& path, const std::string& mapPath, const std::vector<char>& state);
+    /// @brief Read a savestate, failing if it's from another version or another map
+    bool Read(const std::string& path, const std::string& mapPath, std::vector<char>& state);
+}
@@ -0,0 +1,75 @@
+#include "StateHash.h"
+#include <SDL2/SDL_log.h>
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+
+StateHashStream::StateHashStream() :
+    comparing(false),
+    steps(0),
+    previous(Seed),
+    firstMismatch(UINT64_MAX)
+{
+}
+
+StateHashStream* StateHashStream::Create(const std::string& outPath, const std::string& referencePath)
+{
+    StateHashStream* stream = new StateHashStream();
+    if (!referencePath.empty()) {
+        std::ifstream file(referencePath);
+        if (!file.is_open()) {
+            SDL_Log("Failed to open state hash reference %s", referencePath.c_str());
+            delete stream;
+            return nullptr;
+        }
+        uint64_t step;
+        std::string hash;
+        while (file >> step >> hash) {
+            stream->reference.push_back(strtoull(hash.c_str(), nullptr, 16));
+        }
+        stream->comparing = true;
+    }
+    if (!outPath.empty()) {
+        stream->out.open(outPath, std::ios::trunc);
+        if (!stream->out.is_open()) {
+            SDL_Log("Failed to create state hash file %s", outPath.c_str());
+            delete stream;
+            return nullptr;
+        }
+    }
+    return stream;
+}
+
+bool StateHashStream::record(uint64_t stateHash)
+{
+    const uint64_t step = steps++;
+    previous = HashBytes(&stateHash, sizeof(stateHash), previous);
+    if (out.is_open()) {
+        char line[48];
+        snprintf(line, sizeof(line), "%" PRIu64 " %016" PRIx64 "\n", step, previous);
+        out << line;
+    }
+    if (comparing && step < reference.size() && reference[step] != previous) {
+        if (firstMismatch == UINT64_MAX) {
+            firstMismatch = step;
+            SDL_Log("State hash diverged from the reference run at step %" PRIu64, step);
+        }
+        return false;
+    }
+    return true;
+}
+
+bool StateHashStream::report() const
+{
+    if (!comparing) {
+        SDL_Log("Recorded state hashes for %" PRIu64 " steps, final %016" PRIx64, steps, previous);
+        return true;
+    }
+    const uint64_t compared = std::min<uint64_t>(steps, reference.size());
+    if (firstMismatch != UINT64_MAX) {
+        SDL_Log("State hashes differ from the reference run from step %" PRIu64 " of %" PRIu64 " compared", firstMismatch, compared);
+        return false;
+    }
+    SDL_Log("State hashes match the reference run for all %" PRIu64 " steps compared", compared);
+    return true;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// @brief Continue a 64-bit hash over a block of memory, eight bytes at a time. Not cryptographic, just
+/// cheap enough to run over the whole simulation state every step
+inline uint64_t HashBytes(const void* data, size_t length, uint64_t hash)
+{
+    const uint64_t prime = 0x100000001b3ull;
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * prime;
+        hash ^= hash >> 29;
+    }
+    for (; i < length; i++) {
+        hash = (hash ^ bytes[i]) * prime;
+    }
+    return hash;
+}
+
+template<typename T>
+uint64_t HashVector(const std::vector<T>& values, uint64_t hash)
+{
+    return HashBytes(values.data(), values.size() * sizeof(T), hash);
+}
+
+/// @brief The state hash of every simulation step of a run, written out to a file and/or checked against
+/// the ones of an earlier run. Each hash also folds in the one before, so a stream that diverges stays diverged
+class StateHashStream
+{
+    std::ofstream out;
+    std::vector<uint64_t> reference;
+    bool comparing;
+    uint64_t steps;
+    uint64_t previous;
+    // first step whose hash didn't match the reference, or UINT64_MAX
+    uint64_t firstMismatch;
+
+    StateHashStream();
+public:
+    static const uint64_t Seed = 0xcbf29ce484222325ull;
+
+    /// @param outPath where to write one "step hash" line per step, empty for nowhere
+    /// @param referencePath a file written through outPath on an earlier run to compare against, empty for none
+    static StateHashStream* Create(const std::string& outPath, const std::string& referencePath);
+
+    /// @brief Add the next step's state hash, returning false if it doesn't match the reference run's
+    bool record(uint64_t stateHash);
+
+    /// @brief Log how the run compared with the reference; true if it matched for every step both runs have
+    bool report() const;
+};
@@ -0,0 +1,136 @@
+#include "TaskGraph.h"
+#include <SDL2/SDL.h>
+#include <thread>
+#include <algorithm>
+#include <cassert>
+
+TaskGraph::TaskGraph() :
+    unfinished(0),
+    failed(false),
+    stopping(false),
+    runStart(0),
+    runEnd(0)
+{
+}
+
+TaskGraph::TaskId TaskGraph::add(const std::string& name, std::function<bool()> work, const std::vector<TaskId>& dependencies, Affinity affinity)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    TaskId id = tasks.size();
+    Task& task = tasks.emplace_back();
+    task.name = name;
+    task.work = std::move(work);
+    task.affinity = affinity;
+    for (TaskId dependency : dependencies) {
+        assert(dependency < id);
+        if (!tasks[dependency].done) {
+            tasks[dependency].dependents.push_back(id);
+            task.pendingDependencies++;
+        }
+    }
+    unfinished++;
+    if (task.pendingDependencies == 0) {
+        enqueue(id);
+    }
+    return id;
+}
+
+void TaskGraph::enqueue(TaskId id)
+{
+    if (tasks[id].affinity == Affinity::Main) {
+        mainQueue.push_back(id);
+        mainCond.notify_one();
+    } else {
+        workerQueue.push_back(id);
+        workerCond.notify_one();
+    }
+}
+
+void TaskGraph::execute(Task& task, TaskId id)
+{
+    task.start = SDL_GetPerformanceCounter();
+    bool success = task.work();
+    task.end = SDL_GetPerformanceCounter();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    task.done = true;
+    unfinished--;
+    if (!success) {
+        SDL_Log("Startup task failed: %s", task.name.c_str());
+        failed = true;
+        workerCond.notify_all();
+    } else {
+        for (TaskId dependent : task.dependents) {
+            if (--tasks[dependent].pendingDependencies == 0) {
+                enqueue(dependent);
+            }
+        }
+    }
+    mainCond.notify_one();
+}
+
+void TaskGraph::workerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        workerCond.wait(lock, [this]() { return stopping || failed || !workerQueue.empty(); });
+        if (stopping || failed) {
+            return;
+        }
+        TaskId id = workerQueue.front();
+        workerQueue.pop_front();
+        Task& task = tasks[id];
+        lock.unlock();
+        execute(task, id);
+        lock.lock();
+    }
+}
+
+bool TaskGraph::run(unsigned int workerCount)
+{
+    runStart = SDL_GetPerformanceCounter();
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < std::max(workerCount, 1u); i++) {
+        workers.emplace_back(&TaskGraph::workerLoop, this);
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        mainCond.wait(lock, [this]() { return failed || unfinished == 0 || !mainQueue.empty(); });
+        if (failed || unfinished == 0) {
+            break;
+        }
+        TaskId id = mainQueue.front();
+        mainQueue.pop_front();
+        Task& task = tasks[id];
+        lock.unlock();
+        execute(task, id);
+        lock.lock();
+    }
+    stopping = true;
+    workerCond.notify_all();
+    lock.unlock();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    runEnd = SDL_GetPerformanceCounter();
+    return !failed;
+}
+
+void TaskGraph::report(const char* title) const
+{
+    const double toMs = 1000.0 / SDL_GetPerformanceFrequency();
+    double busy = 0.0;
+    for (const Task& task : tasks) {
+        if (!task.done) {
+            SDL_Log("%s: %-32s skipped", title, task.name.c_str());
+            continue;
+        }
+        double ms = (task.end - task.start) * toMs;
+        busy += ms;
+        SDL_Log("%s: %-32s %8.2f ms (from %.2f ms, %s)", title, task.name.c_str(), ms, (task.start - runStart) * toMs,
+            task.affinity == Affinity::Main ? "main thread" : "worker");
+    }
+    // busy time over wall-clock time shows how much of the work actually overlapped
+    SDL_Log("%s: %zu tasks, %.2f ms of work in %.2f ms wall-clock", title, tasks.size(), busy, (runEnd - runStart) * toMs);
+}
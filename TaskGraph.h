@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <vector>
+
+/// @brief Runs a set of tasks with explicit dependencies on a few worker threads. Tasks that have to run
+/// on the thread that owns the renderer (texture uploads) are handed back to the thread calling run()
+class TaskGraph
+{
+public:
+    typedef size_t TaskId;
+
+    enum class Affinity
+    {
+        Worker,
+        Main
+    };
+
+private:
+    struct Task
+    {
+        std::string name;
+        std::function<bool()> work;
+        Affinity affinity;
+        std::vector<TaskId> dependents;
+        unsigned int pendingDependencies = 0;
+        bool done = false;
+        uint64_t start = 0;
+        uint64_t end = 0;
+    };
+
+    // a deque so tasks keep their address while more get added from inside running tasks
+    std::deque<Task> tasks;
+    std::deque<TaskId> workerQueue;
+    std::deque<TaskId> mainQueue;
+    size_t unfinished;
+    bool failed;
+    bool stopping;
+    uint64_t runStart;
+    uint64_t runEnd;
+    std::mutex mutex;
+    std::condition_variable workerCond;
+    std::condition_variable mainCond;
+
+    void enqueue(TaskId id);
+    void execute(Task& task, TaskId id);
+    void workerLoop();
+public:
+    TaskGraph();
+
+    /// @brief Add a task, also allowed from inside a running task
+    /// @param name shown in the timing report
+    /// @param work returns false to abort the whole graph
+    /// @param dependencies tasks that have to finish first, all of which must already have been added
+    /// @param affinity Main for work that has to stay on the thread calling run()
+    TaskId add(const std::string& name, std::function<bool()> work, const std::vector<TaskId>& dependencies = {}, Affinity affinity = Affinity::Worker);
+
+    /// @brief Run every task to completion, blocking until done
+    /// @return false if any task failed, in which case tasks not yet started are skipped
+    bool run(unsigned int workerCount);
+
+    /// @brief Log how long each task took and the wall-clock time of the whole run
+    void report(const char* title) const;
+};
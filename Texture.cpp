@@ -1,39 +1,41 @@
 #include "Texture.h"
 #include <iostream>
 #include "GameWindow.h"
-#include <SDL2/SDL_image.h>
+#include "Renderer.h"
 #include <SDL_rect.h>
 
-Texture::Texture(SDL_Renderer* renderer, SDL_Texture *texture, SDL_Point& size) : 
+Texture::Texture(Renderer& renderer, SDL_Texture *texture, SDL_Point& size) : 
     renderer(renderer),
     texture(texture),
     m_size(size)
 {
 }
 
-Texture *Texture::Create(SDL_Renderer* renderer, std::string filename)
+Texture *Texture::Create(Renderer& renderer, std::string filename)
 {
-    SDL_Texture* texture = IMG_LoadTexture(renderer, filename.c_str());
-    if(!texture)
+    SDL_Texture* texture = nullptr;
+    SDL_Point sizeTmp;
+    if (!renderer.loadTexture(filename, texture, sizeTmp))
     {
-        SDL_Log("Failed to create texture: %s", SDL_GetError());
         return nullptr;
     }
+    return new Texture(renderer, texture, sizeTmp);
+}
+
+Texture *Texture::Create(Renderer& renderer, SDL_Surface *surface)
+{
+    SDL_Texture* texture = nullptr;
     SDL_Point sizeTmp;
-    if (SDL_QueryTexture(texture, NULL, NULL, &sizeTmp.x, &sizeTmp.y) != 0)
+    if (!renderer.createTexture(surface, texture, sizeTmp))
     {
-        SDL_Log("Failed to query texture size: %s", SDL_GetError());
-        SDL_DestroyTexture(texture);
         return nullptr;
     }
-    
-
     return new Texture(renderer, texture, sizeTmp);
 }
 
 Texture::~Texture()
 {
-    SDL_DestroyTexture(texture);
+    renderer.destroyTexture(texture);
 }
 
 void Texture::draw(int x, int y, int w, int h, SDL_RendererFlip flip)
@@ -41,7 +43,7 @@ void Texture::draw(int x, int y, int w, int h, SDL_RendererFlip flip)
     SDL_Rect srcRect = {0, 0, w, h};
     SDL_Rect destRect = {x, y, w, h};
 
-    SDL_RenderCopyEx(renderer, texture, &srcRect, &destRect, 0.0, NULL, flip);
+    renderer.copy(texture, srcRect, destRect, flip);
 }
 
 void Texture::draw(int srcX, int srcY, int destX, int destY, int w, int h, SDL_RendererFlip flip)
@@ -49,5 +51,5 @@ void Texture::draw(int srcX, int srcY, int destX, int destY, int w, int h, SDL_R
     SDL_Rect srcRect = {srcX, srcY, w, h};
     SDL_Rect destRect = {destX, destY, w, h};
 
-    SDL_RenderCopyEx(renderer, texture, &srcRect, &destRect, 0.0, NULL, flip);
+    renderer.copy(texture, srcRect, destRect, flip);
 }
\ No newline at end of file
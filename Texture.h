@@ -5,12 +5,14 @@
 
 class Texture final
 {
-    struct SDL_Renderer* renderer;
+    class Renderer& renderer;
     struct SDL_Texture *texture;
     SDL_Point m_size;
-    Texture(SDL_Renderer* renderer, SDL_Texture *texture, SDL_Point& size);
+    Texture(Renderer& renderer, SDL_Texture *texture, SDL_Point& size);
 public:
-    static Texture *Create(SDL_Renderer* renderer, std::string filename);
+    static Texture *Create(Renderer& renderer, std::string filename);
+    // the surface stays owned by the caller
+    static Texture *Create(Renderer& renderer, struct SDL_Surface *surface);
 
     Texture(const Texture&) = delete;
     Texture(Texture&&) = delete;
@@ -24,4 +26,4 @@ public:
 
     void draw(int x, int y, int w, int h, SDL_RendererFlip flip = SDL_FLIP_NONE);
     void draw(int srcX, int srcY, int destX, int destY, int w, int h, SDL_RendererFlip flip = SDL_FLIP_NONE);
-};
\ No newline at end of file
+};
@@ -0,0 +1,156 @@
+#include "TextureRegistry.h"
+#include "Texture.h"
+#include "Renderer.h"
+#include "Assets.h"
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <filesystem>
+
+TextureRegistry::TextureRegistry(Renderer& renderer, size_t budgetBytes) :
+    renderer(renderer),
+    budgetBytes(budgetBytes),
+    useCounter(0)
+{
+}
+
+TextureRegistry::~TextureRegistry()
+{
+    // anything still holding a handle keeps its texture, but it has to let go before the renderer goes
+    entries.clear();
+}
+
+std::string TextureRegistry::CanonicalPath(const std::string& path)
+{
+    std::error_code error;
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+    if (error) {
+        return std::filesystem::path(path).lexically_normal().generic_string();
+    }
+    return canonical.generic_string();
+}
+
+bool TextureRegistry::Decode(const std::string& path, bool decodePixels, DecodedImage& image)
+{
+    std::string data;
+    if (!Assets::ReadFile(path, data) || data.empty()) {
+        SDL_Log("Failed to read image %s: %s", path.c_str(), SDL_GetError());
+        return false;
+    }
+
+    // FNV-1a, plenty to tell apart the handful of images a level uses
+    uint64_t hash = 14695981039346656037ull;
+    for (char byte : data) {
+        hash = (hash ^ Uint8(byte)) * 1099511628211ull;
+    }
+    image.contentHash = hash;
+    image.surface = nullptr;
+    if (decodePixels) {
+        image.surface = IMG_Load_RW(SDL_RWFromConstMem(data.data(), int(data.size())), 1);
+        if (image.surface == nullptr) {
+            SDL_Log("Failed to decode image %s: %s", path.c_str(), SDL_GetError());
+            return false;
+        }
+    }
+    return true;
+}
+
+std::shared_ptr<Texture> TextureRegistry::acquire(const std::string& path)
+{
+    const std::string canonical = CanonicalPath(path);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto pathIt = pathHashes.find(canonical);
+        if (pathIt != pathHashes.end()) {
+            auto entryIt = entries.find(pathIt->second);
+            if (entryIt != entries.end()) {
+                stats.hits++;
+                entryIt->second.lastUsed = ++useCounter;
+                return entryIt->second.texture;
+            }
+        }
+    }
+    DecodedImage image;
+    if (!Decode(path, !renderer.isHeadless(), image)) {
+        return nullptr;
+    }
+    std::shared_ptr<Texture> texture = acquire(path, image);
+    SDL_FreeSurface(image.surface);
+    return texture;
+}
+
+std::shared_ptr<Texture> TextureRegistry::acquire(const std::string& path, const DecodedImage& image)
+{
+    const std::string canonical = CanonicalPath(path);
+    std::lock_guard<std::mutex> lock(mutex);
+    pathHashes[canonical] = image.contentHash;
+    auto entryIt = entries.find(image.contentHash);
+    if (entryIt != entries.end()) {
+        stats.hits++;
+        entryIt->second.lastUsed = ++useCounter;
+        return entryIt->second.texture;
+    }
+
+    // without decoded pixels the renderer only wants the file for its size
+    Texture* texture = image.surface != nullptr ? Texture::Create(renderer, image.surface) : Texture::Create(renderer, path);
+    if (texture == nullptr) {
+        return nullptr;
+    }
+    Entry& entry = entries[image.contentHash];
+    entry.texture.reset(texture);
+    entry.bytes = size_t(texture->getSize().x) * size_t(texture->getSize().y) * 4;
+    entry.lastUsed = ++useCounter;
+    stats.loads++;
+    stats.residentBytes += entry.bytes;
+    std::shared_ptr<Texture> handle = entry.texture;
+    if (stats.residentBytes > budgetBytes) {
+        evictUnreferenced(budgetBytes);
+    }
+    return handle;
+}
+
+void TextureRegistry::evictUnreferenced(size_t targetBytes)
+{
+    while (stats.residentBytes > targetBytes) {
+        auto lru = entries.end();
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            // the registry's own reference is the only one left
+            if (it->second.texture.use_count() == 1 && (lru == entries.end() || it->second.lastUsed < lru->second.lastUsed)) {
+                lru = it;
+            }
+        }
+        if (lru == entries.end()) {
+            break;
+        }
+        stats.residentBytes -= lru->second.bytes;
+        stats.evictions++;
+        entries.erase(lru);
+    }
+}
+
+void TextureRegistry::trim()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    evictUnreferenced(budgetBytes);
+}
+
+TextureRegistry::Stats TextureRegistry::getStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats current = stats;
+    current.residentTextures = entries.size();
+    current.referencedBytes = 0;
+    for (const auto& [hash, entry] : entries) {
+        if (entry.texture.use_count() > 1) {
+            current.referencedBytes += entry.bytes;
+        }
+    }
+    return current;
+}
+
+void TextureRegistry::logStats()
+{
+    Stats current = getStats();
+    SDL_Log("Textures: %zu resident (%zu KB, %zu KB referenced, budget %zu KB), %zu loads, %zu hits, %zu evictions",
+        current.residentTextures, current.residentBytes / 1024, current.referencedBytes / 1024, budgetBytes / 1024,
+        current.loads, current.hits, current.evictions);
+}
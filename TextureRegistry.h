@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/// @brief Hands out shared texture handles so every image is decoded and uploaded once, however many
+/// actors or layers use it. Textures are keyed by canonical path and by a hash of the file contents,
+/// so identical copies of an image under different names share one texture too
+class TextureRegistry
+{
+public:
+    /// @brief An image read and decoded off the renderer thread, ready to be handed to acquire()
+    struct DecodedImage
+    {
+        uint64_t contentHash = 0;
+        // nullptr when only the hash was wanted, e.g. without a display
+        struct SDL_Surface* surface = nullptr;
+    };
+
+    struct Stats
+    {
+        // textures decoded and uploaded, counting reloads after eviction
+        size_t loads = 0;
+        // acquires served from an already resident texture
+        size_t hits = 0;
+        size_t evictions = 0;
+        size_t residentTextures = 0;
+        size_t residentBytes = 0;
+        // bytes of resident textures that something still holds a handle to
+        size_t referencedBytes = 0;
+    };
+
+private:
+    struct Entry
+    {
+        std::shared_ptr<class Texture> texture;
+        size_t bytes = 0;
+        uint64_t lastUsed = 0;
+    };
+
+    class Renderer& renderer;
+    size_t budgetBytes;
+    uint64_t useCounter;
+    Stats stats;
+    std::mutex mutex;
+    // canonical path to content hash; kept after eviction so a reload doesn't have to re-canonicalize
+    std::unordered_map<std::string, uint64_t> pathHashes;
+    std::unordered_map<uint64_t, Entry> entries;
+
+    void evictUnreferenced(size_t targetBytes);
+public:
+    TextureRegistry(class Renderer& renderer, size_t budgetBytes);
+    ~TextureRegistry();
+
+    static std::string CanonicalPath(const std::string& path);
+    /// @brief Read and hash an image file, decoding it unless decodePixels is false. Safe to call from any thread
+    static bool Decode(const std::string& path, bool decodePixels, DecodedImage& image);
+
+    /// @brief Get the texture for an image file, loading it if it isn't resident. Must be called on the renderer thread
+    std::shared_ptr<class Texture> acquire(const std::string& path);
+    /// @brief Same as acquire(path), but with the file already read and decoded. The surface stays owned by the caller
+    std::shared_ptr<class Texture> acquire(const std::string& path, const DecodedImage& image);
+
+    /// @brief Release textures nothing holds a handle to anymore, least recently used first, until back under budget
+    void trim();
+
+    Stats getStats();
+    void logStats();
+};
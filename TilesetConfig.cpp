@@ -1,18 +1,56 @@
 #include "TilesetConfig.h"
 #include <cJSON/cJSON.h>
-#include <fstream>
+#include "Assets.h"
+#include "MappedFile.h"
+#include "StateHash.h"
+#include <SDL2/SDL_log.h>
+#include <filesystem>
+#include <memory>
 #include <cstring>
 
-TileType TilesetConfig::getTileType(int tileId)
+const char TilesetConfig::Magic[8] = { 'S', 'F', 'F', 'T', 'S', 'C', '\0', '\0' };
+
+namespace
 {
-    TileType tileType = TileType::None;
-    std::unordered_map<int, TileType>::iterator it = mapTileData.find(tileId);
-    if (it != mapTileData.end()) {
-        tileType = it->second;
+    struct BinaryHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t tileTypeCount;
+        uint32_t objectCount;
+        uint32_t reserved;
+        // size and SourceHash of the JSON compiled from
+        uint64_t sourceLength;
+        uint64_t sourceHash;
+    };
+
+    // followed by rowCount row lengths, tileCount tile ids, then the name and type name, padded to 4 bytes
+    struct BinaryObject
+    {
+        uint32_t nameLength;
+        uint32_t typeLength;
+        uint32_t rowCount;
+        uint32_t tileCount;
+        float bounds[6];
+    };
+
+    size_t padded(size_t length)
+    {
+        return (length + 3) & ~size_t(3);
     }
-    return tileType;
 }
 
+void TilesetConfig::setTileType(int tileId, TileType tileType)
+{
+    if (tileId < 0 || tileId > MaxTileId) {
+        SDL_Log("Ignoring out of range tile id %d", tileId);
+        return;
+    }
+    if (tileTypes.size() <= size_t(tileId)) {
+        tileTypes.resize(size_t(tileId) + 1, TileType::None);
+    }
+    tileTypes[tileId] = tileType;
+}
 
 tripoint readTripoint(cJSON* tripointObj)
 {
@@ -45,8 +83,17 @@ cuboid readBounds(cJSON* boundsObj)
     return output;
 }
 
-TilesetConfig::TilesetConfig(cJSON *json)
+bool TilesetConfig::parseJson(const char* data, size_t length)
 {
+    // the data isn't null-terminated, so the parser has to be told where it ends
+    cJSON* json = cJSON_ParseWithLength(data, length);
+    if (json == nullptr) {
+        return false;
+    }
+    else if (json->child == nullptr) {
+        cJSON_Delete(json);
+        return false;
+    }
     for (cJSON* childJson = json->child; childJson != nullptr; childJson = childJson->next) {
         if (strcmp(childJson->string, "predefinedBasicTiles") == 0) {
 
@@ -65,34 +112,35 @@ TilesetConfig::TilesetConfig(cJSON *json)
                     typeToSet = TileType::Box;
                 }
                 for (cJSON* tileIds = predefinedTileObj->child; tileIds != nullptr; tileIds = tileIds->next) {
-                    mapTileData[tileIds->valueint] = typeToSet;
+                    setTileType(tileIds->valueint, typeToSet);
                 }
             }
         }
         else if (strcmp(childJson->string, "predefinedAngledTiles") == 0) {
             for (cJSON* predefinedTileObj = childJson->child; predefinedTileObj != nullptr; predefinedTileObj = predefinedTileObj->next) {
-                std::vector<TileType> tileTypes;
+                std::vector<TileType> angledTypes;
                 if (strcmp(predefinedTileObj->string, "angledSideWall") == 0) {
-                    tileTypes = { TileType::SideWallAngled1, TileType::SideWallAngled2, TileType::SideWallAngled3, TileType::SideWallAngled4 };
+                    angledTypes = { TileType::SideWallAngled1, TileType::SideWallAngled2, TileType::SideWallAngled3, TileType::SideWallAngled4 };
                 }
                 else if (strcmp(predefinedTileObj->string, "angledGround") == 0) {
-                    tileTypes = { TileType::GroundAngled1, TileType::GroundAngled2, TileType::GroundAngled3, TileType::GroundAngled4 };
+                    angledTypes = { TileType::GroundAngled1, TileType::GroundAngled2, TileType::GroundAngled3, TileType::GroundAngled4 };
                 }
                 for (cJSON* tileIdArrays = predefinedTileObj->child; tileIdArrays != nullptr; tileIdArrays = tileIdArrays->next) {
-                    auto tileType = tileTypes.begin();
-                    for (cJSON* tileId = tileIdArrays->child; tileId != nullptr && tileType != tileTypes.end(); tileId = tileId->next, tileType++) {
+                    auto tileType = angledTypes.begin();
+                    for (cJSON* tileId = tileIdArrays->child; tileId != nullptr && tileType != angledTypes.end(); tileId = tileId->next, tileType++) {
                         if (tileId->valueint != 0) {
-                            mapTileData[tileId->valueint] = *tileType;
+                            setTileType(tileId->valueint, *tileType);
                         }
                     }
                 }
             }
         } else if (strcmp(childJson->string, "customTiles") == 0) {
 
-        } else if (strcmp(childJson->string, "customObjects")) {
+        } else if (strcmp(childJson->string, "customObjects") == 0) {
             for (cJSON* customObj = childJson->child; customObj != nullptr; customObj = customObj->next) {
                 char* tileName = customObj->string;
                 CustomTileObject cto;
+                cto.objectName = tileName;
                 cto.typeName = tileName;
                 for (cJSON* customObjAttr = customObj->child; customObjAttr != nullptr; customObjAttr = customObjAttr->next) {
                     if (strcmp(customObjAttr->string, "tileIds") == 0) {
@@ -104,56 +152,251 @@ TilesetConfig::TilesetConfig(cJSON *json)
                         }
                     } else if (strcmp(customObjAttr->string, "bounds") == 0) {
                         cto.bounds = readBounds(customObjAttr);
-                    } else if (strcmp(customObjAttr->string, "type") == 0) {
+                    } else if (strcmp(customObjAttr->string, "type") == 0 && cJSON_IsString(customObjAttr)) {
                         cto.typeName = customObjAttr->valuestring;
                     }
                 }
-                customObjects.push_back(cto);
+                if (!cto.tileIds.empty() && !cto.tileIds[0].empty()) {
+                    customObjects.push_back(cto);
+                }
             }
         }
     }
+    cJSON_Delete(json);
+    indexObjects();
+    return true;
 }
 
-const CustomTileObject* TilesetConfig::tryParseObject(int topLeftTileId)
+void TilesetConfig::indexObjects()
+{
+    objectsByTopLeft.clear();
+    for (uint32_t i = 0; i < customObjects.size(); i++) {
+        objectsByTopLeft[customObjects[i].tileIds[0][0]].push_back(i);
+    }
+}
+
+void TilesetConfig::serialize(std::vector<char>& out) const
 {
-    for (const auto& objTmp : customObjects) {
-        if (objTmp.tileIds[0][0] == topLeftTileId) {
-            return &objTmp;
+    BinaryHeader header{};
+    memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.tileTypeCount = uint32_t(tileTypes.size());
+    header.objectCount = uint32_t(customObjects.size());
+    header.sourceLength = sourceLength;
+    header.sourceHash = sourceHash;
+    auto append = [&out](const void* data, size_t length) {
+        out.insert(out.end(), static_cast<const char*>(data), static_cast<const char*>(data) + length);
+    };
+    auto pad = [&out]() {
+        out.resize(padded(out.size()), '\0');
+    };
+    out.clear();
+    append(&header, sizeof(header));
+    append(tileTypes.data(), tileTypes.size());
+    pad();
+    for (const CustomTileObject& object : customObjects) {
+        BinaryObject binaryObject{};
+        binaryObject.nameLength = uint32_t(object.objectName.size());
+        binaryObject.typeLength = uint32_t(object.typeName.size());
+        binaryObject.rowCount = uint32_t(object.tileIds.size());
+        for (const auto& row : object.tileIds) {
+            binaryObject.tileCount += uint32_t(row.size());
         }
+        const cuboid& bounds = object.bounds;
+        const float values[6] = { bounds.p1.x, bounds.p1.y, bounds.p1.z, bounds.p2.x, bounds.p2.y, bounds.p2.z };
+        memcpy(binaryObject.bounds, values, sizeof(values));
+        append(&binaryObject, sizeof(binaryObject));
+        for (const auto& row : object.tileIds) {
+            const uint32_t rowLength = uint32_t(row.size());
+            append(&rowLength, sizeof(rowLength));
+        }
+        for (const auto& row : object.tileIds) {
+            for (int tileId : row) {
+                const int32_t value = tileId;
+                append(&value, sizeof(value));
+            }
+        }
+        append(object.objectName.data(), object.objectName.size());
+        append(object.typeName.data(), object.typeName.size());
+        pad();
     }
-    return nullptr;
 }
 
-size_t getFileLength(std::ifstream& file)
+bool TilesetConfig::parseBinary(const uint8_t* data, size_t length)
 {
-    file.seekg(0, std::ios::end);
-    size_t length = file.tellg();
-    file.seekg(0, std::ios::beg);
-    return length;
+    BinaryHeader header;
+    if (length < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version || header.tileTypeCount > uint32_t(MaxTileId) + 1 ||
+        length - sizeof(header) < header.tileTypeCount) {
+        return false;
+    }
+    sourceLength = header.sourceLength;
+    sourceHash = header.sourceHash;
+    size_t offset = sizeof(header);
+    // TileType is a byte, so the array copies over as it is once every value in it is known to be one
+    for (size_t i = 0; i < header.tileTypeCount; i++) {
+        if (data[offset + i] > uint8_t(TileType::SideWallAngled4)) {
+            return false;
+        }
+    }
+    tileTypes.resize(header.tileTypeCount);
+    memcpy(tileTypes.data(), data + offset, header.tileTypeCount);
+    offset = padded(offset + header.tileTypeCount);
+
+    // every object takes at least a BinaryObject, which bounds the count before anything is allocated for it
+    if (header.objectCount > length / sizeof(BinaryObject)) {
+        return false;
+    }
+    customObjects.resize(header.objectCount);
+    for (CustomTileObject& object : customObjects) {
+        BinaryObject binaryObject;
+        if (offset > length || length - offset < sizeof(binaryObject)) {
+            return false;
+        }
+        memcpy(&binaryObject, data + offset, sizeof(binaryObject));
+        offset += sizeof(binaryObject);
+        const uint64_t bodySize = uint64_t(binaryObject.rowCount) * sizeof(uint32_t) + uint64_t(binaryObject.tileCount) * sizeof(int32_t) +
+            binaryObject.nameLength + binaryObject.typeLength;
+        if (binaryObject.rowCount == 0 || bodySize > length - offset) {
+            return false;
+        }
+        const uint8_t* rowLengths = data + offset;
+        const uint8_t* tileIds = rowLengths + size_t(binaryObject.rowCount) * sizeof(uint32_t);
+        uint32_t tilesLeft = binaryObject.tileCount;
+        object.tileIds.resize(binaryObject.rowCount);
+        for (auto& row : object.tileIds) {
+            uint32_t rowLength;
+            memcpy(&rowLength, rowLengths, sizeof(rowLength));
+            rowLengths += sizeof(rowLength);
+            if (rowLength > tilesLeft) {
+                return false;
+            }
+            tilesLeft -= rowLength;
+            row.resize(rowLength);
+            for (int& tileId : row) {
+                int32_t value;
+                memcpy(&value, tileIds, sizeof(value));
+                tileIds += sizeof(value);
+                tileId = value;
+            }
+        }
+        // objects are indexed by their first tile, so there has to be one
+        if (tilesLeft != 0 || object.tileIds[0].empty()) {
+            return false;
+        }
+        const char* names = reinterpret_cast<const char*>(tileIds);
+        object.objectName.assign(names, binaryObject.nameLength);
+        object.typeName.assign(names + binaryObject.nameLength, binaryObject.typeLength);
+        const float* bounds = binaryObject.bounds;
+        object.bounds = { { bounds[0], bounds[1], bounds[2] }, { bounds[3], bounds[4], bounds[5] } };
+        offset = padded(offset + size_t(bodySize));
+    }
+    if (offset != length) {
+        return false;
+    }
+    indexObjects();
+    return true;
+}
+
+const CustomTileObject* TilesetConfig::tryParseObject(int topLeftTileId)
+{
+    const std::vector<uint32_t>* candidates = getObjectCandidates(topLeftTileId);
+    return candidates != nullptr ? &customObjects[candidates->front()] : nullptr;
+}
+
+const std::vector<uint32_t>* TilesetConfig::getObjectCandidates(int topLeftTileId) const
+{
+    auto it = objectsByTopLeft.find(topLeftTileId);
+    return it != objectsByTopLeft.end() ? &it->second : nullptr;
+}
+
+std::string TilesetConfig::CompiledPath(const std::string& jsonPath)
+{
+    size_t extension = jsonPath.rfind(".json");
+    return (extension == std::string::npos ? jsonPath : jsonPath.substr(0, extension)) + ".tsc";
+}
+
+uint64_t TilesetConfig::SourceHash(const void* data, size_t length)
+{
+    return HashBytes(data, length, StateHashStream::Seed);
 }
 
 TilesetConfig* TilesetConfig::Create(std::string path)
 {
-    std::ifstream jsonFile(path, std::ios::in);
-    if (!jsonFile.is_open()) {
+    const std::string compiledPath = CompiledPath(path);
+    size_t compiledSize = 0;
+    // the packer compiles the pack's copy from the JSON it packs alongside, so that one is taken as it is
+    if (const uint8_t* compiled = Assets::GetInPlace(compiledPath, compiledSize)) {
+        if (TilesetConfig* tscfg = FromBinary(compiled, compiledSize)) {
+            return tscfg;
+        }
+        SDL_Log("Ignoring corrupt %s", compiledPath.c_str());
+    }
+    std::string fileData;
+    if (std::unique_ptr<MappedFile> mapping{ MappedFile::Open(compiledPath) }) {
+        std::unique_ptr<TilesetConfig> tscfg(FromBinary(mapping->getData(), mapping->getSize()));
+        if (tscfg != nullptr && !tscfg->isStale(path, compiledPath, fileData)) {
+            return tscfg.release();
+        }
+        SDL_Log("Ignoring %s %s", tscfg != nullptr ? "stale" : "corrupt", compiledPath.c_str());
+    }
+
+    if (fileData.empty() && !Assets::ReadFile(path, fileData)) {
+        SDL_Log("Failed to read tileset config %s", path.c_str());
         return nullptr;
     }
+    TilesetConfig* tscfg = FromJson(fileData.data(), fileData.size());
+    if (tscfg == nullptr) {
+        SDL_Log("Failed to parse tileset config %s", path.c_str());
+    }
+    return tscfg;
+}
 
-    size_t len = getFileLength(jsonFile);
-    char* fileData = new char[len];
-    jsonFile.read(fileData, len);
-    jsonFile.close();
+bool TilesetConfig::isStale(const std::string& jsonPath, const std::string& compiledPath, std::string& json) const
+{
+    namespace fs = std::filesystem;
+    std::error_code error;
+    const uintmax_t jsonSize = fs::file_size(jsonPath, error);
+    if (!error) {
+        if (jsonSize != sourceLength) {
+            return true;
+        }
+        // the same size and not written since it was compiled is as good as the same
+        std::error_code compiledError;
+        const fs::file_time_type jsonTime = fs::last_write_time(jsonPath, error);
+        const fs::file_time_type compiledTime = fs::last_write_time(compiledPath, compiledError);
+        if (!error && !compiledError && jsonTime <= compiledTime) {
+            return false;
+        }
+    }
+    // a compiled form shipped without its JSON is taken as it is
+    if (!Assets::ReadFile(jsonPath, json)) {
+        return false;
+    }
+    return json.size() != sourceLength || SourceHash(json.data(), json.size()) != sourceHash;
+}
 
-    cJSON* json = cJSON_Parse(fileData);
-    delete[] fileData;
-    if (json == nullptr) {
+TilesetConfig* TilesetConfig::FromJson(const char* data, size_t length)
+{
+    TilesetConfig* tscfg = new TilesetConfig();
+    if (!tscfg->parseJson(data, length)) {
+        delete tscfg;
         return nullptr;
     }
-    else if (json->child == nullptr) {
-        cJSON_Delete(json);
+    tscfg->sourceLength = length;
+    tscfg->sourceHash = SourceHash(data, length);
+    return tscfg;
+}
+
+TilesetConfig* TilesetConfig::FromBinary(const uint8_t* data, size_t length)
+{
+    TilesetConfig* tscfg = new TilesetConfig();
+    if (!tscfg->parseBinary(data, length)) {
+        delete tscfg;
         return nullptr;
     }
-    TilesetConfig* tscfg = new TilesetConfig(json);
-    cJSON_Delete(json);
     return tscfg;
-}
\ No newline at end of file
+}
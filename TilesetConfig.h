@@ -1,9 +1,12 @@
+#pragma once
+
+#include <cstdint>
 #include <unordered_map>
 #include <string>
 #include <vector>
 #include "Geometry.h"
 
-enum class TileType
+enum class TileType : uint8_t
 {
     None,
     Ground,
@@ -24,18 +27,61 @@ struct CustomTileObject
 {
     std::string objectName;
     std::string typeName;
+    // rows of tileset tile ids the object is drawn with, top row first
     std::vector<std::vector<int>> tileIds;
+    // relative to the real position of its top left tile
     cuboid bounds;
 };
 
+/// @brief What each tile of a tileset is, and the multi-tile objects drawn with it. Tile types are a dense
+/// array indexed by tile id. Loaded from the compiled form (same path with .tsc for .json) when there is
+/// one, which is the array and the objects behind a small header and needs no parsing. The header records
+/// the size and hash of the JSON it was compiled from, so one that's out of date with its JSON isn't used
 class TilesetConfig
 {
+public:
+    static const uint32_t Version = 2;
+    static const char Magic[8];
+    // tile ids past this are ignored rather than growing the array without bound
+    static const int MaxTileId = 1 << 20;
 
-    std::unordered_map<int, TileType> mapTileData;
+private:
+    std::vector<TileType> tileTypes;
     std::vector<CustomTileObject> customObjects;
+    // indices into customObjects by the id of their top left tile
+    std::unordered_map<int, std::vector<uint32_t>> objectsByTopLeft;
+    // the JSON this was parsed or compiled from
+    uint64_t sourceLength = 0;
+    uint64_t sourceHash = 0;
+
+    TilesetConfig() = default;
+    void setTileType(int tileId, TileType tileType);
+    bool parseJson(const char* data, size_t length);
+    bool parseBinary(const uint8_t* data, size_t length);
+    void indexObjects();
+    // whether the loose JSON has changed since this was compiled from it; json receives it if it had to be read
+    bool isStale(const std::string& jsonPath, const std::string& compiledPath, std::string& json) const;
 public:
-    TilesetConfig(struct cJSON *json);
-    TileType getTileType(int tileId);
-    const CustomTileObject* tryParseObject(int topLeftTileId);
+    /// @brief Load a tileset config, preferring its compiled form, used in place from the asset pack or a
+    /// mapping of the loose file, and falling back to parsing the JSON. A loose compiled form is only used while
+    /// its JSON hasn't changed, which its size and modification time settle without reading it
     static TilesetConfig* Create(std::string path);
-};
\ No newline at end of file
+    static TilesetConfig* FromJson(const char* data, size_t length);
+    static TilesetConfig* FromBinary(const uint8_t* data, size_t length);
+    static std::string CompiledPath(const std::string& jsonPath);
+    // what the compiled form records of the JSON it was compiled from, to tell when it's out of date
+    static uint64_t SourceHash(const void* data, size_t length);
+
+    /// @brief The compiled form, which FromBinary reads back, stamped with the JSON FromJson parsed
+    void serialize(std::vector<char>& out) const;
+
+    TileType getTileType(int tileId) const
+    {
+        return tileId >= 0 && size_t(tileId) < tileTypes.size() ? tileTypes[tileId] : TileType::None;
+    }
+    const CustomTileObject* tryParseObject(int topLeftTileId);
+    // every custom object whose top left tile is topLeftTileId, nullptr if there are none
+    const std::vector<uint32_t>* getObjectCandidates(int topLeftTileId) const;
+    const CustomTileObject& getObject(uint32_t index) const { return customObjects[index]; }
+    size_t getObjectCount() const { return customObjects.size(); }
+};
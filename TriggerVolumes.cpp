@@ -0,0 +1,201 @@
+#include "TriggerVolumes.h"
+#include "Collectibles.h"
+#include <SDL2/SDL_log.h>
+#include <tmxlite/Map.hpp>
+#include <tmxlite/ObjectGroup.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+TriggerVolumes::TriggerVolumes() :
+    loadedCount(0),
+    columns(0),
+    rows(0)
+{
+}
+
+void TriggerVolumes::load(const tmx::Map& map)
+{
+    triggers.clear();
+    pointList.clear();
+    const tmx::Vector2u& tileSize = map.getTileSize();
+    size_t skipped = 0;
+    for (const auto& layer : map.getLayers()) {
+        if (layer->getType() != tmx::Layer::Type::Object || layer->getName() == Collectibles::LayerName) {
+            continue;
+        }
+        for (const tmx::Object& object : layer->getLayerAs<tmx::ObjectGroup>().getObjects()) {
+            Trigger trigger{ object.getName(), layer->getName(), object.getClass(), std::numeric_limits<float>::lowest(),
+                std::numeric_limits<float>::max(), 0.f, 0.f, 0.f, 0.f, uint32_t(pointList.size()), 0 };
+            if (object.getShape() == tmx::Object::Shape::Rectangle) {
+                const tmx::FloatRect& bounds = object.getAABB();
+                trigger.left = bounds.left / tileSize.x;
+                trigger.top = bounds.top / tileSize.y;
+                trigger.right = (bounds.left + bounds.width) / tileSize.x;
+                trigger.bottom = (bounds.top + bounds.height) / tileSize.y;
+            } else if (object.getShape() == tmx::Object::Shape::Polygon && object.getPoints().size() >= 3) {
+                // polygon points are relative to the object's position
+                const tmx::Vector2f& origin = object.getPosition();
+                trigger.left = trigger.top = std::numeric_limits<float>::max();
+                trigger.right = trigger.bottom = std::numeric_limits<float>::lowest();
+                for (const tmx::Vector2f& point : object.getPoints()) {
+                    const MapPoint mapPoint{ (origin.x + point.x) / tileSize.x, (origin.y + point.y) / tileSize.y };
+                    trigger.left = std::min(trigger.left, mapPoint.x);
+                    trigger.top = std::min(trigger.top, mapPoint.y);
+                    trigger.right = std::max(trigger.right, mapPoint.x);
+                    trigger.bottom = std::max(trigger.bottom, mapPoint.y);
+                    pointList.push_back(mapPoint);
+                }
+                trigger.pointCount = uint32_t(object.getPoints().size());
+            } else {
+                skipped++;
+                continue;
+            }
+            float depth = -1.f;
+            for (const tmx::Property& property : object.getProperties()) {
+                const float value = property.getType() == tmx::Property::Type::Int ? float(property.getIntValue()) : property.getFloatValue();
+                if (property.getName() == "z") {
+                    trigger.z1 = value;
+                } else if (property.getName() == "depth") {
+                    depth = value;
+                }
+            }
+            if (depth >= 0.f) {
+                trigger.z1 = std::max(trigger.z1, 0.f);
+                trigger.z2 = trigger.z1 + depth;
+            }
+            triggers.push_back(std::move(trigger));
+        }
+    }
+    loadedCount = triggers.size();
+    buildGrid(float(map.getTileCount().x), float(map.getTileCount().y));
+    SDL_Log("Loaded %zu triggers, skipped %zu objects that aren't rectangles or polygons", triggers.size(), skipped);
+}
+
+void TriggerVolumes::addBoxes(std::vector<Trigger>& boxes)
+{
+    if (boxes.empty()) {
+        return;
+    }
+    for (Trigger& box : boxes) {
+        box.firstPoint = uint32_t(pointList.size());
+        box.pointCount = 0;
+        triggers.push_back(std::move(box));
+    }
+    // the grid already covers the whole map, so filing it again keeps its size
+    buildGrid(float(columns) * CellSize, float(rows) * CellSize);
+}
+
+void TriggerVolumes::clearAdded()
+{
+    if (triggers.size() == loadedCount) {
+        return;
+    }
+    triggers.resize(loadedCount);
+    for (std::vector<uint32_t>& entityInside : inside) {
+        entityInside.erase(std::lower_bound(entityInside.begin(), entityInside.end(), uint32_t(loadedCount)), entityInside.end());
+    }
+    buildGrid(float(columns) * CellSize, float(rows) * CellSize);
+}
+
+void TriggerVolumes::buildGrid(float mapWidth, float mapHeight)
+{
+    columns = size_t(std::ceil(mapWidth / CellSize));
+    rows = size_t(std::ceil(mapHeight / CellSize));
+    cellStart.assign(columns * rows + 1, 0);
+    cellTriggers.clear();
+    if (columns == 0 || rows == 0) {
+        return;
+    }
+    // the cells each trigger's box covers, clipped to the map
+    auto forEachCell = [this](const Trigger& trigger, auto&& visit) {
+        if (trigger.right < 0.f || trigger.bottom < 0.f) {
+            return;
+        }
+        const size_t x1 = size_t(std::max(trigger.left, 0.f) / CellSize), x2 = std::min(size_t(trigger.right / CellSize), columns - 1);
+        const size_t y1 = size_t(std::max(trigger.top, 0.f) / CellSize), y2 = std::min(size_t(trigger.bottom / CellSize), rows - 1);
+        for (size_t y = y1; y <= y2; y++) {
+            for (size_t x = x1; x <= x2; x++) {
+                visit(y * columns + x);
+            }
+        }
+    };
+    for (const Trigger& trigger : triggers) {
+        forEachCell(trigger, [this](size_t cell) { cellStart[cell + 1]++; });
+    }
+    for (size_t cell = 0; cell < columns * rows; cell++) {
+        cellStart[cell + 1] += cellStart[cell];
+    }
+    cellTriggers.resize(cellStart.back());
+    // filled in trigger order, so every cell's list comes out sorted
+    std::vector<uint32_t> fill(cellStart.begin(), cellStart.end() - 1);
+    for (uint32_t i = 0; i < triggers.size(); i++) {
+        forEachCell(triggers[i], [&](size_t cell) { cellTriggers[fill[cell]++] = i; });
+    }
+}
+
+bool TriggerVolumes::contains(const Trigger& trigger, float mapX, float mapY, float z) const
+{
+    if (z < trigger.z1 || z > trigger.z2 || mapX < trigger.left || mapX >= trigger.right || mapY < trigger.top || mapY >= trigger.bottom) {
+        return false;
+    }
+    // count the outline's crossings of a ray going right from the point
+    bool in = trigger.pointCount == 0;
+    for (uint32_t i = 0, j = trigger.pointCount - 1; i < trigger.pointCount; j = i++) {
+        const MapPoint& a = pointList[trigger.firstPoint + i];
+        const MapPoint& b = pointList[trigger.firstPoint + j];
+        if ((a.y > mapY) != (b.y > mapY) && mapX < a.x + (mapY - a.y) * (b.x - a.x) / (b.y - a.y)) {
+            in = !in;
+        }
+    }
+    return in;
+}
+
+void TriggerVolumes::update(const EntityStore& entities, const std::vector<EntityStore::EntityId>& tracked, std::vector<TriggerEvent>* events)
+{
+    if (events != nullptr) {
+        events->clear();
+    }
+    for (EntityStore::EntityId id : tracked) {
+        if (inside.size() <= id) {
+            inside.resize(id + 1);
+        }
+        const tripoint pos = entities.getPos(id);
+        // where the entity is drawn, in map units: getRealPosFromMapPos the other way round
+        const float mapX = pos.x + pos.z / c_x_ratio;
+        const float mapY = pos.y + pos.z;
+        nowInside.clear();
+        if (mapX >= 0.f && mapY >= 0.f && size_t(mapX / CellSize) < columns && size_t(mapY / CellSize) < rows) {
+            const size_t cell = size_t(mapY / CellSize) * columns + size_t(mapX / CellSize);
+            for (uint32_t c = cellStart[cell]; c < cellStart[cell + 1]; c++) {
+                if (contains(triggers[cellTriggers[c]], mapX, mapY, pos.z)) {
+                    nowInside.push_back(cellTriggers[c]);
+                }
+            }
+        }
+
+        std::vector<uint32_t>& wasInside = inside[id];
+        if (events != nullptr) {
+            // both lists are sorted, so one pass over them pairs them up
+            size_t before = 0, now = 0;
+            while (before < wasInside.size() || now < nowInside.size()) {
+                if (now == nowInside.size() || (before < wasInside.size() && wasInside[before] < nowInside[now])) {
+                    events->push_back({ TriggerEventType::Exit, wasInside[before++], id });
+                } else if (before == wasInside.size() || nowInside[now] < wasInside[before]) {
+                    events->push_back({ TriggerEventType::Enter, nowInside[now++], id });
+                } else {
+                    events->push_back({ TriggerEventType::Stay, nowInside[now++], id });
+                    before++;
+                }
+            }
+        }
+        wasInside.assign(nowInside.begin(), nowInside.end());
+    }
+}
+
+void TriggerVolumes::forget(EntityStore::EntityId id)
+{
+    if (id < inside.size()) {
+        inside[id].clear();
+    }
+}
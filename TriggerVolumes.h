@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "EntityStore.h"
+
+namespace tmx
+{
+    class Map;
+}
+
+enum class TriggerEventType : uint8_t
+{
+    Enter,
+    Stay,
+    Exit
+};
+
+/// @brief Something an entity did with a trigger in one step
+struct TriggerEvent
+{
+    TriggerEventType type;
+    uint32_t trigger;
+    EntityStore::EntityId entity;
+};
+
+/// @brief Regions of the level that notice entities coming and going: the rectangles and polygons of the
+/// map's object layers and boxes over the tileset's custom objects as they're placed, each extruded through a
+/// range of depths. An entity is inside a trigger when its depth is in range and the map point it's drawn at,
+/// by the same projection getRealPosFromMapPos inverts, is inside the shape. Triggers never move, so they're
+/// filed into a grid over the map as they come; finding the ones an entity might be in is a single cell lookup
+class TriggerVolumes
+{
+public:
+    struct Trigger
+    {
+        std::string name;
+        std::string layer;
+        std::string type;
+        // depths the trigger reaches through, and its bounding box in map units
+        float z1, z2;
+        float left, top, right, bottom;
+        // its outline in pointList, empty for rectangles
+        uint32_t firstPoint;
+        uint32_t pointCount;
+    };
+
+    // edge of a grid cell, in tiles
+    static constexpr float CellSize = 8.f;
+    // layer given to the triggers added for the tileset's custom objects
+    static constexpr const char* ObjectLayer = "custom objects";
+
+private:
+    struct MapPoint
+    {
+        float x, y;
+    };
+
+    std::vector<Trigger> triggers;
+    // the first loadedCount triggers came from the map, the rest were added since
+    size_t loadedCount;
+    std::vector<MapPoint> pointList;
+    // triggers by cell, as compressed buckets: cellTriggers[cellStart[c]] to cellTriggers[cellStart[c + 1]] overlap cell c
+    std::vector<uint32_t> cellStart;
+    std::vector<uint32_t> cellTriggers;
+    size_t columns, rows;
+    // the triggers each tracked entity was inside after the last update, by id, sorted
+    std::vector<std::vector<uint32_t>> inside;
+    std::vector<uint32_t> nowInside;
+
+    bool contains(const Trigger& trigger, float mapX, float mapY, float z) const;
+    void buildGrid(float mapWidth, float mapHeight);
+public:
+    TriggerVolumes();
+
+    /// @brief Read every rectangle and polygon from the map's object layers, besides the collectibles layer.
+    /// A "z" property sets the nearest depth a trigger reaches and "depth" how far it goes from there; without
+    /// them it reaches through every depth
+    void load(const tmx::Map& map);
+    /// @brief Add rectangles to the ones from the map, after them, and file them into the grid. The map has
+    /// to be loaded first
+    void addBoxes(std::vector<Trigger>& boxes);
+    // drop every trigger added since the map was loaded
+    void clearAdded();
+
+    /// @brief Find which triggers each tracked entity is in now, and how that changed since the last update
+    /// @param events receives an Enter, Stay or Exit event per entity per trigger it's been in, reusing its
+    /// capacity; nullptr to just catch up without any events, after the entities have been moved wholesale
+    void update(const EntityStore& entities, const std::vector<EntityStore::EntityId>& tracked, std::vector<TriggerEvent>* events);
+    // stop tracking an entity, without an Exit event
+    void forget(EntityStore::EntityId id);
+
+    /// @brief Whether a point, in map units at a depth, is inside a trigger
+    bool contains(uint32_t index, float mapX, float mapY, float z) const { return contains(triggers[index], mapX, mapY, z); }
+
+    size_t size() const { return triggers.size(); }
+    const Trigger& getTrigger(uint32_t index) const { return triggers[index]; }
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/// @brief Hands the latest of a stream of values from one writer thread to one reader thread without either waiting on the other.
+/// The writer fills getWriteBuffer() and publishes it, the reader always gets the most recently published value.
+/// Buffers are recycled, so the writer has to overwrite everything it cares about each time.
+template <typename T>
+class TripleBuffer
+{
+    static const uint8_t IndexMask = 3;
+    static const uint8_t NewData = 4;
+
+    T buffers[3];
+    // index of the buffer sitting between writer and reader, with NewData set if it was published since the last read
+    std::atomic<uint8_t> middle;
+    uint8_t back;
+    uint8_t front;
+public:
+    TripleBuffer() : middle(1), back(0), front(2) {}
+
+    T& getWriteBuffer() { return buffers[back]; }
+
+    void publish()
+    {
+        back = middle.exchange(uint8_t(back | NewData)) & IndexMask;
+    }
+
+    const T& read()
+    {
+        if (middle.load() & NewData) {
+            front = middle.exchange(front) & IndexMask;
+        }
+        return buffers[front];
+    }
+};
@@ -0,0 +1,268 @@
+// Checks for the pieces of the game that stand on their own, run by ctest:
+//     unit_tests
+// Each check prints what failed; the exit code is the number of failed checks.
+
+#include "RewindBuffer.h"
+#include "LayerTiles.h"
+#include "NavGraph.h"
+#include "TriggerVolumes.h"
+#include "ObjectPool.h"
+#include "GameWindow.h"
+#include <tmxlite/Map.hpp>
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool condition, const std::string& what)
+    {
+        if (!condition) {
+            std::cerr << "FAILED: " << what << std::endl;
+            failures++;
+        }
+    }
+
+    // a fixed seed so every run checks the same cases
+    uint32_t seed = 12345;
+    uint32_t next()
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return seed >> 8;
+    }
+
+    // a capture that differs from its neighbours in a few places, as the world's do from step to step
+    std::vector<char> stateAt(uint64_t step, size_t size)
+    {
+        std::vector<char> state(size, char(step / 60));
+        for (size_t i = 0; i < size; i += 13) {
+            state[i] = char(step * 7 + i);
+        }
+        return state;
+    }
+
+    void testRewindBuffer(bool compress)
+    {
+        const std::string mode = compress ? " (compressed)" : "";
+        const size_t stateSize = 100;
+        RewindBuffer buffer(stateSize * 3, 60, compress);
+        std::vector<char> restored;
+        bool allRestored = true;
+        for (uint64_t step = 0; step < 500; step++) {
+            buffer.capture(step, stateAt(step, stateSize));
+            // the ring wraps many times over, and every capture left in it must come back as it was
+            for (uint64_t kept = buffer.oldestStep(); kept <= buffer.newestStep(); kept++) {
+                allRestored = allRestored && buffer.restore(kept, restored) && restored == stateAt(kept, stateSize);
+            }
+        }
+        check(allRestored, "every capture still in the rewind ring restores" + mode);
+        check(buffer.newestStep() == 499, "the newest rewind capture is the last one" + mode);
+        check(buffer.oldestStep() > 0, "a full rewind ring evicts its oldest captures" + mode);
+        check(!buffer.restore(buffer.oldestStep() - 1, restored), "an evicted rewind capture doesn't restore" + mode);
+
+        RewindBuffer roomy(stateSize * 64, 4, compress);
+        for (uint64_t step = 0; step < 10; step++) {
+            roomy.capture(step, stateAt(step, stateSize));
+        }
+        roomy.truncateAfter(5);
+        check(roomy.newestStep() == 5, "truncateAfter keeps the step it's given" + mode);
+        check(!roomy.restore(7, restored), "truncateAfter forgets later captures" + mode);
+        check(roomy.restore(5, restored) && restored == stateAt(5, stateSize), "truncateAfter leaves earlier captures" + mode);
+        // carrying on from there with a different history
+        for (uint64_t step = 6; step < 10; step++) {
+            roomy.capture(step, stateAt(step + 100, stateSize));
+        }
+        bool carriedOn = true;
+        for (uint64_t step = 0; step < 10; step++) {
+            carriedOn = carriedOn && roomy.restore(step, restored) && restored == stateAt(step < 6 ? step : step + 100, stateSize);
+        }
+        check(carriedOn, "captures after truncateAfter restore alongside the ones before" + mode);
+        roomy.clear();
+        check(roomy.empty() && !roomy.restore(5, restored), "a cleared rewind buffer restores nothing" + mode);
+    }
+
+    std::string encodeBase64(const std::vector<uint8_t>& bytes)
+    {
+        static const char* digits = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        std::string text;
+        for (size_t i = 0; i < bytes.size(); i += 3) {
+            const size_t count = std::min<size_t>(3, bytes.size() - i);
+            uint32_t bits = uint32_t(bytes[i]) << 16;
+            bits |= count > 1 ? uint32_t(bytes[i + 1]) << 8 : 0;
+            bits |= count > 2 ? uint32_t(bytes[i + 2]) : 0;
+            for (size_t digit = 0; digit < 4; digit++) {
+                text += digit <= count ? digits[(bits >> (18 - digit * 6)) & 0x3f] : '=';
+            }
+        }
+        return text;
+    }
+
+    void testDecodeBase64()
+    {
+        std::vector<uint8_t> bytes(300);
+        for (uint8_t& byte : bytes) {
+            byte = uint8_t(next());
+        }
+        // up to 15 characters go through the scalar loop alone, past that the bulk goes 16 at a time first,
+        // so every length checks the two against the same text
+        bool decoded = true;
+        for (size_t count = 0; count <= bytes.size(); count++) {
+            const std::vector<uint8_t> expected(bytes.begin(), bytes.begin() + count);
+            const std::string text = encodeBase64(expected);
+            std::vector<uint8_t> out(LayerTiles::DecodedSize(text.data(), text.size()) + 1, 0xcd);
+            decoded = decoded && out.size() == count + 1 && LayerTiles::DecodeBase64(text.data(), text.size(), out.data()) &&
+                std::equal(expected.begin(), expected.end(), out.begin()) && out[count] == 0xcd;
+        }
+        check(decoded, "base64 decodes the same at every length");
+
+        // a bad character is caught wherever it lands, in a 16 character block or in the tail
+        const std::string text = encodeBase64(bytes);
+        std::vector<uint8_t> out(bytes.size());
+        bool rejected = true;
+        for (size_t at = 0; at < text.size() && text[at] != '='; at++) {
+            std::string bad = text;
+            // one below the digits and one with the top bit set, which signed compares could mistake
+            bad[at] = at % 2 == 0 ? '*' : char(0xc3);
+            rejected = rejected && !LayerTiles::DecodeBase64(bad.data(), bad.size(), out.data());
+        }
+        check(rejected, "base64 with a bad character fails");
+        check(LayerTiles::DecodedSize("AAAAA", 5) == SIZE_MAX, "no base64 text is 5 characters long");
+    }
+
+    std::vector<SurfaceData> navSurfaces()
+    {
+        // overlapping steps at random heights, far enough along x for several clusters
+        std::vector<SurfaceData> surfaces;
+        for (int i = 0; i < 400; i++) {
+            const float x = i * 0.5f + float(next() % 100) / 50.f, z = float(next() % 100) / 20.f, y = float(next() % 100) / 10.f;
+            surfaces.push_back({ TileLayerId::Ground, { { x, y, z }, { x + 1.f + float(next() % 100) / 30.f, y + 1.f, z + 2.f } }, { { 0, 0 }, { 1, 1 } } });
+        }
+        // walls aren't walked on
+        surfaces.push_back({ TileLayerId::ForegroundWall, { { 0.f, 0.f, 0.f }, { 300.f, 10.f, 1.f } }, { { 0, 0 }, { 1, 1 } } });
+        return surfaces;
+    }
+
+    void testNavGraph()
+    {
+        const std::vector<SurfaceData> surfaces = navSurfaces();
+        std::unique_ptr<NavGraph> graph(NavGraph::Build(surfaces));
+        check(graph->getNodeCount() == 400 && graph->getClusterCount() > 1, "every ground surface is a navigation node");
+
+        // traced a region at a time, it comes out the same
+        std::unique_ptr<NavGraph> extended(NavGraph::Build({}));
+        for (size_t i = 0; i < surfaces.size(); i += 37) {
+            extended->extend(std::vector<SurfaceData>(surfaces.begin() + i, surfaces.begin() + std::min(surfaces.size(), i + 37)));
+        }
+        check(extended->getNodeCount() == graph->getNodeCount() && extended->getLinkCount() == graph->getLinkCount() &&
+            extended->getClusterCount() == graph->getClusterCount(), "an extended navigation graph matches one built at once");
+
+        bool agrees = true, endsMatch = true, cached = true;
+        size_t found = 0;
+        std::vector<NavGraph::NodeId> flat, hierarchical, again;
+        for (NavGraph::NodeId i = 0; i < 200; i++) {
+            const NavGraph::NodeId from = i % 400, to = (i * 97) % 400;
+            const bool flatFound = graph->findPath(from, to, false, flat);
+            const bool hierarchicalFound = graph->findPath(from, to, true, hierarchical);
+            agrees = agrees && flatFound == hierarchicalFound && flatFound == extended->findPath(from, to, false, again);
+            if (flatFound && hierarchicalFound) {
+                found++;
+                endsMatch = endsMatch && flat.front() == from && flat.back() == to && hierarchical.front() == from && hierarchical.back() == to;
+                cached = cached && graph->findPath(from, to, true, again) && again == hierarchical;
+            }
+        }
+        check(found != 0, "some navigation paths are found");
+        check(agrees, "hierarchical and flat path-finding find the same paths possible");
+        check(endsMatch, "navigation paths go from the first node to the last");
+        check(cached, "a cached navigation path is the one first found");
+
+        bool onNode = true;
+        for (NavGraph::NodeId id = 0; id < graph->getNodeCount(); id++) {
+            const NavGraph::Node& node = graph->getNode(id);
+            const tripoint above{ (node.x1 + node.x2) / 2, node.top, (node.z1 + node.z2) / 2 };
+            const NavGraph::NodeId standing = graph->findNode(above);
+            onNode = onNode && standing != NavGraph::InvalidNode && graph->getNode(standing).top <= node.top;
+        }
+        check(onNode, "a point on a face finds that face or one above it");
+        check(graph->findNode({ -50.f, 0.f, 0.f }) == NavGraph::InvalidNode, "no face is found where there's no ground");
+    }
+
+    void testTriggerVolumes()
+    {
+        // 16 pixel tiles: a box from tile 1,2 to 4,4 reaching from depth 2 to 5, and a triangle through every depth
+        const std::string mapJson = R"({"compressionlevel":-1,"height":16,"width":16,"infinite":false,"nextlayerid":2,"nextobjectid":3,
+            "orientation":"orthogonal","renderorder":"right-down","tiledversion":"1.10.2","tileheight":16,"tilewidth":16,"type":"map",
+            "version":"1.10","tilesets":[],"layers":[{"draworder":"topdown","id":1,"name":"exits","opacity":1,"type":"objectgroup",
+            "visible":true,"x":0,"y":0,"objects":[
+            {"id":1,"name":"box","type":"act_end","rotation":0,"visible":true,"x":16,"y":32,"width":48,"height":32,
+             "properties":[{"name":"z","type":"int","value":2},{"name":"depth","type":"float","value":3}]},
+            {"id":2,"name":"triangle","type":"","rotation":0,"visible":true,"x":160,"y":16,"width":0,"height":0,
+             "polygon":[{"x":0,"y":0},{"x":64,"y":0},{"x":0,"y":64}]}]}]})";
+        tmx::Map map;
+        check(map.loadFromString(mapJson, "."), "the trigger test map loads");
+        TriggerVolumes triggers;
+        triggers.load(map);
+        check(triggers.size() == 2, "both trigger shapes load");
+        if (triggers.size() != 2) {
+            return;
+        }
+        check(triggers.contains(0, 2.f, 3.f, 3.f), "a point in a box trigger's rectangle and depth is inside it");
+        check(!triggers.contains(0, 2.f, 3.f, 6.f), "a point past a box trigger's depth is outside it");
+        check(!triggers.contains(0, 2.f, 3.f, 1.f), "a point in front of a box trigger's depth is outside it");
+        check(!triggers.contains(0, 4.5f, 3.f, 3.f), "a point beside a box trigger is outside it");
+        check(triggers.contains(1, 10.5f, 1.5f, -100.f), "a point in a polygon trigger is inside it at any depth");
+        check(!triggers.contains(1, 13.5f, 4.5f, 0.f), "a point in a polygon trigger's bounding box but not its outline is outside it");
+
+        std::vector<TriggerVolumes::Trigger> boxes{ { "added", TriggerVolumes::ObjectLayer, "spring", 0.f, 1.f, 6.f, 6.f, 8.f, 8.f, 0, 0 } };
+        triggers.addBoxes(boxes);
+        check(triggers.size() == 3 && triggers.contains(2, 7.f, 7.f, 0.5f), "an added box is a trigger like the map's");
+        triggers.clearAdded();
+        check(triggers.size() == 2, "clearing the added triggers leaves the map's");
+    }
+
+    struct Pooled
+    {
+        int value;
+        explicit Pooled(int value) : value(value) {}
+    };
+
+    void testObjectPool()
+    {
+        ObjectPool<Pooled, 4> pool;
+        std::vector<PoolHandle> handles;
+        for (int i = 0; i < 6; i++) {
+            handles.push_back(pool.create(i));
+        }
+        check(pool.size() == 6 && pool.getStats().blocks == 2, "a pool grows a block at a time");
+        pool.destroy(handles[2]);
+        check(pool.get(handles[2]) == nullptr, "a destroyed object's handle is invalid");
+        const PoolHandle reused = pool.create(10);
+        check(reused.index == handles[2].index && !(reused == handles[2]), "a freed slot is reused under a new generation");
+        check(pool.get(handles[2]) == nullptr && pool.get(reused) != nullptr && pool.get(reused)->value == 10,
+            "an old handle stays invalid once its slot is reused");
+        pool.destroy(handles[2]);
+        check(pool.get(reused) != nullptr, "destroying through an old handle leaves the slot's new object");
+        int sum = 0;
+        pool.forEach([&sum](const Pooled& pooled) { sum += pooled.value; });
+        check(sum == 0 + 1 + 10 + 3 + 4 + 5, "forEach visits every live object");
+        pool.clear();
+        check(pool.size() == 0 && pool.get(handles[0]) == nullptr && pool.getStats().blocks == 2, "clearing a pool keeps its blocks");
+    }
+}
+
+int main(int, char**)
+{
+    testRewindBuffer(false);
+    testRewindBuffer(true);
+    testDecodeBase64();
+    testNavGraph();
+    testTriggerVolumes();
+    testObjectPool();
+    if (failures == 0) {
+        std::cout << "All checks passed" << std::endl;
+    }
+    return failures;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+/// @brief Appends plain values and arrays of them to a byte buffer, for capturing simulation state
+class StateWriter
+{
+    std::vector<char>& out;
+public:
+    explicit StateWriter(std::vector<char>& out) : out(out) {}
+
+    template<typename T>
+    void write(const T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const char* bytes = reinterpret_cast<const char*>(&value);
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+
+    template<typename T>
+    void writeVector(const std::vector<T>& values)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        write(uint32_t(values.size()));
+        const char* bytes = reinterpret_cast<const char*>(values.data());
+        out.insert(out.end(), bytes, bytes + values.size() * sizeof(T));
+    }
+};
+
+/// @brief Reads back what a StateWriter wrote. Running past the end makes every later read fail too, so
+/// callers can read everything and check good() once
+class StateReader
+{
+    const char* data;
+    size_t remaining;
+    bool ok;
+public:
+    StateReader(const char* data, size_t length) : data(data), remaining(length), ok(true) {}
+
+    template<typename T>
+    bool read(T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (!ok || remaining < sizeof(T)) {
+            ok = false;
+            return false;
+        }
+        memcpy(&value, data, sizeof(T));
+        data += sizeof(T);
+        remaining -= sizeof(T);
+        return true;
+    }
+
+    template<typename T>
+    bool readVector(std::vector<T>& values)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        uint32_t count = 0;
+        if (!read(count) || remaining / sizeof(T) < count) {
+            ok = false;
+            return false;
+        }
+        values.resize(count);
+        memcpy(values.data(), data, count * sizeof(T));
+        data += count * sizeof(T);
+        remaining -= count * sizeof(T);
+        return true;
+    }
+
+    bool good() const { return ok; }
+    bool atEnd() const { return remaining == 0; }
+};
@@ -2,13 +2,15 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 #include "GameWindow.h"
+#include "GameLoop.h"
 #include "Texture.h"
 #include "MapLayer.h"
 #include <tmxlite/Map.hpp>
 //#include "SimpleJSON/json.hpp"
 
 int main(int argc, char** argv) {
-    GameWindow* gameWindow = GameWindow::Create();
+    GameOptions options = GameOptions::FromArgs(argc, argv);
+    GameWindow* gameWindow = GameWindow::Create(options);
 
     if (!gameWindow)
     {
@@ -16,21 +18,11 @@ int main(int argc, char** argv) {
         std::cout << "SDL init failed." << std::endl;
         return -1;
     }
-    bool game_open = true;
-    SDL_Event event;
-    while (game_open)
+    bool success;
     {
-        while (SDL_PollEvent(&event) > 0)
-        {
-            if (event.type == SDL_QUIT) {
-                delete gameWindow;
-                return 0;
-            }
-            gameWindow->handle_input(event);
-        }
-        gameWindow->drawFrame();
-        SDL_Delay(10);
+        GameLoop gameLoop(*gameWindow, options);
+        success = gameLoop.run();
     }
     delete gameWindow;
-    return 0;
+    return success ? 0 : 1;
 }
\ No newline at end of file